@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "fiber.h"
+#include "macro.h"
+#include "noncopyable.h"
+#include "scheduler.h"
+#include "sync.h"
+#include "thread.h"
+
+namespace dbspider
+{
+    /**
+     * 执行阻塞调用和计算密集任务的线程池
+     * 调度线程上的协程通过 run 把可调用对象交给池中的线程执行，自己让出，调度线程继续执行其他协程；
+     * 执行完毕后协程回到原来的调度器上继续运行。池中的线程不开启 hook ，系统调用直接阻塞
+     */
+    class BlockingPool : Noncopyable
+    {
+    public:
+        using MutexType = Mutex;
+
+        BlockingPool(size_t threads = 4, const std::string &name = "blocking");
+
+        ~BlockingPool();
+
+        // 提交任务后立即返回，任务在池中的线程上执行
+        void post(std::function<void()> cb);
+
+        // 在池中执行 fn 并返回结果，fn 抛出的异常在这里重新抛出
+        // 在调度线程的协程中调用时当前协程让出，不阻塞调度线程；
+        // 不在调度线程上，或者是共享栈协程（挂起后栈会被其他协程覆盖，池中的线程不能访问栈上的数据）时直接在当前线程执行
+        template <typename Fn>
+        std::invoke_result_t<Fn> run(Fn &&fn)
+        {
+            using T = std::invoke_result_t<Fn>;
+            Scheduler *scheduler = Scheduler::GetThis();
+            if (!scheduler || scheduler->getCurrentIndex() < 0 || Fiber::GetThis()->isSharedStack())
+            {
+                return fn();
+            }
+            RunState<T> state;
+            state.fiber = Fiber::GetThis();
+            state.scheduler = scheduler;
+            // 任务自己累加执行计数，协程被唤醒之前计数已经包含这个任务
+            push([this, &state, &fn]
+                 {
+                     try
+                     {
+                         if constexpr (std::is_void_v<T>)
+                         {
+                             fn();
+                         }
+                         else
+                         {
+                             state.value.emplace(fn());
+                         }
+                     }
+                     catch (...)
+                     {
+                         state.exception = std::current_exception();
+                     }
+                     m_executed.fetch_add(1, std::memory_order_relaxed);
+                     // exchange 之后 state 可能已经随着协程返回而失效，只能使用局部变量
+                     Fiber::ptr fiber = state.fiber;
+                     Scheduler *scheduler = state.scheduler;
+                     if (state.done.exchange(true))
+                     {
+                         scheduler->submit(fiber);
+                     } },
+                 false);
+            if (!state.done.exchange(true))
+            {
+                Fiber::YieldToHold();
+            }
+            if (state.exception)
+            {
+                std::rethrow_exception(state.exception);
+            }
+            if constexpr (!std::is_void_v<T>)
+            {
+                return std::move(*state.value);
+            }
+        }
+
+        // 线程数量
+        size_t getThreadCount() const { return m_threads.size(); }
+
+        // 已经执行完的任务数
+        uint64_t getExecutedCount() const { return m_executed.load(std::memory_order_relaxed); }
+
+        // 默认线程池，线程数由 blocking_pool.threads 配置
+        static BlockingPool *GetInstance();
+
+    private:
+        // run 的等待状态，放在等待协程的栈上
+        template <typename T>
+        struct RunState
+        {
+            using value_type = std::conditional_t<std::is_void_v<T>, char, T>;
+
+            Fiber::ptr fiber;                // 等待的协程
+            Scheduler *scheduler = nullptr;  // 等待协程所在的调度器
+            std::atomic<bool> done{false};   // 任务结束和协程挂起，后到的一方负责唤醒协程
+            std::exception_ptr exception;    // 任务抛出的异常
+            std::optional<value_type> value; // 任务的返回值
+        };
+
+        // 任务队列中的任务
+        struct Task
+        {
+            std::function<void()> cb; // 任务
+            bool count = true;        // 执行完后由池中线程累加执行计数，为 false 时任务自己累加
+        };
+
+        // 把任务放进队列，唤醒一个池中线程
+        void push(std::function<void()> cb, bool count);
+
+        // 池中线程的执行函数
+        void work();
+
+    private:
+        MutexType m_mutex;                         // 保护任务队列
+        Semaphore m_sem{0};                        // 任务队列中的任务数
+        std::deque<Task> m_tasks;                  // 任务队列
+        std::vector<Thread::ptr> m_threads;        // 线程池
+        bool m_stop = false;                       // 是否停止
+        std::atomic<uint64_t> m_executed{0};       // 已经执行完的任务数
+    };
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+
+#include "fiber.h"
+#include "mutex.h"
+#include "noncopyable.h"
+
+namespace dbspider
+{
+    class Timer;
+
+    /**
+     * 协程的取消令牌和截止时间
+     * 令牌绑定在协程局部变量上，随 Fiber::Inherit（FiberGroup::spawn）传给子协程。
+     * 协程挂起在 hook 的 IO、sleep、CoCondVar（Channel、CoSemaphore 等）上时，令牌被取消或到达截止时间后立即唤醒，
+     * 对应的调用返回失败，errno 为 ECANCELED 或 ETIMEDOUT
+     */
+    class CancelToken : public std::enable_shared_from_this<CancelToken>, Noncopyable
+    {
+    public:
+        using ptr = std::shared_ptr<CancelToken>;
+        using MutexType = Mutex;
+
+        // timeout_ms 为 -1 表示没有截止时间
+        // parent 取消时子令牌一起取消，子令牌的截止时间不晚于 parent
+        static ptr Create(uint64_t timeout_ms = -1, ptr parent = nullptr);
+
+        // 以当前协程的令牌为 parent 创建子令牌
+        static ptr CreateChild(uint64_t timeout_ms = -1) { return Create(timeout_ms, GetThis()); }
+
+        ~CancelToken();
+
+        // 取消令牌，err 为等待中的调用返回的 errno，返回值：false 表示已经取消过
+        bool cancel(int err = ECANCELED);
+
+        // 是否已经取消，到达截止时间也算取消
+        bool isCancelled();
+
+        // 取消的原因，没有取消时为 0
+        int getError();
+
+        // 截止时间（ms），-1 表示没有
+        uint64_t getDeadline() const { return m_deadline; }
+
+        // 距离截止时间的毫秒数，没有截止时间时为 -1
+        uint64_t getRemainingMS() const;
+
+        // 注册取消时执行的回调，参数为取消的原因，返回回调 id；已经取消时不注册，返回 0
+        // 回调在持有令牌锁的情况下执行，delCallback 返回后回调不会再执行，
+        // 所以不能在持有回调里要用到的锁时调用 addCallback/delCallback
+        uint64_t addCallback(std::function<void(int)> cb);
+
+        void delCallback(uint64_t id);
+
+        // 当前协程的令牌
+        static ptr GetThis();
+
+        static void SetThis(ptr token);
+
+        // 当前协程的令牌已经取消时设置 errno 并返回 true
+        static bool Check();
+
+        // 在作用域内把令牌绑定到当前协程，析构时恢复原来的令牌
+        class Scope : Noncopyable
+        {
+        public:
+            explicit Scope(ptr token)
+                : m_prev(GetThis())
+            {
+                SetThis(std::move(token));
+            }
+
+            ~Scope() { SetThis(std::move(m_prev)); }
+
+        private:
+            ptr m_prev;
+        };
+
+        // 挂起前向当前协程的令牌注册唤醒回调，析构时注销
+        class Listener : Noncopyable
+        {
+        public:
+            explicit Listener(std::function<void(int)> cb);
+
+            ~Listener();
+
+            // 令牌在注册前已经取消，调用方不应再挂起，errno 已经设置好
+            bool cancelled() const { return m_cancelled; }
+
+        private:
+            ptr m_token;
+            uint64_t m_id = 0;
+            bool m_cancelled = false;
+        };
+
+    private:
+        explicit CancelToken(uint64_t deadline);
+
+    private:
+        std::atomic<int> m_error{0};                              // 取消的原因
+        uint64_t m_deadline;                                      // 截止时间（ms）
+        MutexType m_mutex;                                        // 保护回调，取消时持有
+        uint64_t m_nextId = 1;                                    // 下一个回调 id
+        std::map<uint64_t, std::function<void(int)>> m_callbacks; // 取消时执行的回调
+        std::shared_ptr<Timer> m_timer;                           // 截止时间的定时器
+        ptr m_parent;
+        uint64_t m_parentId = 0;                                  // 在 parent 中注册的回调 id
+    };
+}
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include "io_manager.h"
+#include "segmented_array.h"
 #include "sync.h"
 
 namespace dbspider
@@ -20,32 +22,42 @@ namespace dbspider
         // 初始化
         bool init();
 
+        // fd 号被复用时原地重新初始化，开始新的一代
+        // 还拿着旧连接的协程可能同时在读，所以下面的字段都是原子的，读到的要么是旧值要么是新值，再由代数判断fd是否已经换了
+        void reopen();
+
+        // 第几次打开该fd号，同一个 fd 号上的新旧连接通过它区分
+        uint64_t getGeneration() const { return m_generation.load(std::memory_order_acquire); }
+
         // 是否初始化完成
-        bool isInit() const { return m_isInit; }
+        bool isInit() const { return m_isInit.load(std::memory_order_relaxed); }
 
         // 是否socket
-        bool isSocket() const { return m_isSocket; }
+        bool isSocket() const { return m_isSocket.load(std::memory_order_relaxed); }
+
+        // 是否普通文件
+        bool isFile() const { return m_isFile.load(std::memory_order_relaxed); }
 
         // 是否已关闭
-        bool isClose() const { return m_isClosed; }
+        bool isClose() const { return m_isClosed.load(std::memory_order_relaxed); }
 
         // 设置系统非阻塞
-        void setSysNonblock(bool f) { m_sysNonblock = f; }
+        void setSysNonblock(bool f) { m_sysNonblock.store(f, std::memory_order_relaxed); }
 
         // 获取系统非阻塞
-        bool getSysNonblock() const { return m_sysNonblock; }
+        bool getSysNonblock() const { return m_sysNonblock.load(std::memory_order_relaxed); }
 
         // 设置用户主动设置非阻塞
-        void setUserNonblock(bool f) { m_userNonblock = f; }
+        void setUserNonblock(bool f) { m_userNonblock.store(f, std::memory_order_relaxed); }
 
         // 获取是否用户主动设置的非阻塞
-        bool getUserNonblock() const { return m_userNonblock; }
+        bool getUserNonblock() const { return m_userNonblock.load(std::memory_order_relaxed); }
 
-        void setSendTimeout(uint64_t timeout) { m_sendTimeout = timeout; }
-        uint64_t getSendTimeout() const { return m_sendTimeout; }
+        void setSendTimeout(uint64_t timeout) { m_sendTimeout.store(timeout, std::memory_order_relaxed); }
+        uint64_t getSendTimeout() const { return m_sendTimeout.load(std::memory_order_relaxed); }
 
-        void setRecvTimeout(uint64_t timeout) { m_sendTimeout = timeout; }
-        uint64_t getRecvTimeout() const { return m_recvTimeout; }
+        void setRecvTimeout(uint64_t timeout) { m_recvTimeout.store(timeout, std::memory_order_relaxed); }
+        uint64_t getRecvTimeout() const { return m_recvTimeout.load(std::memory_order_relaxed); }
 
         //  设置超时时间
         void setTimeout(int type, uint64_t timeout);
@@ -54,34 +66,54 @@ namespace dbspider
         uint64_t getTimeout(int type) const;
 
     private:
-        bool m_isInit : 1;       // 是否初始化
-        bool m_isSocket : 1;     // 是否是socket
-        bool m_sysNonblock : 1;  // 是否hook非阻塞
-        bool m_userNonblock : 1; // 用户主动设置非阻塞
-        bool m_isClosed : 1;     // 是否关闭
-        int m_fd = 0;            // 文件句柄
-        uint64_t m_sendTimeout;  // 写超时间毫秒
-        uint64_t m_recvTimeout;  // 读超时间毫秒
+        // 重新检查fd类型并重置所有状态，reopen 时不经过 m_isInit 为 false 的中间状态
+        bool probe();
+
+        std::atomic<bool> m_isInit;          // 是否初始化
+        std::atomic<bool> m_isSocket;        // 是否是socket
+        std::atomic<bool> m_isFile;          // 是否是普通文件
+        std::atomic<bool> m_sysNonblock;     // 是否hook非阻塞
+        std::atomic<bool> m_userNonblock;    // 用户主动设置非阻塞
+        std::atomic<bool> m_isClosed;        // 是否关闭
+        int m_fd = 0;                        // 文件句柄
+        std::atomic<uint64_t> m_sendTimeout; // 写超时间毫秒
+        std::atomic<uint64_t> m_recvTimeout; // 读超时间毫秒
         dbspider::IOManager *m_iomanager;
+        std::atomic<uint64_t> m_generation = {0}; // 打开的代数
     };
 
     // 文件句柄管理类
+    // FdCtx 按fd放在分段数组中，查找时只有原子load，不加锁
+    // FdCtx 直到进程退出都不释放，fd 关闭后再次打开时原地重新初始化并增加代数，get 直接返回裸指针
+    // fd 号复用后，比较 FdCtx 的代数就能知道 fd 是否已经换成了别的连接
     class FdManager
     {
     public:
-        using RWMutexType = dbspider::RWMutex;
+        using MutexType = dbspider::Mutex;
 
         FdManager();
 
         // 获取/创建文件句柄类FdCtx
-        FdCtx::ptr get(int fd, bool auto_create = false);
+        FdCtx *get(int fd, bool auto_create = false);
+
+        // fd 刚由 socket/accept/open 等返回，之前登记的 FdCtx 一定已经失效(比如在未hook的线程上关闭)，总是开始新的一代
+        FdCtx *open(int fd);
 
         // 删除文件句柄类
         void del(int fd);
 
     private:
-        RWMutexType m_mutex;
-        std::vector<FdCtx::ptr> m_fds;
+        struct Slot
+        {
+            std::unique_ptr<FdCtx> storage;       // fd第一次使用时分配，之后复用
+            std::atomic<FdCtx *> ctx = {nullptr}; // fd打开期间指向 storage，关闭后为 nullptr
+        };
+
+        // 在锁内初始化fd的 FdCtx ，reopen 为 false 时已经打开的不再重新初始化
+        FdCtx *create(int fd, bool reopen);
+
+        MutexType m_mutex;          // 创建FdCtx时加锁，避免同一个fd重复初始化
+        SegmentedArray<Slot> m_fds; // 以fd为下标
     };
 
     // 文件句柄单例
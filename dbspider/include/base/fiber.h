@@ -1,13 +1,19 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <functional>
 #include <memory>
-#include <ucontext.h>
+#include <vector>
 
+#include "fiber_context.h"
+#include "small_task.h"
 #include "thread.h"
 
 namespace dbspider
 {
+    struct SharedStack;
+
     class Fiber : public std::enable_shared_from_this<Fiber>
     {
     public:
@@ -23,7 +29,16 @@ namespace dbspider
             EXCEPT
         };
 
-        Fiber(std::function<void()> cb, size_t stacksize = 0);
+        // 调度优先级，调度器优先执行 HIGH 的任务，用于心跳、注册中心通知等控制面的任务
+        enum Priority
+        {
+            HIGH,
+            NORMAL
+        };
+
+        // shared_stack为true时协程运行在线程的共享栈上，让出时只把用到的那部分栈拷贝出来保存，
+        // 适合大量长时间挂起的协程；这种协程第一次运行后就绑定在该线程上，不能再被其他线程调度
+        Fiber(SmallTask cb, size_t stacksize = 0, bool shared_stack = false);
         ~Fiber();
 
         // 切换到当前协程
@@ -34,7 +49,7 @@ namespace dbspider
         void yield();
 
         // 重置协程执行函数，并重置状态
-        void reset(std::function<void()> cb);
+        void reset(SmallTask cb);
 
         // 获取协程ID
         uint64_t getId() const { return m_id; }
@@ -43,6 +58,17 @@ namespace dbspider
 
         bool isTerminate() const { return m_state == TERM || m_state == EXCEPT; }
 
+        // 是否运行在共享栈上
+        bool isSharedStack() const { return m_sharedMode; }
+        // 共享栈协程绑定的线程ID，未绑定返回-1
+        int getBoundThread() const { return m_thread; }
+        // 共享栈协程当前保存的栈大小
+        size_t getSavedStackSize() const { return m_savedSize; }
+
+        // 调度优先级，协程每次被提交时（包括 IO 就绪、定时器到期后的唤醒）都按这个优先级调度
+        Priority getPriority() const { return m_priority; }
+        void setPriority(Priority priority) { m_priority = priority; }
+
         // 在当前线程启用协程
         static void EnableFiber();
 
@@ -55,6 +81,14 @@ namespace dbspider
         // 让出协程，并设置协程状态为Hold
         static void YieldToReady();
 
+        // 协作式抢占的检查点：调度器的看门狗发现当前协程占用线程超过时间片时置位抢占标记，
+        // 在这里以 READY 状态让出，返回是否让出了。不在调度线程的子协程中、或者没有开启抢占时什么都不做，
+        // 调用开销是一次线程局部变量和原子变量的读取，可以放在长循环里
+        static bool MaybeYield();
+
+        // 设置本线程的抢占标记，由调度线程在启动时设置
+        static void SetPreemptFlag(std::atomic<bool> *flag);
+
         // 返回当前线程正在执行的协程
         // 如果当前线程还未创建协程，则创建线程的第一个协程，
         // 且该协程为当前线程的主协程，其他协程都通过这个协程来调度，也就是说，其他协程
@@ -71,18 +105,140 @@ namespace dbspider
         // 协程总数
         static uint64_t TotalFibers();
 
+        // 协程栈池命中次数，命中时不需要分配新栈
+        static uint64_t StackPoolHits();
+
+        // 协程栈池未命中次数
+        static uint64_t StackPoolMisses();
+
+        // 在检查点被抢占让出的次数
+        static uint64_t TotalPreempts();
+
+        // 协程局部存储的槽位，前 INLINE_LOCALS 个放在协程对象内，按下标直接访问
+        static constexpr size_t INLINE_LOCALS = 8;
+
+        // 分配一个协程局部存储的下标，由 FiberLocal 在构造时调用，下标不回收
+        static size_t AllocLocalIndex();
+
+        // 当前协程下标为 index 的局部存储，没有设置时返回 nullptr
+        static void *GetLocal(size_t index);
+
+        // 设置当前协程下标为 index 的局部存储，value 为空时清除
+        static void SetLocal(size_t index, std::shared_ptr<void> value);
+
+        // 包装 cb ，运行时继承当前协程的局部存储：go Fiber::Inherit([]{ ... });
+        // 继承的是同一份值，子协程 set 只替换自己的槽位，不影响父协程
+        // 返回的是 lambda 而不是 std::function，只比 cb 多一个智能指针，派生协程时可以放进 SmallTask 的内联缓冲区
+        template <typename Cb>
+        static auto Inherit(Cb &&cb)
+        {
+            return [locals = LocalsSnapshot(), cb = std::forward<Cb>(cb)]() mutable
+            {
+                if (locals)
+                {
+                    LoadLocals(*locals);
+                }
+                cb();
+            };
+        }
+
     private:
         // 构造函数
         // 无参构造函数只用于创建线程的第一个协程，也就是线程主函数对应的协程，
         // 这个协程只能由GetThis()方法调用，所以定义成私有方法
         Fiber();
 
+        // 在协程栈上构造以MainFunc为入口的上下文
+        void makeContext();
+
+        // 保存当前上下文到from，切换到to的上下文
+        static void SwapContext(Fiber *from, Fiber *to);
+
+        // 共享栈协程切入前绑定共享栈，并把保存的栈拷贝回共享栈
+        void switchInSharedStack();
+
+        // 共享栈协程让出后把用到的栈拷贝出来
+        void switchOutSharedStack();
+
+        struct Locals;
+
+        // 当前协程局部存储的只读快照，没有值时返回 nullptr
+        // 快照缓存在协程中，SetLocal 之前派生的子协程共享同一份快照，不用每次都拷贝
+        static std::shared_ptr<const Locals> LocalsSnapshot();
+
+        // 把快照装入当前协程的局部存储
+        static void LoadLocals(const Locals &locals);
+
     private:
         uint64_t m_id = 0;          // 协程id
         uint32_t m_stacksize = 0;   // 协程栈大小
-        State m_state = INIT;       // 协程状态
+        std::atomic<State> m_state = {INIT}; // 协程状态，其他线程会读取
+        State m_yieldState = EXEC;           // 让出时要进入的状态，切回调度协程之后才生效
+#ifdef DBSPIDER_FIBER_UCONTEXT
         ucontext_t m_ctx;           // 协程上下文
+#else
+        fcontext_t m_ctx = nullptr; // 协程上下文，指向切出时保存的寄存器
+#endif
         void *m_stack = nullptr;    // 协程栈指针
-        std::function<void()> m_cb; // 协程运行的函数
+        SmallTask m_cb;             // 协程运行的函数
+        Priority m_priority = NORMAL; // 调度优先级
+
+        bool m_sharedMode = false;              // 是否运行在共享栈上
+        SharedStack *m_sharedStack = nullptr;   // 绑定的共享栈
+        int m_thread = -1;                      // 绑定的线程ID
+        char *m_savedStack = nullptr;           // 让出时拷贝出来的栈内容
+        size_t m_savedSize = 0;                 // 拷贝出来的栈大小
+
+        // 协程局部存储，reset 时清空，复用的回调协程不会把上一个任务的值带给下一个任务
+        struct Locals
+        {
+            std::array<std::shared_ptr<void>, INLINE_LOCALS> slots; // 内联槽位
+            std::vector<std::shared_ptr<void>> overflow;           // 超出内联槽位的部分
+
+            bool empty() const
+            {
+                for (auto &slot : slots)
+                {
+                    if (slot)
+                    {
+                        return false;
+                    }
+                }
+                return overflow.empty();
+            }
+        };
+        Locals m_locals;
+        std::shared_ptr<const Locals> m_localsSnapshot; // 传给子协程的快照，局部存储修改后失效
+    };
+
+    /**
+     * 协程局部存储的类型化键，通常定义为静态变量
+     * 值跟随协程，协程在线程之间迁移时仍然可以访问；不在协程中时访问线程的主协程的值
+     * static FiberLocal<std::string> s_trace_id;
+     * s_trace_id.set("abc");
+     * std::string *id = s_trace_id.get();
+     */
+    template <typename T>
+    class FiberLocal
+    {
+    public:
+        FiberLocal() : m_index(Fiber::AllocLocalIndex()) {}
+
+        FiberLocal(const FiberLocal &) = delete;
+        FiberLocal &operator=(const FiberLocal &) = delete;
+
+        // 当前协程的值，没有设置时返回 nullptr
+        T *get() const { return static_cast<T *>(Fiber::GetLocal(m_index)); }
+
+        // 设置当前协程的值
+        void set(T value) { Fiber::SetLocal(m_index, std::make_shared<T>(std::move(value))); }
+
+        // 清除当前协程的值
+        void reset() { Fiber::SetLocal(m_index, nullptr); }
+
+        size_t getIndex() const { return m_index; }
+
+    private:
+        size_t m_index; // 槽位下标
     };
 }
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+// 编译时选择协程上下文切换的实现：
+// 默认在 x86-64 和 aarch64 上使用汇编实现，只保存被调用者保存寄存器，切换时不进入内核；
+// 定义 DBSPIDER_FIBER_UCONTEXT（cmake -DDBSPIDER_FIBER_UCONTEXT=ON）或其他架构上退回到 ucontext，
+// ucontext 的 swapcontext 每次切换都要调用 rt_sigprocmask 保存/恢复信号掩码
+#if !defined(DBSPIDER_FIBER_UCONTEXT) && !defined(__x86_64__) && !defined(__aarch64__)
+#define DBSPIDER_FIBER_UCONTEXT
+#endif
+
+#ifdef DBSPIDER_FIBER_UCONTEXT
+#include <ucontext.h>
+#endif
+
+namespace dbspider
+{
+#ifndef DBSPIDER_FIBER_UCONTEXT
+    // 协程上下文，指向协程切出时保存在自己栈上的寄存器
+    using fcontext_t = void *;
+
+    // 保存当前上下文到 *from，然后切换到上下文 to，实现在 fiber_context.cc 中
+    extern "C" void dbspider_jump_fcontext(fcontext_t *from, fcontext_t to);
+
+    // 在栈 [stack, stack + size) 上构造一个从 fn 开始执行的上下文，fn 不能返回
+    fcontext_t MakeFContext(void *stack, size_t size, void (*fn)());
+
+    // 保存当前上下文到 *from，然后切换到上下文 to
+    inline void JumpFContext(fcontext_t *from, fcontext_t to)
+    {
+        dbspider_jump_fcontext(from, to);
+    }
+#endif
+
+    // 当前编译使用的上下文切换实现的名字
+    const char *FiberContextBackend();
+}
@@ -37,6 +37,13 @@ extern "C"
     typedef int (*close_fun)(int fd);
     extern close_fun close_f;
 
+    // file
+    typedef int (*open_fun)(const char *pathname, int flags, ...);
+    extern open_fun open_f;
+
+    typedef int (*openat_fun)(int dirfd, const char *pathname, int flags, ...);
+    extern openat_fun openat_f;
+
     // read
     typedef ssize_t (*read_fun)(int fd, void *buf, size_t count);
     extern read_fun read_f;
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <sys/socket.h>
+#include "task.h"
+#include "io_manager.h"
+#include "log.h"
+#include "macro.h"
+
+namespace dbspider
+{
+    // 把无栈协程作为回调任务提交到调度器，由调度线程恢复执行
+    inline void ResumeOn(Scheduler *scheduler, std::coroutine_handle<> handle)
+    {
+        scheduler->submit([handle]
+                          { handle.resume(); });
+    }
+
+    // 后台运行的无栈协程，执行完自动销毁协程帧
+    struct DetachedTask
+    {
+        struct promise_type
+        {
+            DetachedTask get_return_object() noexcept
+            {
+                return DetachedTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+
+            std::suspend_never final_suspend() const noexcept { return {}; }
+
+            void return_void() const noexcept {}
+
+            void unhandled_exception() const noexcept { std::terminate(); }
+        };
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    namespace detail
+    {
+        template <typename T>
+        DetachedTask RunDetached(Task<T> task)
+        {
+            try
+            {
+                co_await task;
+            }
+            catch (std::exception &e)
+            {
+                DBSPIDER_LOG_ERROR(DBSPIDER_LOG_NAME("system")) << "Task Except: " << e.what();
+            }
+            catch (...)
+            {
+                DBSPIDER_LOG_ERROR(DBSPIDER_LOG_NAME("system")) << "Task Except";
+            }
+        }
+
+        // SyncWait 的等待状态，放在等待协程的栈上
+        template <typename T>
+        struct SyncWaitState
+        {
+            using value_type = std::conditional_t<std::is_void_v<T>, char, T>;
+
+            Fiber::ptr fiber;                // 等待的协程
+            Scheduler *scheduler = nullptr;  // 等待协程所在的调度器
+            std::atomic<bool> done{false};   // 任务结束和协程挂起，后到的一方负责唤醒协程
+            std::exception_ptr exception;    // 任务抛出的异常
+            std::optional<value_type> value; // 任务的返回值
+        };
+
+        template <typename T>
+        DetachedTask RunSyncWait(Task<T> task, SyncWaitState<T> *state)
+        {
+            try
+            {
+                if constexpr (std::is_void_v<T>)
+                {
+                    co_await task;
+                }
+                else
+                {
+                    state->value.emplace(co_await task);
+                }
+            }
+            catch (...)
+            {
+                state->exception = std::current_exception();
+            }
+            // exchange 之后 state 可能已经随着等待协程返回而失效，只能使用局部变量
+            Fiber::ptr fiber = state->fiber;
+            Scheduler *scheduler = state->scheduler;
+            if (state->done.exchange(true))
+            {
+                scheduler->submit(fiber);
+            }
+        }
+    }
+
+    // 在调度器上后台运行一个无栈协程，默认使用当前线程的调度器
+    template <typename T>
+    void CoSpawn(Task<T> task, Scheduler *scheduler = Scheduler::GetThis())
+    {
+        DBSPIDER_ASSERT(scheduler);
+        ResumeOn(scheduler, detail::RunDetached(std::move(task)).handle);
+    }
+
+    // 在有栈协程中同步等待无栈协程执行完毕，期间当前协程让出执行权
+    // 返回任务的返回值，任务抛出的异常会在这里重新抛出
+    template <typename T>
+    T SyncWait(Task<T> task)
+    {
+        detail::SyncWaitState<T> state;
+        state.fiber = Fiber::GetThis();
+        state.scheduler = Scheduler::GetThis();
+        DBSPIDER_ASSERT(state.scheduler);
+        // 直接在当前协程中开始执行，任务如果没有挂起就不需要切换
+        detail::RunSyncWait(std::move(task), &state).handle.resume();
+        if (!state.done.exchange(true))
+        {
+            Fiber::YieldToHold();
+        }
+        if (state.exception)
+        {
+            std::rethrow_exception(state.exception);
+        }
+        if constexpr (!std::is_void_v<T>)
+        {
+            return std::move(*state.value);
+        }
+    }
+
+    // co_await CoSleep(ms)：挂起 ms 毫秒，由定时器恢复
+    class SleepAwaiter
+    {
+    public:
+        explicit SleepAwaiter(uint64_t us) : m_us(us) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle) const
+        {
+            IOManager *iom = IOManager::GetThis();
+            DBSPIDER_ASSERT(iom);
+            iom->addTimerUS(m_us, [handle]
+                            { handle.resume(); });
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        uint64_t m_us;
+    };
+
+    inline SleepAwaiter CoSleep(uint64_t ms) { return SleepAwaiter(ms * 1000); }
+
+    // co_await CoSleepUS(us)：挂起 us 微秒
+    inline SleepAwaiter CoSleepUS(uint64_t us) { return SleepAwaiter(us); }
+
+    // co_await CoYield()：让出执行权，重新排到调度队列的末尾
+    class YieldAwaiter
+    {
+    public:
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle) const
+        {
+            Scheduler *scheduler = Scheduler::GetThis();
+            DBSPIDER_ASSERT(scheduler);
+            ResumeOn(scheduler, handle);
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    inline YieldAwaiter CoYield() { return YieldAwaiter(); }
+
+    /**
+     * co_await EventAwaiter(fd, event, timeout)：等待 fd 上的读写事件
+     * 与 hook 的 do_io 一样，超时由条件定时器取消事件来唤醒
+     * 返回值：0 表示事件就绪; ETIMEDOUT 表示超时; 其他表示注册事件失败时的 errno
+     */
+    class EventAwaiter
+    {
+    public:
+        EventAwaiter(int fd, IOManager::Event event, uint64_t timeout_ms = (uint64_t)-1)
+            : m_fd(fd),
+              m_event(event),
+              m_timeout(timeout_ms)
+        {
+        }
+
+        bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> handle);
+
+        int await_resume();
+
+    private:
+        int m_fd;
+        IOManager::Event m_event;
+        uint64_t m_timeout;
+        int m_error = 0;                     // 注册事件失败时的错误
+        Timer::ptr m_timer;                  // 超时定时器
+        std::shared_ptr<int> m_timeoutError; // 超时后置为 ETIMEDOUT
+    };
+
+    // 无栈协程版本的 IO，fd 需要是 hook 过的 socket 或者系统非阻塞的 fd
+    // 返回值和 errno 与对应的系统调用一致，超时时间取 setsockopt 设置的 SO_RCVTIMEO/SO_SNDTIMEO
+    Task<ssize_t> AsyncRead(int fd, void *buf, size_t count);
+
+    Task<ssize_t> AsyncWrite(int fd, const void *buf, size_t count);
+
+    Task<ssize_t> AsyncRecv(int fd, void *buf, size_t len, int flags = 0);
+
+    Task<ssize_t> AsyncSend(int fd, const void *buf, size_t len, int flags = 0);
+}
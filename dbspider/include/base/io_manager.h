@@ -4,12 +4,18 @@
 #include <memory>
 
 #include "scheduler.h"
+#include "segmented_array.h"
 #include "sync.h"
 #include "timer.h"
 
+struct epoll_event;
+struct io_uring_sqe;
+
 namespace dbspider
 {
-    // 基于Epoll的IO协程调度器
+    class IoUring;
+
+    // 基于Epoll的IO协程调度器，配置 iomanager.io_backend=io_uring 时套接字读写改由 io_uring 完成
     class IOManager : public Scheduler, public TimeManager
     {
     public:
@@ -36,6 +42,7 @@ namespace dbspider
                 Scheduler *scheduler = nullptr; // 事件执行的调度器
                 Fiber::ptr fiber;               // 事件的协程
                 std::function<void()> cb;       // 事件的回调函数
+                int thread = -1;                // 事件触发后在哪个线程恢复执行，-1 表示任意线程
 
                 bool empty()
                 {
@@ -52,11 +59,15 @@ namespace dbspider
             // 触发事件
             void triggerEvent(Event event);
 
-            int fd = 0;          // 事件关联句柄
-            EventContext read;   // 读事件上下文
-            EventContext write;  // 写事件上下文
-            Event events = NONE; // 注册的事件类型
-            MutexType mutex;     // 事件的Mutex
+            int fd = 0;              // 事件关联句柄
+            EventContext read;       // 读事件上下文
+            EventContext write;      // 写事件上下文
+            Event events = NONE;     // 注册的事件类型
+            MutexType mutex;         // 事件的Mutex
+            bool persistent = false; // 是否以常驻方式注册在epoll中
+            int ready = NONE;        // 常驻注册时，没有等待者期间已经就绪过的事件
+            uint64_t generation = 0; // 常驻注册时fd的代数(FdCtx::getGeneration)，不同说明fd已经关闭并被复用
+            int owner = -1;          // 多 reactor 模式下拥有该fd的调度线程下标
         };
 
     public:
@@ -65,7 +76,9 @@ namespace dbspider
         ~IOManager();
 
         // 添加事件
-        bool addEvent(int fd, Event event, std::function<void()> cb = nullptr);
+        // 常驻注册下该方向在没有等待者时已经就绪过：传入 ready 时不注册，置 *ready 为 true ，由调用方直接重试系统调用；
+        // 当前协程还没有 yield ，不能交给调度器。没有传入 ready 时同原来一样直接触发事件
+        bool addEvent(int fd, Event event, std::function<void()> cb = nullptr, bool *ready = nullptr);
 
         // 删除事件
         bool delEvent(int fd, Event event);
@@ -73,18 +86,67 @@ namespace dbspider
         // 取消事件
         bool cancelEvent(int fd, Event event);
 
-        // 取消所有事件
+        // 取消所有事件，常驻注册的fd同时从epoll中删除，关闭fd之前调用
         bool cancelAllEvent(int fd);
 
+        // 是否开启了常驻注册模式
+        bool isPersistent() const { return m_persistent; }
+
+        // 是否开启了多 reactor 模式，每个调度线程使用自己的epoll
+        bool isMultiReactor() const { return !m_epfds.empty(); }
+
+        // 把fd分配给下标为 index 的调度线程，之后fd的事件只在该线程的epoll上等待，等待它的协程也在该线程恢复
+        // fd 正在epoll中注册时不能更换所属线程，返回 false
+        bool setFdOwner(int fd, size_t index);
+
+        // fd所属调度线程的下标，没有分配时返回 -1
+        int getFdOwner(int fd);
+
+        // 下标为 index 的调度线程拥有的fd数量
+        size_t getOwnedFdCount(size_t index) const { return m_ownedFds[index].load(std::memory_order_relaxed); }
+
+        // 调用 epoll_ctl 的次数
+        uint64_t getEpollCtlCount() const { return m_epollCtls.load(std::memory_order_relaxed); }
+
+        // 空闲线程睡眠之前自旋的时间(us)，0 表示不自旋
+        uint64_t getIdleSpinUs() const { return m_idleSpinUs; }
+
+        // 自旋期间等到事件或任务、因此没有进入睡眠的次数
+        uint64_t getIdleSpinHits() const { return m_idleSpinHits.load(std::memory_order_relaxed); }
+
         // 返回当前的IOManager
         static IOManager *GetThis();
 
+        // 是否使用 io_uring 后端
+        bool isIoUring() const { return (bool)m_uring; }
+
+        /**
+         * 通过 io_uring 执行一个IO操作，挂起当前协程直到操作完成
+         * sqe 中填好操作码和参数，user_data 由本函数设置；SQE 不会立即提交，而是在调度循环中攒批提交
+         * timeout 为超时时间(ms)，~0ull 表示不超时，超时的操作以 -ECANCELED 完成
+         * 挂起期间当前协程的取消令牌被取消时，提交 IORING_OP_ASYNC_CANCEL 取消这个请求，同样以 -ECANCELED 完成
+         * 返回 CQE 的结果，失败时为 -errno
+         */
+        int submitIo(const io_uring_sqe &sqe, uint64_t timeout = ~0ull);
+
+        // 取消fd上所有通过 io_uring 提交、还没有完成的IO，关闭fd之前调用
+        void cancelIo(int fd);
+
     protected:
         // 通知调度器有任务要调度
         // 写 pipe 让 wait 协程从 epoll_wait 退出，待 wait 协程 yield 之后 Scheduler::run 就可以调度其他任务
-        // 如果当前没有空闲调度线程，那就没必要发通知
+        // 如果当前没有空闲调度线程，或者有线程正在自旋（它会自己取到任务），那就没必要发通知
         void notify() override;
 
+        // 多 reactor 模式下拥有fd的线程不能停放
+        bool canRetire(size_t index) override;
+
+        // 只唤醒指定的调度线程，线程停放时先恢复它
+        // 多 reactor 模式下写目标线程自己的 eventfd ，它只注册在目标线程的epoll上
+        // 所有线程共享一个epoll时退而使用实时信号：调度线程平时屏蔽它，只在 epoll_pwait 期间原子地解除屏蔽，
+        // 不会出现信号在检查队列和进入 epoll_pwait 之间丢失的情况
+        void notifyThread(size_t index) override;
+
         // wait(idle)协程
         // 对于IO协程调度来说，应阻塞在等待IO事件上， wait 退出的时机是 epoll_wait 返回，对应的操作是 notify 或注册的IO事件就绪
         // 调度器无调度任务时会阻塞在 wait 协程上，对IO调度器而言， wait 状态应该关注两件事，一是有没有新的调度任务，对应Schduler::submit()，
@@ -94,20 +156,78 @@ namespace dbspider
 
         bool stopping() override;
 
-        // 重置socket句柄上下文的容器大小
-        void contextResize(size_t size);
+        // 找到fd对应的FdContext，auto_create 为 true 时不存在就分配一个
+        FdContext *getFdContext(int fd, bool auto_create = false);
 
         void onInsertAtFront() override;
 
-        // 判断是否可以停止
+        size_t getTimerShard() override;
+
+        // 每轮调度循环中提交攒够一批的 SQE，并收割已经完成的IO；
+        // 线程一直忙碌、进不了 idle 时，每隔 m_busyTimerUs 在这里处理一次到期的定时器
+        void poll() override;
+
+        // 把到期定时器的回调加入调度，高优先级定时器的回调进入高优先级队列
+        void submitExpiredTimers();
+
+        // 判断是否可以停止，timeout 返回到最近一个定时器执行的时间间隔(us)
         bool stopping(uint64_t &timeout);
 
+        // 设置 timerfd 在 timeout 微秒后触发，唤醒等待定时器的线程，已经设置了更早的时间时不修改
+        void setTimerFd(uint64_t timeout);
+
+        // 修改fd在所属epoll中的注册，并统计调用次数
+        int epollCtl(FdContext *fdContext, int op, epoll_event *event);
+
+        // fd 分配给了已经退役的线程时唤醒它，调用方已经增加了该线程拥有的fd数量
+        void wakeOwner(size_t index);
+
+        // 释放fd所属的调度线程
+        void releaseOwner(FdContext *fdContext);
+
+        // 写 eventfd 唤醒一个空闲线程，已经有唤醒还没被处理时合并
+        void tickle();
+
+        // 睡眠之前自旋最多 us 微秒，不阻塞地轮询epoll、全局队列和专属队列
+        // 返回就绪的事件数，有待执行的任务时返回 -1，超时返回 0
+        int idleSpin(int epfd, epoll_event *events, int max_events, uint64_t us);
+
+        // 把攒下的 SQE 提交给内核，调用方持有 m_uringMutex
+        void flushIo();
+
+        // 提交一个取消请求并立即交给内核，target 为要取消的请求的 user_data，调用方持有 m_uringMutex
+        bool submitCancel(int fd, uint64_t target, uint32_t flags);
+
+        // 收割完成队列，把完成IO的协程重新加入调度
+        void reapIo();
+
     private:
+        struct IoRequest;
+
         int m_epfd;                                    // epoll 文件句柄
-        int m_tickleFds[2];                            // pipe 文件句柄
+        int m_tickleFd;                                // eventfd 文件句柄，用于唤醒空闲线程
+        std::atomic<bool> m_tickled = {false};         // 是否有已经发出、还没有被空闲线程处理的唤醒
+        int m_timerFd;                                 // timerfd 文件句柄，用于定时器的精确唤醒
+        Mutex m_timerFdMutex;                          // 保护 timerfd 的设置
+        uint64_t m_timerFdDeadline = 0;                // timerfd 当前设置的到期时间(CLOCK_MONOTONIC，us)
         std::atomic<size_t> m_pendingEventCount = {0}; // 当前等待执行的事件数量
-        RWMutexType m_mutex;                           // IOManager的mutex
-        std::vector<FdContext *> m_fdContexts;         // socket事件上下文的容器
+        SegmentedArray<FdContext> m_fdContexts;        // socket事件上下文的容器，以fd为下标，查找不加锁
+        std::vector<std::atomic<bool>> m_sleeping;     // 各调度线程是否阻塞在 epoll_pwait 上
+        bool m_persistent = false;                     // socket是否在整个生命周期内只注册一次epoll
+        std::vector<int> m_epfds;                      // 多 reactor 模式下每个调度线程的epoll文件句柄
+        std::vector<int> m_wakeFds;                    // 多 reactor 模式下每个调度线程的 eventfd ，用于定向唤醒
+        int m_wakeupSignal = 0;                        // 共享epoll时定向唤醒用的实时信号，多 reactor 模式下为0
+        std::vector<std::atomic<size_t>> m_ownedFds;   // 每个调度线程拥有的fd数量
+        std::atomic<uint64_t> m_epollCtls = {0};       // 调用 epoll_ctl 的次数
+        uint64_t m_idleSpinUs = 0;                     // 空闲线程睡眠之前自旋的时间(us)
+        uint64_t m_busyTimerUs = 0;                    // 忙碌的线程检查到期定时器的间隔(us)，0 表示只在 idle 中检查
+        std::atomic<uint64_t> m_idleSpinHits = {0};    // 自旋期间等到事件或任务的次数
+        std::atomic<size_t> m_spinning = {0};          // 正在自旋的线程数，不为0时提交任务不写 eventfd
+        std::unique_ptr<IoUring> m_uring;              // io_uring 实例，使用 epoll 后端时为空
+        int m_uringEventFd = -1;                       // 注册到 io_uring 的 eventfd，有IO完成时唤醒 epoll_wait
+        Mutex m_uringMutex;                            // 保护 io_uring 的提交队列和完成队列
+        std::atomic<uint32_t> m_uringPending = {0};    // 已经填好、还没有提交的 SQE 数
+        uint32_t m_uringBatch = 0;                     // 攒够多少个 SQE 后在调度循环中提交
     };
 
 #define go (*dbspider::IOManager::GetThis()) +
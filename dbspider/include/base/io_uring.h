@@ -0,0 +1,90 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+
+#include "noncopyable.h"
+
+namespace dbspider
+{
+    /**
+     * io_uring 的最小封装，直接使用 io_uring_setup/io_uring_enter/io_uring_register 系统调用，不依赖 liburing
+     * 提交队列和完成队列通过 mmap 映射到用户态，本类不加锁，由调用方保证互斥
+     * 内核不支持或被禁用时 isValid() 返回 false，调用方应退回 epoll
+     */
+    class IoUring : Noncopyable
+    {
+    public:
+        explicit IoUring(unsigned entries);
+
+        ~IoUring();
+
+        // 是否初始化成功
+        bool isValid() const { return m_ringFd >= 0; }
+
+        // 取一个清零的 SQE，提交队列满时返回 nullptr
+        io_uring_sqe *getSqe();
+
+        // 提交队列中剩余的空位
+        unsigned space() const;
+
+        // 已经填好、还没有提交给内核的 SQE 数
+        unsigned pending() const { return m_sqeTail - m_sqeHead; }
+
+        // 把填好的 SQE 一次提交给内核，返回内核接收的个数，失败返回 -errno
+        int submit();
+
+        // 完成队列是否有未处理的 CQE，可以不加锁调用，结果只作为提示
+        bool hasCompletions() const
+        {
+            return std::atomic_ref<unsigned>(*m_cqTail).load(std::memory_order_acquire) !=
+                   std::atomic_ref<unsigned>(*m_cqHead).load(std::memory_order_relaxed);
+        }
+
+        // 依次处理完成队列中的 CQE，返回处理的个数
+        template <typename Fn>
+        unsigned reap(Fn &&fn)
+        {
+            unsigned head = *m_cqHead;
+            unsigned tail = std::atomic_ref<unsigned>(*m_cqTail).load(std::memory_order_acquire);
+            unsigned count = 0;
+            for (; head != tail; ++head, ++count)
+            {
+                fn(&m_cqes[head & m_cqMask]);
+            }
+            std::atomic_ref<unsigned>(*m_cqHead).store(head, std::memory_order_release);
+            return count;
+        }
+
+        // 注册 eventfd，有新的 CQE 时内核向它写入，用于唤醒 epoll_wait
+        bool registerEventFd(int fd);
+
+        // 内核是否支持全部这些操作
+        bool probe(std::initializer_list<int> ops);
+
+    private:
+        int m_ringFd = -1;
+
+        void *m_sqRing = nullptr; // 提交队列的映射
+        void *m_cqRing = nullptr; // 完成队列的映射，内核支持 IORING_FEAT_SINGLE_MMAP 时与提交队列相同
+        size_t m_sqRingSize = 0;
+        size_t m_cqRingSize = 0;
+        io_uring_sqe *m_sqes = nullptr; // SQE 数组
+        size_t m_sqesSize = 0;
+
+        unsigned *m_sqHead = nullptr;
+        unsigned *m_sqTail = nullptr;
+        unsigned *m_sqArray = nullptr;
+        unsigned m_sqMask = 0;
+        unsigned m_sqEntries = 0;
+        unsigned m_sqeHead = 0; // 已经提交给内核的位置
+        unsigned m_sqeTail = 0; // 已经取出 SQE 的位置
+
+        unsigned *m_cqHead = nullptr;
+        unsigned *m_cqTail = nullptr;
+        io_uring_cqe *m_cqes = nullptr;
+        unsigned m_cqMask = 0;
+    };
+}
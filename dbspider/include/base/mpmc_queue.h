@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "noncopyable.h"
+
+namespace dbspider
+{
+    /**
+     * 有界多生产者多消费者无锁队列（Dmitry Vyukov 的环形队列）
+     * 每个槽位带一个序号：序号等于入队位置时可以写入，等于入队位置 + 1 时可以读出，
+     * 读出后序号加上容量，留给下一圈的生产者。生产者和消费者各自只在位置计数上 CAS 一次，不加锁
+     * 容量固定为 2 的幂，满了 push 返回 false，由调用方决定退化到哪里
+     * 空出来的槽位保存默认构造的 T，T 需要可以默认构造和移动赋值
+     */
+    template <typename T>
+    class MpmcQueue : Noncopyable
+    {
+    public:
+        // capacity 向上取整到 2 的幂，至少为 2
+        explicit MpmcQueue(size_t capacity)
+        {
+            size_t cap = 2;
+            while (cap < capacity)
+            {
+                cap <<= 1;
+            }
+            m_mask = cap - 1;
+            m_cells.reset(new Cell[cap]);
+            for (size_t i = 0; i < cap; ++i)
+            {
+                m_cells[i].seq.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        // 入队，队列满时返回 false，v 保持不变
+        bool push(T &&v)
+        {
+            Cell *cell;
+            size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &m_cells[pos & m_mask];
+                size_t seq = cell->seq.load(std::memory_order_acquire);
+                intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+                if (dif == 0)
+                {
+                    if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (dif < 0)
+                {
+                    // 槽位还没被上一圈的消费者取走，队列满了
+                    return false;
+                }
+                else
+                {
+                    pos = m_enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+            cell->data = std::move(v);
+            cell->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // 出队，队列为空（或者队头的生产者还没写完）时返回 false
+        bool pop(T &v)
+        {
+            Cell *cell;
+            size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &m_cells[pos & m_mask];
+                size_t seq = cell->seq.load(std::memory_order_acquire);
+                intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+                if (dif == 0)
+                {
+                    if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (dif < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+            v = std::move(cell->data);
+            cell->data = T();
+            cell->seq.store(pos + m_mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        // 队列中的元素个数，并发时只是一个估计值
+        size_t size() const
+        {
+            size_t dequeue = m_dequeuePos.load(std::memory_order_acquire);
+            size_t enqueue = m_enqueuePos.load(std::memory_order_acquire);
+            return enqueue > dequeue ? enqueue - dequeue : 0;
+        }
+
+        bool empty() const { return size() == 0; }
+
+        size_t capacity() const { return m_mask + 1; }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> seq;
+            T data;
+        };
+
+    private:
+        // 生产者和消费者的位置放在不同的缓存行，避免互相干扰
+        alignas(64) std::atomic<size_t> m_enqueuePos{0};
+        alignas(64) std::atomic<size_t> m_dequeuePos{0};
+        alignas(64) std::unique_ptr<Cell[]> m_cells;
+        size_t m_mask;
+    };
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+namespace dbspider
+{
+    /**
+     * 基于数组的环形队列，容量为 2 的幂，满了翻倍，不会缩小
+     * 与 std::list/std::deque 不同，队列容量稳定之后入队出队都不分配内存
+     * 空出来的槽位保存默认构造的 T，T 需要可以默认构造和移动赋值；不是线程安全的
+     */
+    template <typename T>
+    class RingQueue
+    {
+    public:
+        static constexpr size_t INIT_CAPACITY = 16;
+
+        bool empty() const { return m_size == 0; }
+
+        size_t size() const { return m_size; }
+
+        size_t capacity() const { return m_mask ? m_mask + 1 : 0; }
+
+        // 从队头数第 i 个元素
+        T &operator[](size_t i) { return m_slots[(m_head + i) & m_mask]; }
+
+        T &front() { return (*this)[0]; }
+
+        T &back() { return (*this)[m_size - 1]; }
+
+        void push_back(T &&v)
+        {
+            if (m_size == capacity())
+            {
+                grow();
+            }
+            (*this)[m_size++] = std::move(v);
+        }
+
+        void pop_front()
+        {
+            front() = T();
+            m_head = (m_head + 1) & m_mask;
+            --m_size;
+        }
+
+        void pop_back()
+        {
+            back() = T();
+            --m_size;
+        }
+
+        // 删除第 i 个元素，移动离得近的一端补上空位
+        void erase(size_t i)
+        {
+            if (i < m_size / 2)
+            {
+                for (; i > 0; --i)
+                {
+                    (*this)[i] = std::move((*this)[i - 1]);
+                }
+                pop_front();
+            }
+            else
+            {
+                for (; i + 1 < m_size; ++i)
+                {
+                    (*this)[i] = std::move((*this)[i + 1]);
+                }
+                pop_back();
+            }
+        }
+
+        void clear()
+        {
+            while (m_size)
+            {
+                pop_back();
+            }
+            m_head = 0;
+        }
+
+    private:
+        void grow()
+        {
+            size_t cap = m_mask ? (m_mask + 1) * 2 : INIT_CAPACITY;
+            std::unique_ptr<T[]> slots(new T[cap]);
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                slots[i] = std::move((*this)[i]);
+            }
+            m_slots = std::move(slots);
+            m_head = 0;
+            m_mask = cap - 1;
+        }
+
+    private:
+        std::unique_ptr<T[]> m_slots;
+        size_t m_head = 0; // 队头的下标
+        size_t m_size = 0;
+        size_t m_mask = 0; // 容量 - 1，还没分配时为0
+    };
+}
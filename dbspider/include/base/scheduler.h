@@ -1,12 +1,14 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
-#include <list>
 #include <memory>
 #include <string>
-#include <queue>
 #include <vector>
 #include "fiber.h"
+#include "mpmc_queue.h"
+#include "ring_queue.h"
+#include "small_task.h"
 #include "sync.h"
 #include "macro.h"
 #include "thread.h"
@@ -19,12 +21,39 @@ namespace dbspider
         using ptr = std::shared_ptr<Scheduler>;
         using MutexType = Mutex;
 
+        // 唤醒空闲线程和任务运行时间的统计
+        struct Stats
+        {
+            uint64_t tickles = 0;         // 请求唤醒空闲线程的次数
+            uint64_t tickleWrites = 0;    // 实际发出唤醒的系统调用次数
+            uint64_t tickleSaved = 0;     // 没有空闲线程或已有唤醒未处理，被合并掉的唤醒次数
+            uint64_t maxRunUs = 0;        // 协程不让出、连续占用调度线程的最长时间(us)
+            uint64_t preemptRequests = 0; // 看门狗请求抢占的次数
+            uint64_t longRuns = 0;        // 看门狗报告的长时间不让出的次数
+        };
+
         Scheduler(size_t threads = 4, const std::string &name = "");
 
         virtual ~Scheduler();
 
         const std::string &getName() const { return m_name; }
 
+        // 调度线程数量，弹性线程池中为当前运行的线程数，运行的线程总是下标 [0, getThreadCount()) 的线程
+        size_t getThreadCount() const { return m_threadCount.load(std::memory_order_relaxed); }
+
+        // 线程池容量，线程数可以在 [1, getMaxThreads()] 之间调整
+        size_t getMaxThreads() const { return m_maxThreads; }
+
+        // 调整运行的调度线程数，超出容量时取容量
+        // 增加时先唤醒停放的线程，不够再创建新线程；减少时下标靠后的线程做完专属任务后停放
+        void setThreadCount(size_t threads);
+
+        // 线程池中下标为 index 的线程ID，可以作为 submit 的 thread 参数，线程还没有创建时返回0
+        int getThreadId(size_t index) const { return m_threadIds[index]; }
+
+        // 当前线程在本调度器线程池中的下标，非本调度器线程返回-1
+        int getCurrentIndex() const;
+
         // 启动调度器
         void start();
 
@@ -32,33 +61,30 @@ namespace dbspider
         void stop();
 
         // 提交任务到调度器，任务可以是协程或者可调用对象
+        // 指定了线程的任务进入该线程的专属队列，只唤醒该线程
+        // 工作窃取模式下，调度线程自己提交的任务进入本线程的本地队列，其余任务进入全局注入队列
+        // 全局注入队列是无锁的有界队列，满了之后退化到加锁的溢出队列
+        // 高优先级的任务进入单独的队列，调度线程先取高优先级队列；协程取 priority 和协程自身优先级中较高的一个
+        // 可调用对象直接移动进 SmallTask，捕获不超过 SmallTask::INLINE_SIZE 字节时提交不分配内存
         template <typename FiberOrCb>
-        [[maybe_unused]] Scheduler *submit(FiberOrCb &&fc, int thread = -1)
+        [[maybe_unused]] Scheduler *submit(FiberOrCb &&fc, int thread = -1, Fiber::Priority priority = Fiber::NORMAL)
         {
-            bool need_notify = false;
-            {
-                MutexType::Lock lock(m_mutex);
-                need_notify = submitNoLock(std::forward<FiberOrCb>(fc), thread);
-            }
-            if (need_notify)
+            if (submitTask(std::forward<FiberOrCb>(fc), thread, priority))
             {
                 notify();
             }
             return this;
         }
 
-        // 批量调度协程
+        // 批量调度协程，每个任务与单个提交一样分发到专属队列、本地队列或全局注入队列，最后只通知一次
         template <class InputIterator>
-        void submit(InputIterator begin, InputIterator end)
+        void submit(InputIterator begin, InputIterator end, Fiber::Priority priority = Fiber::NORMAL)
         {
             bool need_notify = false;
+            while (begin != end)
             {
-                MutexType::Lock lock(m_mutex);
-                while (begin != end)
-                {
-                    need_notify = submitNoLock(std::move(*begin), -1) || need_notify;
-                    ++begin;
-                }
+                need_notify = submitTask(std::move(*begin), -1, priority) || need_notify;
+                ++begin;
             }
             if (need_notify)
             {
@@ -74,10 +100,41 @@ namespace dbspider
 
         static Scheduler *GetThis();
 
+        // 是否开启了工作窃取调度模式
+        bool isWorkStealing() const { return m_workStealing; }
+
+        // 第 index 个调度线程绑定的 CPU ，没有配置 scheduler.cpu_affinity 时返回-1
+        int getCpu(size_t index) const;
+
+        // 获取唤醒和运行时间统计
+        Stats getStats() const;
+
     protected:
         // 通知协程调度器有任务了
         virtual void notify();
 
+        // 通知指定下标的调度线程有专属任务了，默认退化为notify
+        virtual void notifyThread(size_t index);
+
+        // 当前线程的专属队列是否有任务
+        bool hasPinnedTasks();
+
+        // 全局注入队列或本地队列中是否有等待执行的任务
+        bool hasPendingTasks();
+
+        // 全局队列（无锁注入队列、溢出队列、高优先级队列）中是否有任务，不加锁，结果只作为提示
+        bool hasGlobalTasks() const
+        {
+            return m_taskCount.load(std::memory_order_relaxed) || m_highTaskCount.load(std::memory_order_relaxed) ||
+                   (m_inject && !m_inject->empty());
+        }
+
+        // 下标为 index 的线程退役时是否可以停放，子类可以让持有资源的线程继续运行
+        virtual bool canRetire(size_t index) { return true; }
+
+        // 唤醒停放的线程，调用方需要先修改唤醒条件并执行一次全序内存屏障
+        void unpark(size_t index);
+
         // 协程调度函数
         void run();
 
@@ -87,6 +144,9 @@ namespace dbspider
         // 协程无任务可调度时执行wait协程
         virtual void wait();
 
+        // 每轮调度循环取任务之前调用，子类可以在这里批量处理自己的事件源，默认什么都不做
+        virtual void poll() {}
+
         // 设置当前的协程调度器
         void setThis();
 
@@ -94,55 +154,153 @@ namespace dbspider
         bool hasIdleThreads() { return m_idleThreads > 0; }
 
     private:
-        // 添加调度任务（无锁）
+        struct ScheduleTask;
+        using TaskQueue = RingQueue<ScheduleTask>; // 调度任务队列，容量稳定后入队出队不分配内存
+        struct LocalQueue;
+        struct Slice;
+
+        // 共享栈协程只能回到绑定的线程上运行
+        static int BoundThread(const Fiber::ptr &fiber, int thread)
+        {
+            return thread == -1 && fiber ? fiber->getBoundThread() : thread;
+        }
+
+        template <class Cb>
+        static int BoundThread(const Cb &, int thread)
+        {
+            return thread;
+        }
+
+        // 协程的优先级是粘性的，提交时取两者中较高的一个
+        static Fiber::Priority TaskPriority(const Fiber::ptr &fiber, Fiber::Priority priority)
+        {
+            return fiber ? std::min(priority, fiber->getPriority()) : priority;
+        }
+
+        template <class Cb>
+        static Fiber::Priority TaskPriority(const Cb &, Fiber::Priority priority)
+        {
+            return priority;
+        }
+
+        // 按 submit 的规则把一个任务放进对应的队列，返回是否需要调用 notify
+        // 专属队列的任务在这里直接唤醒目标线程
         template <typename FiberOrCb>
-        bool submitNoLock(FiberOrCb &&fc, int thread)
+        bool submitTask(FiberOrCb &&fc, int thread, Fiber::Priority priority)
         {
-            bool need_notify = m_tasks.empty();
-            ScheduleTask task(std::forward<FiberOrCb>(fc), thread);
-            if (task)
+            thread = BoundThread(fc, thread);
+            priority = TaskPriority(fc, priority);
+            bool high = priority == Fiber::HIGH;
+            if (thread != -1)
             {
-                m_tasks.push_back(task);
+                int index = getThreadIndex(thread);
+                if (index >= 0)
+                {
+                    LocalQueue *pinned = high ? m_pinnedHighQueues[index].get() : m_pinnedQueues[index].get();
+                    if (submitLocal(pinned, std::forward<FiberOrCb>(fc), priority))
+                    {
+                        notifyThread(index);
+                    }
+                    return false;
+                }
             }
+            // 高优先级任务不进本地队列，任何空闲线程都可以立即取走
+            LocalQueue *local = thread == -1 && !high ? getLocalQueue() : nullptr;
+            if (local)
+            {
+                return submitLocal(local, std::forward<FiberOrCb>(fc));
+            }
+            return submitGlobal(ScheduleTask(std::forward<FiberOrCb>(fc), thread), priority);
+        }
+
+        // 添加调度任务到加锁的全局队列（调用方持有 m_mutex）
+        bool submitNoLock(ScheduleTask &&task, Fiber::Priority priority);
+
+        // 添加调度任务到全局队列：没有指定线程的普通任务先尝试无锁注入队列，其余的加锁进入溢出队列或高优先级队列
+        bool submitGlobal(ScheduleTask &&task, Fiber::Priority priority);
+
+        // 添加调度任务到当前线程的本地队列
+        template <typename FiberOrCb>
+        bool submitLocal(LocalQueue *local, FiberOrCb &&fc, Fiber::Priority priority = Fiber::NORMAL)
+        {
+            ScheduleTask task(std::forward<FiberOrCb>(fc), -1);
+            if (!task)
+            {
+                return false;
+            }
+            task.priority = priority;
+            LocalQueue::MutexType::Lock lock(local->mutex);
+            bool need_notify = local->tasks.empty();
+            local->tasks.push_back(std::move(task));
             return need_notify;
         }
 
+        // 获取当前线程在本调度器中的本地队列，非工作窃取模式或非本调度器线程返回nullptr
+        LocalQueue *getLocalQueue();
+
+        // 根据线程ID查找线程在线程池中的下标，找不到返回-1
+        // 查 m_threadIndex 哈希表，不加锁，每次指定线程的提交不再遍历整个线程池
+        int getThreadIndex(int thread) const;
+
+        // 从本地队列取一个可执行的任务
+        bool popLocal(LocalQueue *local, ScheduleTask &task, bool &tickle);
+
+        // 依次从无锁注入队列和溢出队列取一个可执行的任务
+        bool popInject(ScheduleTask &task, bool &tickle);
+
+        // 从加锁的全局队列 tasks （溢出队列或高优先级队列）取一个可执行的任务
+        bool popGlobal(TaskQueue &tasks, ScheduleTask &task, bool &tickle);
+
+        // 依次从专属高优先级队列和全局高优先级队列取任务，退役的线程不取全局队列
+        bool popHigh(LocalQueue *pinned, ScheduleTask &task, bool &tickle, bool retiring);
+
+        // 从其他线程的本地队列窃取一半任务到本地队列，并返回其中一个
+        bool steal(size_t index, ScheduleTask &task, bool &tickle);
+
+        // 创建下标为 index 的调度线程，调用方持有 m_resizeMutex
+        void spawn(size_t index);
+
+        // 退役的线程在没有任务时停放，被唤醒后返回true；需要继续运行时返回false
+        bool park(size_t index);
+
+        // 弹性线程池的监控线程，根据负载增减运行的线程数
+        void monitor();
+
+        // 看门狗线程，协程占用线程超过时间片时置抢占标记，超过报告阈值时打印警告
+        void watchdog();
+
+        // 调度线程开始和结束运行一个任务时记录运行片，结束时更新最长运行时间
+        void beginSlice(Slice *slice, uint64_t fiber_id);
+        void endSlice(Slice *slice);
+
     private:
+        // 调度任务只能移动，入队出队都不复制协程指针和回调
         struct ScheduleTask
         {
             Fiber::ptr fiber;
-            std::function<void()> cb;
+            SmallTask cb;
             int thread;
+            Fiber::Priority priority = Fiber::NORMAL; // 回调任务运行时协程的优先级
 
-            ScheduleTask(Fiber::ptr &f, int t = -1)
+            ScheduleTask(Fiber::ptr f, int t = -1)
+                : fiber(std::move(f)), thread(t)
             {
-                fiber = f;
-                thread = t;
             }
-            ScheduleTask(Fiber::ptr &&f, int t = -1)
+            template <typename Cb, typename = std::enable_if_t<!std::is_convertible_v<Cb, Fiber::ptr>>>
+            ScheduleTask(Cb &&f, int t = -1)
+                : cb(std::forward<Cb>(f)), thread(t)
             {
-                fiber = std::move(f);
-                thread = t;
-                f = nullptr;
-            }
-            ScheduleTask(std::function<void()> &f, int t = -1)
-            {
-                cb = f;
-                thread = t;
-            }
-            ScheduleTask(std::function<void()> &&f, int t = -1)
-            {
-                cb = std::move(f);
-                thread = t;
-                f = nullptr;
             }
             ScheduleTask()
             {
                 thread = -1;
             }
+            ScheduleTask(ScheduleTask &&) = default;
+            ScheduleTask &operator=(ScheduleTask &&) = default;
             void reset()
             {
                 thread = -1;
+                priority = Fiber::NORMAL;
                 fiber = nullptr;
                 cb = nullptr;
             }
@@ -152,17 +310,83 @@ namespace dbspider
             }
         };
 
+        // 调度线程的本地任务队列，本线程从队头取任务
+        // 工作窃取模式下其他线程从队尾窃取；线程专属队列只由所属线程消费
+        // 这是加锁的近似实现，不是无锁的 Chase-Lev 双端队列：任务按值存放 96 字节内联缓冲的 SmallTask ，
+        // 窃取者无法无锁地读出槽位；EXEC 协程要原地跳过；所属线程按先进先出取任务。
+        // 所属线程加锁几乎没有竞争，窃取者只 tryLock ，一次拿走一半
+        struct LocalQueue
+        {
+            using MutexType = SpinLock;
+
+            MutexType mutex;
+            TaskQueue tasks;
+        };
+
+        // 线程ID到线程池下标的哈希表的一项，只在 spawn 时写入
+        struct ThreadIndexEntry
+        {
+            std::atomic<int> thread{0}; // 线程ID，0 表示空
+            std::atomic<int> index{-1}; // 线程池下标
+        };
+
+        // 退役线程的停放点
+        struct Parking
+        {
+            Semaphore sem{0};                 // 停放的线程阻塞在信号量上
+            std::atomic<bool> parked{false}; // 是否已经或者正要停放
+        };
+
+        // 调度线程当前的运行片，由调度线程写入、看门狗读取
+        struct Slice
+        {
+            std::atomic<uint64_t> start{0};    // 当前任务开始运行的时间(us)，没有运行任务时为0
+            std::atomic<uint64_t> fiber{0};    // 正在运行的协程id
+            std::atomic<bool> preempt{false}; // 抢占标记，协程在 Fiber::MaybeYield 中检查
+            uint64_t reported = 0;             // 已经报告过的运行片的开始时间，只有看门狗访问
+        };
+
     private:
         MutexType m_mutex;                  // 互斥锁
         std::vector<Thread::ptr> m_threads; // 调度器线程池
-        std::list<ScheduleTask> m_tasks;    // 调度器任务
+        std::unique_ptr<MpmcQueue<ScheduleTask>> m_inject; // 无锁的全局注入队列，容量为0时不创建
+        TaskQueue m_tasks;                  // 注入队列满了之后的溢出队列，以及指定了线程但找不到该线程的任务
+        std::atomic<size_t> m_taskCount{0}; // 溢出队列中的任务数，不为0时新任务也进溢出队列，保持先后顺序
+        TaskQueue m_highTasks;              // 高优先级任务，同样由 m_mutex 保护
+        std::atomic<size_t> m_highTaskCount{0}; // 高优先级队列中的任务数，为0时取任务不加锁
+        uint32_t m_highBurst = 0;            // 连续执行这么多高优先级任务后让普通任务执行一个，0 表示严格优先
         std::string m_name;                 // 调度器名字
+        bool m_workStealing = false;        // 是否开启工作窃取
+
+        std::vector<std::unique_ptr<LocalQueue>> m_localQueues;  // 每个调度线程的本地队列
+        std::vector<std::unique_ptr<LocalQueue>> m_pinnedQueues; // 每个调度线程的专属任务队列
+        std::vector<std::unique_ptr<LocalQueue>> m_pinnedHighQueues; // 每个调度线程的高优先级专属任务队列
+        std::vector<std::unique_ptr<Parking>> m_parkings;        // 每个调度线程的停放点
+        std::vector<std::unique_ptr<Slice>> m_slices;            // 每个调度线程的运行片
+
+        MutexType m_resizeMutex;     // 启动、停止和调整线程数时加锁
+        size_t m_maxThreads = 0;     // 线程池容量
+        size_t m_minThreads = 0;     // 弹性调整的线程数下限
+        uint64_t m_growDelayMs = 0;  // 所有线程忙碌并且有任务等待持续这么久后增加线程
+        uint64_t m_retireIdleMs = 0; // 一直有空闲线程持续这么久后减少线程
+        Thread::ptr m_monitor;       // 弹性调整线程数的监控线程
+        std::vector<int> m_cpuAffinity; // 调度线程绑定的 CPU 列表，第 i 个线程绑定到 m_cpuAffinity[i % size]
+        uint64_t m_preemptSliceUs = 0;  // 协程连续运行超过这个时间后请求抢占，0 表示不抢占
+        uint64_t m_longRunUs = 0;       // 协程连续运行超过这个时间后打印警告，0 表示不报告
+        Thread::ptr m_watchdog;         // 抢占和报告长时间运行协程的看门狗线程
 
     protected:
-        std::vector<int> m_threadIds;            // 线程池的线程ID数组
-        size_t m_threadCount = 0;                // 线程数量
+        std::vector<std::atomic<int>> m_threadIds; // 线程池的线程ID数组，长度为线程池容量
+        std::vector<ThreadIndexEntry> m_threadIndex; // 线程ID到下标的开放寻址哈希表，容量为不小于线程池容量 2 倍的 2 的幂
+        std::atomic<size_t> m_threadCount = 0;     // 运行的线程数量
         std::atomic<size_t> m_activeThreads = 0; // 活跃线程数
         std::atomic<size_t> m_idleThreads = 0;   // 空闲线程数
+
+        std::atomic<uint64_t> m_tickles = 0;      // 请求唤醒的次数
+        std::atomic<uint64_t> m_tickleWrites = 0; // 唤醒的系统调用次数
+        std::atomic<uint64_t> m_maxRunUs = 0;     // 协程连续占用调度线程的最长时间(us)
+        std::atomic<uint64_t> m_preemptRequests = 0; // 看门狗请求抢占的次数
+        std::atomic<uint64_t> m_longRuns = 0;        // 看门狗报告的长时间运行次数
         bool m_stop = true;                      // 调度其是否停止
     };
 }
\ No newline at end of file
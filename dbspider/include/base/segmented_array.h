@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "noncopyable.h"
+#include "sync/mutex.h"
+
+namespace dbspider
+{
+    /**
+     * 分段的只增数组，用 fd 这类从 0 开始的小整数做下标
+     * 第 k 段的长度为 BASE << k，下标 i 所在的段和段内偏移通过位运算直接算出，MAX_SEGMENTS 段共可容纳 BASE * (2^MAX_SEGMENTS - 1) 个元素
+     * 读取时只有一次原子load，不加锁；扩容时在锁内分配新的段，已有的段不会移动或释放，读者拿到的元素地址一直有效
+     * 元素在数组析构时才释放，所以元素自身需要保证并发访问安全（比如自带锁或者是原子类型）
+     */
+    template <typename T, size_t BASE = 64, size_t MAX_SEGMENTS = 24>
+    class SegmentedArray : Noncopyable
+    {
+        static_assert(BASE > 0 && (BASE & (BASE - 1)) == 0, "BASE must be a power of 2");
+
+    public:
+        SegmentedArray() = default;
+
+        ~SegmentedArray()
+        {
+            for (auto &segment : m_segments)
+            {
+                delete[] segment.load(std::memory_order_relaxed);
+            }
+        }
+
+        // 下标 index 的元素，所在的段还没有分配时返回 nullptr
+        T *get(size_t index) const
+        {
+            size_t segment, offset;
+            locate(index, segment, offset);
+            if (segment >= MAX_SEGMENTS)
+            {
+                return nullptr;
+            }
+            T *elements = m_segments[segment].load(std::memory_order_acquire);
+            return elements ? elements + offset : nullptr;
+        }
+
+        // 下标 index 的元素，所在的段还没有分配时分配，新元素在发布之前调用 init(元素, 下标) 初始化
+        // 超出容量时返回 nullptr
+        template <typename Init>
+        T *getOrCreate(size_t index, Init &&init)
+        {
+            T *element = get(index);
+            if (element)
+            {
+                return element;
+            }
+            size_t segment, offset;
+            locate(index, segment, offset);
+            if (segment >= MAX_SEGMENTS)
+            {
+                return nullptr;
+            }
+            Mutex::Lock lock(m_mutex);
+            T *elements = m_segments[segment].load(std::memory_order_relaxed);
+            if (!elements)
+            {
+                size_t size = BASE << segment;
+                size_t first = BASE * ((size_t(1) << segment) - 1);
+                elements = new T[size];
+                for (size_t i = 0; i < size; ++i)
+                {
+                    init(elements[i], first + i);
+                }
+                m_segments[segment].store(elements, std::memory_order_release);
+            }
+            return elements + offset;
+        }
+
+        T *getOrCreate(size_t index)
+        {
+            return getOrCreate(index, [](T &, size_t) {});
+        }
+
+        // 依次访问已经分配的元素
+        template <typename Fn>
+        void forEach(Fn &&fn)
+        {
+            for (size_t segment = 0; segment < MAX_SEGMENTS; ++segment)
+            {
+                T *elements = m_segments[segment].load(std::memory_order_acquire);
+                if (!elements)
+                {
+                    continue;
+                }
+                for (size_t i = 0; i < (BASE << segment); ++i)
+                {
+                    fn(elements[i]);
+                }
+            }
+        }
+
+    private:
+        // 下标 index 位于第 segment 段的第 offset 个元素
+        static void locate(size_t index, size_t &segment, size_t &offset)
+        {
+            size_t n = index / BASE + 1;
+            segment = 63 - __builtin_clzll(n);
+            offset = index - BASE * ((size_t(1) << segment) - 1);
+        }
+
+    private:
+        std::atomic<T *> m_segments[MAX_SEGMENTS] = {}; // 各段的首地址，未分配时为 nullptr
+        Mutex m_mutex;                                  // 分配新的段时加锁
+    };
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace dbspider
+{
+    /**
+     * 只能移动的 void() 任务，调度队列和协程用它代替 std::function
+     * 不超过 INLINE_SIZE 字节、可以无异常移动的可调用对象直接构造在内部缓冲区里，提交和移动都不分配内存；
+     * 更大的可调用对象退化为在堆上分配一次。空的 std::function 和空函数指针得到空任务
+     */
+    class SmallTask
+    {
+    public:
+        // 内联缓冲区大小，能放下 RPC 异步调用的捕获：shared_ptr、Channel、方法名 std::string 和几个参数
+        static constexpr size_t INLINE_SIZE = 96;
+
+        // 可调用对象是否直接放在缓冲区里
+        template <typename F>
+        static constexpr bool IsInline = sizeof(F) <= INLINE_SIZE &&
+                                         alignof(F) <= alignof(std::max_align_t) &&
+                                         std::is_nothrow_move_constructible_v<F>;
+
+        SmallTask() noexcept = default;
+
+        SmallTask(std::nullptr_t) noexcept {}
+
+        template <typename F,
+                  typename Func = std::decay_t<F>,
+                  typename = std::enable_if_t<!std::is_same_v<Func, SmallTask> &&
+                                              !std::is_same_v<Func, std::nullptr_t> &&
+                                              std::is_invocable_v<Func &>>>
+        SmallTask(F &&f)
+        {
+            // 函数引用退化成的函数指针不会为空
+            if constexpr ((std::is_pointer_v<Func> && !std::is_function_v<std::remove_reference_t<F>>) ||
+                          std::is_same_v<Func, std::function<void()>>)
+            {
+                if (!f)
+                {
+                    return;
+                }
+            }
+            if constexpr (IsInline<Func>)
+            {
+                ::new (m_buf) Func(std::forward<F>(f));
+                m_ops = &s_inlineOps<Func>;
+            }
+            else
+            {
+                ::new (m_buf) Func *(new Func(std::forward<F>(f)));
+                m_ops = &s_heapOps<Func>;
+            }
+        }
+
+        SmallTask(SmallTask &&other) noexcept
+        {
+            moveFrom(other);
+        }
+
+        SmallTask &operator=(SmallTask &&other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                moveFrom(other);
+            }
+            return *this;
+        }
+
+        SmallTask &operator=(std::nullptr_t) noexcept
+        {
+            reset();
+            return *this;
+        }
+
+        SmallTask(const SmallTask &) = delete;
+        SmallTask &operator=(const SmallTask &) = delete;
+
+        ~SmallTask() { reset(); }
+
+        void operator()() { m_ops->invoke(m_buf); }
+
+        explicit operator bool() const noexcept { return m_ops != nullptr; }
+
+        // 释放持有的可调用对象
+        void reset() noexcept
+        {
+            if (m_ops)
+            {
+                m_ops->destroy(m_buf);
+                m_ops = nullptr;
+            }
+        }
+
+        // 可调用对象是否在堆上
+        bool isHeap() const noexcept { return m_ops && m_ops->heap; }
+
+    private:
+        struct Ops
+        {
+            void (*invoke)(void *);
+            void (*move)(void *dst, void *src) noexcept; // 移动到 dst 并析构 src
+            void (*destroy)(void *) noexcept;
+            bool heap;
+        };
+
+        template <typename F>
+        static void Invoke(void *p) { (*static_cast<F *>(p))(); }
+
+        template <typename F>
+        static void Move(void *dst, void *src) noexcept
+        {
+            ::new (dst) F(std::move(*static_cast<F *>(src)));
+            static_cast<F *>(src)->~F();
+        }
+
+        template <typename F>
+        static void Destroy(void *p) noexcept { static_cast<F *>(p)->~F(); }
+
+        template <typename F>
+        static void HeapInvoke(void *p) { (**static_cast<F **>(p))(); }
+
+        template <typename F>
+        static void HeapDestroy(void *p) noexcept { delete *static_cast<F **>(p); }
+
+        template <typename F>
+        static constexpr Ops s_inlineOps{&Invoke<F>, &Move<F>, &Destroy<F>, false};
+
+        // 堆上的对象只移动指针
+        template <typename F>
+        static constexpr Ops s_heapOps{&HeapInvoke<F>, &Move<F *>, &HeapDestroy<F>, true};
+
+        void moveFrom(SmallTask &other) noexcept
+        {
+            if (other.m_ops)
+            {
+                other.m_ops->move(m_buf, other.m_buf);
+                m_ops = other.m_ops;
+                other.m_ops = nullptr;
+            }
+        }
+
+    private:
+        alignas(std::max_align_t) unsigned char m_buf[INLINE_SIZE];
+        const Ops *m_ops = nullptr;
+    };
+}
@@ -4,4 +4,5 @@
 #include "sync/co_condvar.h"
 #include "sync/co_count_down.h"
 #include "sync/co_semaphore.h"
-#include "sync/mutex.h"
\ No newline at end of file
+#include "sync/mutex.h"
+#include "sync/wait_group.h"
\ No newline at end of file
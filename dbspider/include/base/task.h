@@ -0,0 +1,224 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace dbspider
+{
+    /**
+     * C++20 无栈协程
+     * 协程帧分配在堆上，只保存跨越 co_await 的局部变量，没有自己的栈，创建和切换都比 Fiber 便宜得多
+     * Task 是惰性启动的：创建后不执行，被 co_await 时才在等待者的线程上开始执行
+     * 挂起和恢复都通过 IOManager 完成（见 io_awaitable.h），恢复时作为回调任务跑在调度器的线程上，
+     * 与有栈协程 Fiber 共用同一个调度器
+     */
+    template <typename T = void>
+    class Task;
+
+    // Task promise 的公共部分
+    class TaskPromiseBase
+    {
+    public:
+        // 协程结束时，如果等待者已经挂起就恢复等待者，否则返回到 resume() 的调用方
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept { return false; }
+
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+            {
+                TaskPromiseBase &promise = handle.promise();
+                if (promise.m_state.exchange(true, std::memory_order_acq_rel))
+                {
+                    return promise.m_continuation;
+                }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        // 惰性启动
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+
+        void unhandled_exception() noexcept { m_exception = std::current_exception(); }
+
+        /**
+         * 启动协程，返回等待者是否需要挂起
+         * 协程同步执行完时等待者直接继续执行，不需要挂起；协程中途挂起时由它结束时恢复等待者
+         * 谁后到谁负责继续执行等待者，这样一长串同步完成的 co_await 不会依赖编译器的尾调用优化，
+         * Debug 编译时线程栈也不会一直增长
+         */
+        bool start(std::coroutine_handle<> self, std::coroutine_handle<> continuation)
+        {
+            m_continuation = continuation;
+            self.resume();
+            return !m_state.exchange(true, std::memory_order_acq_rel);
+        }
+
+    protected:
+        // 协程中抛出的异常在 co_await 处重新抛出
+        void rethrow() const
+        {
+            if (m_exception)
+            {
+                std::rethrow_exception(m_exception);
+            }
+        }
+
+    private:
+        std::coroutine_handle<> m_continuation = std::noop_coroutine(); // 等待该协程的协程
+        std::atomic<bool> m_state{false};                               // 协程结束和等待者挂起，先到的一方置为 true
+        std::exception_ptr m_exception;                                 // 协程中未捕获的异常
+    };
+
+    template <typename T>
+    class TaskPromise : public TaskPromiseBase
+    {
+    public:
+        Task<T> get_return_object() noexcept;
+
+        template <typename U>
+        void return_value(U &&value)
+        {
+            m_value.emplace(std::forward<U>(value));
+        }
+
+        T result()
+        {
+            rethrow();
+            return std::move(*m_value);
+        }
+
+    private:
+        std::optional<T> m_value; // 协程的返回值
+    };
+
+    template <>
+    class TaskPromise<void> : public TaskPromiseBase
+    {
+    public:
+        Task<void> get_return_object() noexcept;
+
+        void return_void() const noexcept {}
+
+        void result() { rethrow(); }
+    };
+
+    // 无栈协程任务，独占协程帧，析构时销毁协程帧
+    template <typename T>
+    class Task
+    {
+    public:
+        using promise_type = TaskPromise<T>;
+        using value_type = T;
+        using handle_type = std::coroutine_handle<promise_type>;
+
+        // co_await Task 时启动协程，并把自己设置为它的等待者
+        struct Awaiter
+        {
+            handle_type handle;
+
+            bool await_ready() const noexcept { return !handle || handle.done(); }
+
+            bool await_suspend(std::coroutine_handle<> continuation)
+            {
+                return handle.promise().start(handle, continuation);
+            }
+
+            T await_resume() { return handle.promise().result(); }
+        };
+
+        Task() = default;
+
+        explicit Task(handle_type handle)
+            : m_handle(handle)
+        {
+        }
+
+        Task(Task &&task) noexcept
+            : m_handle(std::exchange(task.m_handle, {}))
+        {
+        }
+
+        Task &operator=(Task &&task) noexcept
+        {
+            if (this != &task)
+            {
+                if (m_handle)
+                {
+                    m_handle.destroy();
+                }
+                m_handle = std::exchange(task.m_handle, {});
+            }
+            return *this;
+        }
+
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task()
+        {
+            if (m_handle)
+            {
+                m_handle.destroy();
+            }
+        }
+
+        bool valid() const { return (bool)m_handle; }
+
+        bool done() const { return !m_handle || m_handle.done(); }
+
+        Awaiter operator co_await() const noexcept { return Awaiter{m_handle}; }
+
+    private:
+        handle_type m_handle;
+    };
+
+    template <typename T>
+    Task<T> TaskPromise<T>::get_return_object() noexcept
+    {
+        return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+    }
+
+    inline Task<void> TaskPromise<void>::get_return_object() noexcept
+    {
+        return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+    }
+
+    // 判断类型是否为 Task，用于识别 RPC 的协程处理函数
+    template <typename T>
+    struct is_task : std::false_type
+    {
+    };
+
+    template <typename T>
+    struct is_task<Task<T>> : std::true_type
+    {
+    };
+
+    template <typename T>
+    inline constexpr bool is_task_v = is_task<T>::value;
+
+    // Task<T> 取出 T，其他类型保持不变
+    template <typename T>
+    struct task_result
+    {
+        using type = T;
+    };
+
+    template <typename T>
+    struct task_result<Task<T>>
+    {
+        using type = T;
+    };
+
+    template <typename T>
+    using task_result_t = typename task_result<T>::type;
+}
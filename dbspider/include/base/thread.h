@@ -6,8 +6,9 @@
 #include <functional>
 #include <pthread.h>
 #include <unistd.h>
+#include <vector>
 
-#include "dbspider/include/base/sync.h"
+#include "dbspider/include/sync/co_semaphore.h"
 
 namespace dbspider
 {
@@ -19,6 +20,8 @@ namespace dbspider
 
         // 构造函数  线程名字和回调函数
         Thread(const std::string &name, callback cb);
+        // cpus 不为空时，线程在执行回调之前绑定到这些 CPU 上
+        Thread(const std::string &name, callback cb, const std::vector<int> &cpus);
         ~Thread();
 
         // 等待子线程返回
@@ -30,8 +33,15 @@ namespace dbspider
         static const std::string &GetName();
         static void SetName(const std::string &name);
 
+        // 把当前线程绑定到 cpus 上，cpus 为空或者都不可用时返回 false
+        static bool SetAffinity(const std::vector<int> &cpus);
+        // 当前线程可以运行的 CPU
+        static std::vector<int> GetAffinity();
+
         const std::string &getName() const { return m_name; }
         pid_t getId() const { return m_id; }
+        // 创建时指定的 CPU
+        const std::vector<int> &getCpus() const { return m_cpus; }
 
     private:
         // 禁用拷贝赋值
@@ -43,6 +53,7 @@ namespace dbspider
         pthread_t m_thread = 0;
         callback m_cb;
         std::string m_name;
-        Semaphore m_sem{1};
+        std::vector<int> m_cpus;
+        Semaphore m_sem{0};
     };
 }
@@ -1,20 +1,25 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
-#include <set>
+#include <vector>
 
+#include "fiber.h"
 #include "log.h"
 #include "sync.h"
+#include "timing_wheel.h"
 
 namespace dbspider
 {
     class TimeManager;
+    struct TimerShard;
 
     // 定时器
     class Timer : public std::enable_shared_from_this<Timer>
     {
         friend class TimeManager;
+        friend class TimingWheel;
 
     public:
         using ptr = std::shared_ptr<Timer>;
@@ -25,26 +30,43 @@ namespace dbspider
         // 刷新设置定时器的执行时间
         bool refresh();
 
-        // 重置定时器时间
+        // 重置定时器时间(ms)
         bool reset(uint64_t ms, bool now_time);
 
-    private:
-        Timer(uint64_t next);
-        Timer(uint64_t ms, std::function<void()> cb, bool recurring, TimeManager *timeManager);
+        // 重置定时器时间(us)
+        bool resetUS(uint64_t us, bool now_time);
+
+        // 设置回调的调度优先级，心跳等控制面定时器设为 HIGH
+        void setPriority(Fiber::Priority priority);
 
-        // 定时器比较仿函数
-        struct Compare
-        {
-            // 比较定时器的智能指针的大小(按执行时间排序)
-            bool operator()(const Timer::ptr &lhs, const Timer::ptr &rhs) const;
-        };
+    private:
+        Timer(uint64_t us, std::function<void()> cb, bool recurring, TimeManager *timeManager, TimerShard *shard);
 
     private:
-        uint64_t m_ms = 0;                // 执行周期
-        uint64_t m_next = 0;              // 精确的执行时间
+        uint64_t m_us = 0;                // 执行周期(us)
+        uint64_t m_next = 0;              // 精确的执行时间(us)
         std::function<void()> m_cb;       // 定时器回调
         bool m_recurring = false;         // 是否循环
+        Fiber::Priority m_priority = Fiber::NORMAL; // 回调的调度优先级
         TimeManager *m_manager = nullptr; // 定时器管理类
+        TimerShard *m_shard = nullptr;    // 所在的分片，创建时确定
+
+        // 时间轮的侵入式链表
+        Timer *m_prevNode = nullptr;
+        Timer *m_nextNode = nullptr;
+        TimingWheel::Slot *m_slot = nullptr; // 所在的槽，不在时间轮中时为空
+        Timer::ptr m_self;                   // 在时间轮中时持有自己，用户不持有定时器时也能到期执行
+    };
+
+    // 定时器分片，每个调度线程一个，添加、取消、重置定时器只锁所在的分片
+    struct TimerShard
+    {
+        using MutexType = Mutex;
+
+        explicit TimerShard(uint64_t now) : wheel(now) {}
+
+        MutexType mutex;
+        TimingWheel wheel;
     };
 
     // 定时器管理器Timer
@@ -53,39 +75,69 @@ namespace dbspider
         friend class Timer;
 
     public:
-        using MutexType = Mutex;
+        using MutexType = TimerShard::MutexType;
 
-        TimeManager();
+        // shards 定时器分片数，IOManager 中等于调度线程数
+        explicit TimeManager(size_t shards = 1);
         virtual ~TimeManager();
 
-        // 添加定时器
+        // 添加定时器，ms 毫秒后执行
         Timer::ptr addTimer(uint64_t ms, std::function<void()> cb, bool recurring = false);
 
+        // 添加定时器，us 微秒后执行
+        Timer::ptr addTimerUS(uint64_t us, std::function<void()> cb, bool recurring = false);
+
+        // 添加定时器，ns 纳秒后执行，向上取整到微秒
+        Timer::ptr addTimerNS(uint64_t ns, std::function<void()> cb, bool recurring = false);
+
         // 添加条件定时器
         Timer::ptr addConditionTimer(uint64_t ms,
                                      std::function<void()> cb,
                                      std::weak_ptr<void> cond,
                                      bool recurring = false);
 
-        // 到最近一个定时器执行的时间间隔(ms)
+        // 添加条件定时器(us)
+        Timer::ptr addConditionTimerUS(uint64_t us,
+                                       std::function<void()> cb,
+                                       std::weak_ptr<void> cond,
+                                       bool recurring = false);
+
+        // 到最近一个定时器执行的时间间隔(ms)，向上取整
         uint64_t getNextTimer();
 
+        // 到最近一个定时器执行的时间间隔(us)
+        uint64_t getNextTimerUS();
+
         // 获取需要执行的定时器的回调函数列表
         void getExpiredCallbacks(std::vector<std::function<void()>> &cbs);
 
+        // 同上，高优先级定时器的回调放到 high_cbs 中
+        void getExpiredCallbacks(std::vector<std::function<void()>> &cbs,
+                                 std::vector<std::function<void()>> &high_cbs);
+
         // 是否有定时器
         bool hasTimer();
 
     protected:
-        // 当有新的定时器插入到定时器的首部，执行该函数
+        // 当新的定时器比空闲线程醒来的时间还早时，执行该函数
         virtual void onInsertAtFront() = 0;
 
-        // 将定时器添加到管理器中
-        void addTimer(Timer::ptr timer, MutexType::Lock &lock);
+        // 当前线程添加定时器时使用的分片下标，对分片数取模
+        virtual size_t getTimerShard() { return 0; }
+
+    private:
+        // 将定时器放入所在分片的时间轮，调用时持有分片的锁
+        void link(Timer *timer);
+
+        // 将定时器移出时间轮，返回定时器对自己的引用，需要在释放分片的锁之后再析构
+        Timer::ptr unlink(Timer *timer);
+
+        // 新的定时器比空闲线程醒来的时间还早时，提前唤醒
+        void checkFront(uint64_t next);
 
     private:
-        MutexType m_mutex;
-        std::set<Timer::ptr, Timer::Compare> m_timers; // 定时器集合
-        bool m_tickled = false;                        // 是否触发onTimerInsertedAtFront
+        std::vector<std::unique_ptr<TimerShard>> m_shards; // 定时器分片
+        std::atomic<uint64_t> m_wakeup{~0ull};             // 空闲线程最早醒来的时间
+        std::atomic<size_t> m_count{0};                    // 定时器总数
     };
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dbspider
+{
+    class Timer;
+
+    /**
+     * 分层时间轮，时间单位为 us
+     * 第 0 层 256 个槽，每槽 1us；第 1~5 层各 64 个槽，每槽分别是 2^8、2^14、2^20、2^26、2^32 us，共覆盖 2^38 us (约 76 小时)
+     * 更远的定时器先放在最高层的最后一个槽里，转到时再重新放置
+     * 定时器通过侵入式双向链表挂在槽上，添加、删除都是 O(1)；
+     * 时间推进到第 0 层转完一圈时，把上一层当前槽里的定时器重新放置到下层（级联）
+     * 时间轮本身不加锁，由 TimeManager 的分片锁保护
+     */
+    class TimingWheel
+    {
+    public:
+        explicit TimingWheel(uint64_t now);
+
+        // 按定时器的执行时间放入时间轮，已经到期的定时器在下一次 advance 时取出
+        void add(Timer *timer);
+
+        // 从时间轮中删除定时器
+        void remove(Timer *timer);
+
+        // 把时间推进到 now，取出所有执行时间不晚于 now 的定时器
+        void advance(uint64_t now, std::vector<Timer *> &expired);
+
+        // 取出所有定时器
+        void clear(std::vector<Timer *> &timers);
+
+        // 最近可能有定时器到期的时间，可能早于实际的到期时间（需要级联时），没有定时器返回 ~0ull
+        uint64_t nextExpire() const;
+
+        size_t size() const { return m_size; }
+
+        bool empty() const { return m_size == 0; }
+
+        // 槽，定时器的双向链表
+        struct Slot
+        {
+            Timer *head = nullptr;
+        };
+
+    private:
+        // 第 0 层最近一个非空槽的时间
+        uint64_t nextRoot() const;
+
+        // 上层最近一个非空槽级联的时间
+        uint64_t nextCascade() const;
+
+        // 根据执行时间放入对应的槽，cascading 表示正在级联当前时刻的定时器
+        void place(Timer *timer, bool cascading);
+
+        // 把第 level 层 index 槽中的定时器重新放置
+        void cascade(int level, size_t index);
+
+        // 取出槽中所有到期的定时器
+        void collect(Slot *slot, std::vector<Timer *> &expired);
+
+        void link(Slot *slot, Timer *timer);
+
+        // 取下整个槽的链表
+        Timer *take(Slot *slot);
+
+        // 槽在位图中对应的字，mask 为对应的位，m_ready 不在位图中返回 nullptr
+        uint64_t *bitmap(Slot *slot, uint64_t &mask);
+
+    private:
+        static const int LEVELS = 6;
+        static const int ROOT_BITS = 8;
+        static const int LEVEL_BITS = 6;
+        static const size_t ROOT_SIZE = 1 << ROOT_BITS;
+        static const size_t LEVEL_SIZE = 1 << LEVEL_BITS;
+
+        Slot m_root[ROOT_SIZE];                // 第 0 层
+        Slot m_levels[LEVELS - 1][LEVEL_SIZE]; // 第 1~5 层
+        Slot m_ready;                          // 加入时就已经到期的定时器
+        uint64_t m_rootBits[ROOT_SIZE / 64]{}; // 第 0 层非空槽的位图
+        uint64_t m_levelBits[LEVELS - 1]{};    // 第 1~5 层非空槽的位图
+        uint64_t m_current;                    // 已经处理到的时间
+        size_t m_size = 0;                     // 定时器总数
+    };
+}
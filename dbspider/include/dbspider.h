@@ -12,12 +12,19 @@
 #include "log.h"
 #include "config.h"
 #include "thread.h"
+#include "small_task.h"
+#include "ring_queue.h"
+#include "mpmc_queue.h"
 #include "fiber.h"
+#include "cancel.h"
 #include "hook.h"
 #include "timer.h"
 #include "time_measure.h"
 #include "scheduler.h"
 #include "io_manager.h"
+#include "task.h"
+#include "io_awaitable.h"
+#include "blocking_pool.h"
 #include "fd_manager.h"
 #include "bytearray.h"
 #include "stream.h"
@@ -4,6 +4,7 @@
 #include "address.h"
 #include "bytearray.h"
 #include "noncopyable.h"
+#include "task.h"
 
 namespace dbspider
 {
@@ -64,7 +65,8 @@ namespace dbspider
         }
 
         Socket::ptr accept();
-        bool bind(const Address::ptr address);
+        // reuse_port 为 true 时设置 SO_REUSEPORT，多个socket可以绑定同一个地址，由内核分发新连接
+        bool bind(const Address::ptr address, bool reuse_port = false);
         bool connect(const Address::ptr address, uint64_t timeout_ms = -1);
         bool listen(int backlog = SOMAXCONN);
         bool close();
@@ -93,6 +95,12 @@ namespace dbspider
         // 接受数据
         virtual ssize_t recvFrom(iovec *buffers, size_t length, Address::ptr from, int flags = 0);
 
+        // 无栈协程版本的发送数据，co_await socket->asyncSend(...)
+        Task<ssize_t> asyncSend(const void *buffer, size_t length, int flags = 0);
+
+        // 无栈协程版本的接受数据，co_await socket->asyncRecv(...)
+        Task<ssize_t> asyncRecv(void *buffer, size_t length, int flags = 0);
+
         Address::ptr getRemoteAddress();
         Address::ptr getLocalAddress();
 
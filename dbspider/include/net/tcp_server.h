@@ -1,9 +1,11 @@
 #pragma once
+#include <atomic>
 #include <memory>
 #include <functional>
 #include "io_manager.h"
 #include "socket.h"
 #include "noncopyable.h"
+#include "wait_group.h"
 
 namespace dbspider
 {
@@ -19,6 +21,7 @@ namespace dbspider
         virtual bool bind(const std::vector<Address::ptr> &addrs, std::vector<Address::ptr> &fail);
 
         virtual bool start();
+        // 先 shutdown 监听socket唤醒阻塞在 accept 上的协程，等所有accept循环退出后再关闭
         virtual void stop();
 
         uint64_t getRecvTimeout() const { return m_recvTimeout; }
@@ -33,13 +36,20 @@ namespace dbspider
         virtual void startAccept(Socket::ptr sock);
         virtual void handleClient(Socket::ptr client);
 
+        // 多 reactor 模式下为新连接选择所属的调度线程，返回线程下标
+        virtual size_t selectWorkerThread();
+
     protected:
         std::vector<Socket::ptr> m_listens; // 监听socket队列
         IOManager *m_worker;
         IOManager *m_acceptWorker;
         uint64_t m_recvTimeout;
         std::string m_name;
-        bool m_isStop;
+        std::atomic<bool> m_isStop;
+        bool m_leastLoaded;                  // 新连接分配给拥有连接最少的线程，否则轮流分配
+        std::atomic<size_t> m_nextWorker{0}; // 轮流分配时下一个线程的下标
+        bool m_reusePort;                    // 每个accept线程一个 SO_REUSEPORT 监听socket
+        WaitGroup m_acceptLoops;             // 还在运行的accept循环，全部退出后 stop 才关闭监听socket
     };
 
 }
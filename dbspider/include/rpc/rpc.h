@@ -37,7 +37,8 @@ namespace dbspider::rpc
         RPC_NO_MATCH,    // 函数不匹配
         RPC_NO_METHOD,   // 没有找到调用函数
         RPC_CLOSED,      // RPC 连接被关闭
-        RPC_TIMEOUT      // RPC 调用超时
+        RPC_TIMEOUT,     // RPC 调用超时
+        RPC_CANCELED     // RPC 调用被取消
     };
 
     // 包装 RPC 调用结果
@@ -3,6 +3,7 @@
 #include <memory>
 #include <functional>
 #include <future>
+#include "cancel.h"
 #include "io_manager.h"
 #include "net/socket.h"
 #include "net/socket_stream.h"
@@ -93,11 +94,11 @@ namespace dbspider::rpc
         {
             Channel<Result<R>> chan(1);
             RpcClient::ptr self = shared_from_this();
-            go[self, chan, name, ps..., this]() mutable
-            {
-                chan << call<R>(name, ps...);
-                self = nullptr;
-            };
+            // 调用协程继承调用方的取消令牌，调用方被取消时调用一起取消
+            go Fiber::Inherit([self, chan, name, ps..., this]() mutable
+                              {
+                                  chan << call<R>(name, ps...);
+                                  self = nullptr; });
             return chan;
         }
 
@@ -152,6 +153,10 @@ namespace dbspider::rpc
                 return val;
             }
 
+            // 本次调用的令牌，到达调用超时或调用方被取消时，挂起在发送请求和等待响应上的操作立即返回
+            CancelToken::ptr token = CancelToken::CreateChild(m_timeout);
+            CancelToken::Scope scope(token);
+
             // 开启一个 Channel 接收调用结果
             Channel<Protocol::ptr> recvChan(1);
 
@@ -170,12 +175,10 @@ namespace dbspider::rpc
             Protocol::ptr request =
                 Protocol::Create(Protocol::MsgType::RPC_METHOD_REQUEST, s.toString(), id);
 
-            // 向 send 协程的 Channel 发送消息
-            m_chan << request;
-
             bool timeout = false;
             Protocol::ptr response;
-            if (!recvChan.waitFor(response, m_timeout))
+            // 向 send 协程的 Channel 发送消息，等待响应
+            if (!m_chan.push(request) || !recvChan.waitFor(response, m_timeout))
             {
                 timeout = true;
             }
@@ -189,6 +192,14 @@ namespace dbspider::rpc
                 }
             }
 
+            if (timeout && token->getError() == ECANCELED)
+            {
+                // 调用方取消
+                val.setCode(RPC_CANCELED);
+                val.setMsg("call canceled");
+                return val;
+            }
+
             if (timeout)
             {
                 // 超时
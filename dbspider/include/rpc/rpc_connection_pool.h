@@ -67,11 +67,11 @@ namespace dbspider::rpc
         {
             Channel<Result<R>> chan(1);
             RpcConnectionPool::ptr self = shared_from_this();
-            go[chan, name, ps..., self, this]() mutable
-            {
-                chan << call<R>(name, ps...);
-                self = nullptr;
-            };
+            // 调用协程继承调用方的取消令牌
+            go Fiber::Inherit([chan, name, ps..., self, this]() mutable
+                              {
+                                  chan << call<R>(name, ps...);
+                                  self = nullptr; });
             return chan;
         }
 
@@ -6,6 +6,8 @@
 #include "tcp_server.h"
 #include "log.h"
 #include "sync.h"
+#include "io_awaitable.h"
+#include "blocking_pool.h"
 #include "traits.h"
 #include "protocol.h"
 #include "rpc.h"
@@ -33,12 +35,22 @@ namespace dbspider::rpc
         // 设置RPC服务器名称
         void setName(const std::string &name) override;
 
-        // 注册函数
+        // 注册函数，函数可以是普通函数，也可以是返回 Task<T> 的无栈协程
+        // 协程处理函数由处理连接的协程同步等待执行完毕，挂起期间不占用调度线程
+        // blocking 为 true 时普通函数在阻塞线程池中执行，适合阻塞调用和计算密集的处理函数，执行期间不占用调度线程
         template <typename Func>
-        void registerMethod(const std::string &name, Func func)
+        void registerMethod(const std::string &name, Func func, bool blocking = false)
         {
-            m_handlers[name] = [func, this](Serializer serializer, const std::string &arg)
+            // 无栈协程处理函数挂起时本来就不占用调度线程，并且要在调度器上恢复，不放到阻塞线程池
+            blocking = blocking && !is_task_v<typename function_traits<Func>::return_type>;
+            m_handlers[name] = [func, blocking, this](Serializer serializer, const std::string &arg)
             {
+                if (blocking)
+                {
+                    BlockingPool::GetInstance()->run([&]
+                                                     { proxy(func, serializer, arg); });
+                    return;
+                }
                 proxy(func, serializer, arg);
             };
         }
@@ -99,7 +111,9 @@ namespace dbspider::rpc
         void proxy(F fun, Serializer serializer, const std::string &arg)
         {
             typename function_traits<F>::stl_function_type func(fun);
-            using Return = typename function_traits<F>::return_type;
+            using RawReturn = typename function_traits<F>::return_type;
+            // 协程处理函数返回 Task<T>，序列化的是 T
+            using Return = task_result_t<RawReturn>;
             using Args = typename function_traits<F>::tuple_type;
 
             dbspider::rpc::Serializer s(arg);
@@ -126,7 +140,15 @@ namespace dbspider::rpc
                 return func(std::get<Index>(std::forward<Args>(args))...);
             };
 
-            if constexpr (std::is_same_v<Return, void>)
+            if constexpr (is_task_v<RawReturn> && std::is_same_v<Return, void>)
+            {
+                SyncWait(invoke(std::make_index_sequence<size>{}));
+            }
+            else if constexpr (is_task_v<RawReturn>)
+            {
+                rt = SyncWait(invoke(std::make_index_sequence<size>{}));
+            }
+            else if constexpr (std::is_same_v<Return, void>)
             {
                 invoke(std::make_index_sequence<size>{});
             }
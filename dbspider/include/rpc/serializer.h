@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "bytearray.h"
+#include "fiber.h"
 #include "protocol.h"
 
 namespace dbspider::rpc
@@ -29,6 +30,8 @@ namespace dbspider::rpc
      * 关联容器：set, multiset, map, multimap
      * 无序容器：unordered_set, unordered_multiset, unordered_map, unordered_multimap
      * 异构容器：tuple
+     *
+     * 容器的每个元素都是抢占的安全点（Fiber::MaybeYield），序列化大容器时不会长时间占住调度线程
      */
     class Serializer
     {
@@ -241,6 +244,7 @@ namespace dbspider::rpc
             read(size);
             for (size_t i = 0; i < size; ++i)
             {
+                Fiber::MaybeYield();
                 T t;
                 read(t);
                 v.template emplace_back(t);
@@ -254,6 +258,7 @@ namespace dbspider::rpc
             write(v.size());
             for (auto &t : v)
             {
+                Fiber::MaybeYield();
                 (*this) << t;
             }
             return *this;
@@ -266,6 +271,7 @@ namespace dbspider::rpc
             read(size);
             for (size_t i = 0; i < size; ++i)
             {
+                Fiber::MaybeYield();
                 T t;
                 read(t);
                 v.template emplace_back(t);
@@ -279,6 +285,7 @@ namespace dbspider::rpc
             write(v.size());
             for (auto &t : v)
             {
+                Fiber::MaybeYield();
                 (*this) << t;
             }
             return *this;
@@ -291,6 +298,7 @@ namespace dbspider::rpc
             read(size);
             for (size_t i = 0; i < size; ++i)
             {
+                Fiber::MaybeYield();
                 T t;
                 read(t);
                 v.template emplace(t);
@@ -304,6 +312,7 @@ namespace dbspider::rpc
             write(v.size());
             for (auto &t : v)
             {
+                Fiber::MaybeYield();
                 (*this) << t;
             }
             return *this;
@@ -316,6 +325,7 @@ namespace dbspider::rpc
             read(size);
             for (size_t i = 0; i < size; ++i)
             {
+                Fiber::MaybeYield();
                 T t;
                 read(t);
                 v.template emplace(t);
@@ -329,6 +339,7 @@ namespace dbspider::rpc
             write(v.size());
             for (auto &t : v)
             {
+                Fiber::MaybeYield();
                 (*this) << t;
             }
             return *this;
@@ -341,6 +352,7 @@ namespace dbspider::rpc
             read(size);
             for (size_t i = 0; i < size; ++i)
             {
+                Fiber::MaybeYield();
                 T t;
                 read(t);
                 v.template emplace(t);
@@ -354,6 +366,7 @@ namespace dbspider::rpc
             write(v.size());
             for (auto &t : v)
             {
+                Fiber::MaybeYield();
                 (*this) << t;
             }
             return *this;
@@ -366,6 +379,7 @@ namespace dbspider::rpc
             read(size);
             for (size_t i = 0; i < size; ++i)
             {
+                Fiber::MaybeYield();
                 T t;
                 read(t);
                 v.template emplace(t);
@@ -379,6 +393,7 @@ namespace dbspider::rpc
             write(v.size());
             for (auto &t : v)
             {
+                Fiber::MaybeYield();
                 (*this) << t;
             }
             return *this;
@@ -405,6 +420,7 @@ namespace dbspider::rpc
             read(size);
             for (size_t i = 0; i < size; ++i)
             {
+                Fiber::MaybeYield();
                 std::pair<K, V> p;
                 (*this) >> p;
                 m.template emplace(p);
@@ -418,6 +434,7 @@ namespace dbspider::rpc
             write(m.size());
             for (auto &t : m)
             {
+                Fiber::MaybeYield();
                 (*this) << t;
             }
             return *this;
@@ -430,6 +447,7 @@ namespace dbspider::rpc
             read(size);
             for (size_t i = 0; i < size; ++i)
             {
+                Fiber::MaybeYield();
                 std::pair<K, V> p;
                 (*this) >> p;
                 m.template emplace(p);
@@ -443,6 +461,7 @@ namespace dbspider::rpc
             write(m.size());
             for (auto &t : m)
             {
+                Fiber::MaybeYield();
                 (*this) << t;
             }
             return *this;
@@ -455,6 +474,7 @@ namespace dbspider::rpc
             read(size);
             for (size_t i = 0; i < size; ++i)
             {
+                Fiber::MaybeYield();
                 std::pair<K, V> p;
                 (*this) >> p;
                 m.template emplace(p);
@@ -468,6 +488,7 @@ namespace dbspider::rpc
             write(m.size());
             for (auto &t : m)
             {
+                Fiber::MaybeYield();
                 (*this) << t;
             }
             return *this;
@@ -480,6 +501,7 @@ namespace dbspider::rpc
             read(size);
             for (size_t i = 0; i < size; ++i)
             {
+                Fiber::MaybeYield();
                 std::pair<K, V> p;
                 (*this) >> p;
                 m.template emplace(p);
@@ -493,6 +515,7 @@ namespace dbspider::rpc
             write(m.size());
             for (auto &t : m)
             {
+                Fiber::MaybeYield();
                 (*this) << t;
             }
             return *this;
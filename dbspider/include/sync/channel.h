@@ -18,7 +18,7 @@ namespace dbspider
 
         ~ChannelImpl() { close(); }
 
-        // 发送数据到 Channel
+        // 发送数据到 Channel，返回值：false 表示 Channel 已关闭或当前协程被取消
         bool push(const T &t)
         {
             CoMutex::Lock lock(m_mutex);
@@ -29,8 +29,8 @@ namespace dbspider
             // 如果缓冲区已满，等待m_pushCv唤醒
             while (m_queue.size() >= m_capacity)
             {
-                m_pushCv.wait(lock);
-                if (m_isClose)
+                // 当前协程被取消时返回 false，errno 为取消的原因
+                if (!m_pushCv.wait(lock) || m_isClose)
                 {
                     return false;
                 }
@@ -41,7 +41,7 @@ namespace dbspider
             return true;
         }
 
-        // 从 Channel 读取数据
+        // 从 Channel 读取数据，返回值：false 表示 Channel 已关闭或当前协程被取消
         bool pop(T &t)
         {
             CoMutex::Lock lock(m_mutex);
@@ -52,8 +52,8 @@ namespace dbspider
             // 如果缓冲区为空，等待m_pushCv唤醒
             while (m_queue.empty())
             {
-                m_popCv.wait(lock);
-                if (m_isClose)
+                // 当前协程被取消时返回 false，errno 为取消的原因
+                if (!m_popCv.wait(lock) || m_isClose)
                 {
                     return false;
                 }
@@ -95,6 +95,59 @@ namespace dbspider
             return true;
         }
 
+        // 无栈协程版本的 push：co_await chan.asyncPush(t)
+        Task<bool> asyncPush(T t)
+        {
+            co_await m_mutex.asyncLock();
+            if (m_isClose)
+            {
+                m_mutex.unlock();
+                co_return false;
+            }
+            // 如果缓冲区已满，等待m_pushCv唤醒
+            while (m_queue.size() >= m_capacity)
+            {
+                co_await m_pushCv.asyncWait(m_mutex);
+                if (m_isClose)
+                {
+                    m_mutex.unlock();
+                    co_return false;
+                }
+            }
+            m_queue.push(std::move(t));
+            // 唤醒 m_popCv
+            m_popCv.notify();
+            m_mutex.unlock();
+            co_return true;
+        }
+
+        // 无栈协程版本的 pop：co_await chan.asyncPop(t)
+        Task<bool> asyncPop(T &t)
+        {
+            co_await m_mutex.asyncLock();
+            if (m_isClose)
+            {
+                m_mutex.unlock();
+                co_return false;
+            }
+            // 如果缓冲区为空，等待m_popCv唤醒
+            while (m_queue.empty())
+            {
+                co_await m_popCv.asyncWait(m_mutex);
+                if (m_isClose)
+                {
+                    m_mutex.unlock();
+                    co_return false;
+                }
+            }
+            t = m_queue.front();
+            m_queue.pop();
+            // 唤醒 m_pushCv
+            m_pushCv.notify();
+            m_mutex.unlock();
+            co_return true;
+        }
+
         ChannelImpl &operator>>(T &t)
         {
             pop(t);
@@ -177,6 +230,19 @@ namespace dbspider
             return m_channel->waitFor(t, timeout_ms);
         }
 
+        // 无栈协程版本的 push/pop，挂起期间持有 ChannelImpl 的引用
+        Task<bool> asyncPush(T t)
+        {
+            auto channel = m_channel;
+            co_return co_await channel->asyncPush(std::move(t));
+        }
+
+        Task<bool> asyncPop(T &t)
+        {
+            auto channel = m_channel;
+            co_return co_await channel->asyncPop(t);
+        }
+
         Channel &operator>>(T &t)
         {
             (*m_channel) >> t;
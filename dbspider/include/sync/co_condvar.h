@@ -2,6 +2,8 @@
 
 #include "noncopyable.h"
 #include "mutex.h"
+#include "task.h"
+#include <deque>
 #include <set>
 
 namespace dbspider
@@ -22,18 +24,50 @@ namespace dbspider
         void notifyAll();
 
         // 不加锁地等待唤醒
-        void wait();
+        // 返回值：true 表示被条件变量唤醒; false 表示当前协程的取消令牌被取消，errno 为取消的原因
+        bool wait();
 
-        // 等待唤醒
-        void wait(CoMutex::Lock &lock);
+        // 等待唤醒，返回时重新持有锁
+        // 返回值：true 表示被条件变量唤醒; false 表示当前协程的取消令牌被取消，errno 为取消的原因
+        bool wait(CoMutex::Lock &lock);
 
         // 阻塞当前协程，直到条件变量被唤醒，或到指定时限时长后
         // timeout_ms 超时时间 (ms)
-        // 返回值：true 表示被条件变量唤醒; false 表示超时唤醒
+        // 返回值：true 表示被条件变量唤醒; false 表示超时或被取消唤醒，errno 为 ETIMEDOUT 或取消的原因
         bool waitFor(CoMutex::Lock &lock, uint64_t timeout_ms);
 
+        // 无栈协程等待唤醒：co_await cv.asyncWait(mutex)
+        // 调用前需要已经通过 co_await mutex.asyncLock() 持有锁，返回时重新持有锁
+        Task<void> asyncWait(CoMutex &mutex);
+
+    private:
+        // 挂起已经加入等待队列的协程，令牌取消时把自己移出等待队列并唤醒
+        // 返回值：false 表示被取消唤醒，errno 为取消的原因
+        bool park(const std::shared_ptr<Fiber> &self);
+
+        // 等待队列空了以后删除空任务的定时器，需要持有 m_mutex
+        void clearTimer();
+
+        // 把无栈协程加入等待队列后释放协程锁
+        class WaitAwaiter
+        {
+        public:
+            WaitAwaiter(CoCondVar &cv, CoMutex &mutex) : m_cv(cv), m_lock(mutex) {}
+
+            bool await_ready() const noexcept { return false; }
+
+            bool await_suspend(std::coroutine_handle<> handle);
+
+            void await_resume() const noexcept {}
+
+        private:
+            CoCondVar &m_cv;
+            CoMutex &m_lock;
+        };
+
     private:
         std::set<std::shared_ptr<Fiber>> m_waitQueue; // 协程等待队列
+        std::deque<CoWaiter> m_coWaitQueue;           // 无栈协程等待队列
         MutexType m_mutex;                            // 保护协程等待队列
         std::shared_ptr<Timer> m_timer;               // 空任务的定时器，让调度器保持调度
     };
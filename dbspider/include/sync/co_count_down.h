@@ -14,14 +14,19 @@ namespace dbspider
         }
 
         // 使当前协程挂起等待，直到count的值被减到0，当前线程就会被唤醒。
-        void wait()
+        // 返回值：false 表示等待时当前协程被取消
+        bool wait()
         {
             CoMutex::Lock lock(m_mutex);
-            if (!m_count)
+            // 等待时要释放协程锁，否则 countDown 拿不到锁
+            while (m_count)
             {
-                return;
+                if (!m_condvar.wait(lock))
+                {
+                    return false;
+                }
             }
-            m_condvar.wait();
+            return true;
         }
 
         // 使latch的值减1，如果减到了0，则会唤醒所有等待在这个latch上的线程。
@@ -49,15 +49,20 @@ namespace dbspider
             m_used = 0;
         }
 
-        void wait()
+        // 返回值：false 表示等待时当前协程被取消，没有获取到信号量
+        bool wait()
         {
             CoMutex::Lock lock(m_mutex);
             // 如果已经获取的信号量大于等于信号量数量则让出协程等待
             while (m_used >= m_num)
             {
-                m_condvar.wait(lock);
+                if (!m_condvar.wait(lock))
+                {
+                    return false;
+                }
             }
             ++m_used;
+            return true;
         }
 
         void notify()
@@ -3,6 +3,8 @@
 #include <semaphore.h>
 #include <pthread.h>
 #include <atomic>
+#include <coroutine>
+#include <deque>
 #include <memory>
 #include <queue>
 
@@ -233,24 +235,63 @@ namespace dbspider
         pthread_rwlock_t m_rwmutex;
     };
 
-    // 协程锁
     class Fiber;
+    class Scheduler;
+
+    // 协程锁和协程条件变量的等待者，可以是有栈协程 Fiber，也可以是 C++20 无栈协程
+    struct CoWaiter
+    {
+        std::shared_ptr<Fiber> fiber;   // 有栈协程
+        std::coroutine_handle<> handle; // 无栈协程
+        Scheduler *scheduler = nullptr; // 无栈协程挂起时所在的调度器
+
+        // 将等待者重新加入调度
+        void wake() const;
+    };
+
+    // 协程锁
     class CoMutex : Noncopyable
     {
     public:
         using Lock = ScopedLock<CoMutex>;
 
+        // co_await mutex.asyncLock()，无栈协程获取锁
+        // 拿不到锁时挂起，解锁时把锁直接交给排在队首的无栈协程，恢复后就已经持有锁
+        class LockAwaiter
+        {
+        public:
+            explicit LockAwaiter(CoMutex &mutex) : m_mutex(mutex) {}
+
+            bool await_ready() { return m_mutex.tryLock(); }
+
+            bool await_suspend(std::coroutine_handle<> handle);
+
+            void await_resume() const noexcept {}
+
+        private:
+            CoMutex &m_mutex;
+        };
+
         bool tryLock();
 
         void lock();
 
+        // 获取锁，等待期间当前协程的取消令牌被取消时放弃等待
+        // 返回值：true 表示获取到锁; false 表示被取消，errno 为取消的原因
+        bool lockCancellable();
+
         void unlock();
 
+        LockAwaiter asyncLock() { return LockAwaiter(*this); }
+
+    private:
+        bool doLock(bool cancellable);
+
     private:
-        SpinLock m_mutex;                               // 协程所持有的锁
-        SpinLock m_gaurd;                               // 保护等待队列的锁
-        uint64_t m_fiberId = 0;                         // 持有锁的协程id
-        std::queue<std::shared_ptr<Fiber>> m_waitQueue; // 协程等待队列
+        SpinLock m_mutex;                 // 协程所持有的锁
+        SpinLock m_gaurd;                 // 保护等待队列的锁
+        uint64_t m_fiberId = 0;           // 持有锁的协程id
+        std::deque<CoWaiter> m_waitQueue; // 协程等待队列，被取消的协程要从中间移除
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <set>
+#include "co_condvar.h"
+#include "fiber.h"
+#include "small_task.h"
+
+namespace dbspider
+{
+    class IOManager;
+    class CancelToken;
+
+    // 协程等待组：登记若干个任务，等待它们全部或其中 n 个完成
+    // 与逐个等待 Channel 不同，等待者只在满足条件时被唤醒一次
+    class WaitGroup : Noncopyable
+    {
+    public:
+        using ptr = std::shared_ptr<WaitGroup>;
+
+        explicit WaitGroup(size_t count = 0)
+            : m_pending(count)
+        {
+        }
+
+        // 登记 n 个未完成的任务
+        void add(size_t n = 1);
+
+        // 一个任务完成，满足等待者的条件时唤醒等待者
+        void done();
+
+        // 挂起当前协程，直到全部任务完成，当前协程被取消时提前返回
+        void wait();
+
+        // 最多等待 timeout_ms 毫秒
+        // 返回值：true 表示全部任务完成; false 表示超时或当前协程被取消
+        bool waitFor(uint64_t timeout_ms);
+
+        // 挂起当前协程，直到至少 n 个任务完成、全部任务完成或超时，n 为 0 时等待全部完成
+        // 返回值：已完成的任务数
+        size_t waitAny(size_t n, uint64_t timeout_ms = -1);
+
+        // 未完成的任务数
+        size_t getPending() { return m_pending; }
+
+        // 已完成的任务数
+        size_t getFinished() { return m_finished; }
+
+    private:
+        std::atomic<size_t> m_pending;              // 未完成的任务数
+        std::atomic<size_t> m_finished{0};          // 已完成的任务数
+        std::atomic<size_t> m_minTarget{SIZE_MAX};  // 等待部分完成的等待者中最小的目标
+        std::multiset<size_t> m_targets;            // 等待部分完成的等待者需要的完成数
+        CoMutex m_mutex;                            // 保护 m_targets，唤醒等待者前加锁
+        CoCondVar m_condvar;
+    };
+
+    // 作用域协程组：在组内派生协程，统一等待、取消
+    // 组内任务共享一个取消令牌，它是创建组的协程的令牌的子令牌，父协程被取消或到达截止时间时组内任务一起取消
+    // 组析构时取消剩余的任务，并等待已经开始的任务结束，所以任务可以放心地引用父协程栈上的变量
+    //
+    //  std::vector<int> results(n);
+    //  FiberGroup group;
+    //  for (size_t i = 0; i < n; ++i)
+    //      group.spawn([&, i] { results[i] = client->call<int>("add", i, i).getVal(); });
+    //  group.waitFor(100);
+    class FiberGroup : Noncopyable
+    {
+    public:
+        // iom 为空时使用当前线程的 IOManager
+        explicit FiberGroup(IOManager *iom = nullptr);
+
+        ~FiberGroup();
+
+        // 在组内派生一个协程执行 cb，cb 继承当前协程的协程局部变量
+        // 组已经取消时直接丢弃 cb
+        // cb 按原类型放进任务，捕获不大时派生协程不分配内存
+        template <typename Cb>
+        void spawn(Cb &&cb)
+        {
+            if (isCancelled())
+            {
+                return;
+            }
+            m_wg->add();
+            submit(Fiber::Inherit([wg = m_wg, token = m_token, cb = std::forward<Cb>(cb)]() mutable
+                                  {
+                                      // cb 抛出的异常先保存下来，计入完成后再抛给协程入口记录日志，否则等待者永远等不到；
+                                      // done 可能挂起协程，不能在析构函数或 catch 块里调用
+                                      std::exception_ptr ex;
+                                      if (Begin(token))
+                                      {
+                                          try
+                                          {
+                                              cb();
+                                          }
+                                          catch (...)
+                                          {
+                                              ex = std::current_exception();
+                                          }
+                                      }
+                                      Finish(wg, ex); }));
+        }
+
+        // 等待全部任务完成
+        void wait();
+
+        // 最多等待 timeout_ms 毫秒，返回值：true 表示全部任务完成; false 表示超时
+        bool waitFor(uint64_t timeout_ms);
+
+        // 等待至少 n 个任务完成，返回已完成的任务数
+        size_t waitAny(size_t n, uint64_t timeout_ms = -1);
+
+        // 取消剩余的任务：还没开始执行的任务不再执行，
+        // 正在执行的任务挂起在 hook 的 IO、sleep、Channel 上时立即返回 ECANCELED，计算中的任务可以检查 isCancelled() 提前返回
+        void cancel();
+
+        bool isCancelled() const;
+
+        size_t getPending() { return m_wg->getPending(); }
+
+        size_t getFinished() { return m_wg->getFinished(); }
+
+    private:
+        // 把任务提交到组的 IOManager
+        void submit(SmallTask task);
+
+        // 任务开始执行：组已经取消时返回 false，否则把组的令牌设为当前协程的令牌
+        static bool Begin(const std::shared_ptr<CancelToken> &token);
+
+        // 任务结束：计入完成，再把 cb 抛出的异常重新抛出
+        static void Finish(const WaitGroup::ptr &wg, std::exception_ptr ex);
+
+    private:
+        IOManager *m_iom;
+        WaitGroup::ptr m_wg;                              // 任务可能晚于组结束，与任务共享
+        std::shared_ptr<CancelToken> m_token;             // 组内任务的取消令牌
+    };
+}
@@ -0,0 +1,98 @@
+#include "blocking_pool.h"
+
+#include "config.h"
+#include "log.h"
+
+namespace dbspider
+{
+    static Logger::ptr g_logger = DBSPIDER_LOG_NAME("system");
+
+    static ConfigVar<uint32_t>::ptr g_blocking_pool_threads =
+        Config::Lookup<uint32_t>("blocking_pool.threads", 4,
+                                 "blocking pool threads for blocking calls and cpu heavy work");
+
+    BlockingPool::BlockingPool(size_t threads, const std::string &name)
+    {
+        threads = std::max<size_t>(threads, 1);
+        for (size_t i = 0; i < threads; ++i)
+        {
+            m_threads.emplace_back(new Thread(name + "_" + std::to_string(i), [this]
+                                              { work(); }));
+        }
+    }
+
+    BlockingPool::~BlockingPool()
+    {
+        {
+            MutexType::Lock lock(m_mutex);
+            m_stop = true;
+        }
+        for (size_t i = 0; i < m_threads.size(); ++i)
+        {
+            m_sem.notify();
+        }
+        for (auto &thread : m_threads)
+        {
+            thread->join();
+        }
+    }
+
+    void BlockingPool::post(std::function<void()> cb)
+    {
+        push(std::move(cb), true);
+    }
+
+    void BlockingPool::push(std::function<void()> cb, bool count)
+    {
+        {
+            MutexType::Lock lock(m_mutex);
+            m_tasks.push_back(Task{std::move(cb), count});
+        }
+        m_sem.notify();
+    }
+
+    void BlockingPool::work()
+    {
+        while (true)
+        {
+            m_sem.wait();
+            Task task;
+            {
+                MutexType::Lock lock(m_mutex);
+                // 停止前先把队列中剩下的任务执行完，等待它们的协程才能被唤醒
+                if (m_tasks.empty())
+                {
+                    if (m_stop)
+                    {
+                        return;
+                    }
+                    continue;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            try
+            {
+                task.cb();
+            }
+            catch (std::exception &e)
+            {
+                DBSPIDER_LOG_ERROR(g_logger) << "BlockingPool task except: " << e.what();
+            }
+            catch (...)
+            {
+                DBSPIDER_LOG_ERROR(g_logger) << "BlockingPool task except";
+            }
+            if (task.count)
+            {
+                m_executed.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    BlockingPool *BlockingPool::GetInstance()
+    {
+        static BlockingPool s_pool(g_blocking_pool_threads->getValue(), "blocking");
+        return &s_pool;
+    }
+}
@@ -0,0 +1,190 @@
+#include "cancel.h"
+#include "io_manager.h"
+#include "util.h"
+
+namespace dbspider
+{
+    // 当前协程的令牌，协程迁移到其他线程后仍然有效
+    static FiberLocal<CancelToken::ptr> s_token;
+
+    CancelToken::ptr CancelToken::Create(uint64_t timeout_ms, ptr parent)
+    {
+        uint64_t deadline = timeout_ms == (uint64_t)-1 ? (uint64_t)-1 : GetCurrentMS() + timeout_ms;
+        bool own_deadline = true;
+        if (parent && parent->m_deadline <= deadline)
+        {
+            // parent 先到期，parent 取消时会一起取消子令牌，不需要自己的定时器
+            deadline = parent->m_deadline;
+            own_deadline = false;
+        }
+        ptr token(new CancelToken(deadline));
+        if (parent)
+        {
+            token->m_parent = parent;
+            std::weak_ptr<CancelToken> weak(token);
+            token->m_parentId = parent->addCallback([weak](int err)
+                                                    {
+                                                        if (auto t = weak.lock())
+                                                        {
+                                                            t->cancel(err);
+                                                        } });
+            if (!token->m_parentId)
+            {
+                token->cancel(parent->getError());
+                return token;
+            }
+        }
+        IOManager *iom = IOManager::GetThis();
+        if (own_deadline && deadline != (uint64_t)-1 && iom)
+        {
+            std::weak_ptr<CancelToken> weak(token);
+            token->m_timer = iom->addTimer(timeout_ms, [weak]
+                                           {
+                                               if (auto t = weak.lock())
+                                               {
+                                                   t->cancel(ETIMEDOUT);
+                                               } });
+        }
+        return token;
+    }
+
+    CancelToken::CancelToken(uint64_t deadline)
+        : m_deadline(deadline)
+    {
+    }
+
+    CancelToken::~CancelToken()
+    {
+        if (m_timer)
+        {
+            m_timer->cancel();
+        }
+        // parent 正在取消时，可能就是在 parent 的回调里释放了最后一个引用，不能再去拿 parent 的锁
+        if (m_parent && m_parentId && !m_parent->m_error)
+        {
+            m_parent->delCallback(m_parentId);
+        }
+    }
+
+    bool CancelToken::cancel(int err)
+    {
+        MutexType::Lock lock(m_mutex);
+        int expect = 0;
+        err = err ? err : ECANCELED;
+        if (!m_error.compare_exchange_strong(expect, err))
+        {
+            return false;
+        }
+        // 持有锁执行回调，delCallback 返回后回调不会再执行
+        for (auto &it : m_callbacks)
+        {
+            it.second(err);
+        }
+        m_callbacks.clear();
+        return true;
+    }
+
+    bool CancelToken::isCancelled()
+    {
+        if (m_error)
+        {
+            return true;
+        }
+        // 没有定时器（不在 IOManager 中创建）时在这里检查截止时间
+        if (m_deadline != (uint64_t)-1 && GetCurrentMS() >= m_deadline)
+        {
+            cancel(ETIMEDOUT);
+            return true;
+        }
+        return false;
+    }
+
+    int CancelToken::getError()
+    {
+        return isCancelled() ? m_error.load() : 0;
+    }
+
+    uint64_t CancelToken::getRemainingMS() const
+    {
+        if (m_deadline == (uint64_t)-1)
+        {
+            return -1;
+        }
+        uint64_t now = GetCurrentMS();
+        return now >= m_deadline ? 0 : m_deadline - now;
+    }
+
+    uint64_t CancelToken::addCallback(std::function<void(int)> cb)
+    {
+        if (isCancelled())
+        {
+            return 0;
+        }
+        MutexType::Lock lock(m_mutex);
+        if (m_error)
+        {
+            return 0;
+        }
+        uint64_t id = m_nextId++;
+        m_callbacks.emplace(id, std::move(cb));
+        return id;
+    }
+
+    void CancelToken::delCallback(uint64_t id)
+    {
+        MutexType::Lock lock(m_mutex);
+        m_callbacks.erase(id);
+    }
+
+    CancelToken::ptr CancelToken::GetThis()
+    {
+        ptr *token = s_token.get();
+        return token ? *token : nullptr;
+    }
+
+    void CancelToken::SetThis(ptr token)
+    {
+        if (token)
+        {
+            s_token.set(std::move(token));
+        }
+        else if (GetThis())
+        {
+            s_token.reset();
+        }
+    }
+
+    bool CancelToken::Check()
+    {
+        ptr token = GetThis();
+        if (token && token->isCancelled())
+        {
+            errno = token->getError();
+            return true;
+        }
+        return false;
+    }
+
+    CancelToken::Listener::Listener(std::function<void(int)> cb)
+        : m_token(GetThis())
+    {
+        if (!m_token)
+        {
+            return;
+        }
+        m_id = m_token->addCallback(std::move(cb));
+        if (!m_id)
+        {
+            m_cancelled = true;
+            errno = m_token->getError();
+        }
+    }
+
+    CancelToken::Listener::~Listener()
+    {
+        if (m_id)
+        {
+            m_token->delCallback(m_id);
+        }
+    }
+}
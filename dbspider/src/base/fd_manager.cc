@@ -11,6 +11,7 @@ namespace dbspider
     FdCtx::FdCtx(int fd)
         : m_isInit(false),
           m_isSocket(false),
+          m_isFile(false),
           m_sysNonblock(false),
           m_userNonblock(false),
           m_isClosed(false),
@@ -27,50 +28,61 @@ namespace dbspider
 
     bool FdCtx::init()
     {
-        if (m_isInit)
+        if (m_isInit.load(std::memory_order_relaxed))
         {
             return true;
         }
-        m_sendTimeout = -1;
-        m_recvTimeout = -1;
+        return probe();
+    }
+
+    bool FdCtx::probe()
+    {
+        m_sendTimeout.store(-1, std::memory_order_relaxed);
+        m_recvTimeout.store(-1, std::memory_order_relaxed);
+        bool isInit = false;
+        bool isSocket = false;
+        bool isFile = false;
         struct stat fd_state;
-        if (fstat(m_fd, &fd_state) == -1)
-        {
-            m_isInit = false;
-            m_isSocket = false;
-        }
-        else
+        if (fstat(m_fd, &fd_state) != -1)
         {
-            m_isInit = true;
-            m_isSocket = S_ISSOCK(fd_state.st_mode);
+            isInit = true;
+            isSocket = S_ISSOCK(fd_state.st_mode);
+            isFile = S_ISREG(fd_state.st_mode);
         }
-        if (m_isSocket)
+        if (isSocket)
         {
             int flags = fcntl_f(m_fd, F_GETFL, 0);
             if (!(flags & O_NONBLOCK))
             {
                 fcntl_f(m_fd, F_SETFL, flags | O_NONBLOCK);
             }
-            m_sysNonblock = true;
-        }
-        else
-        {
-            m_sysNonblock = false;
         }
-        m_userNonblock = false;
-        m_isClosed = false;
-        return m_isInit;
+        m_isSocket.store(isSocket, std::memory_order_relaxed);
+        m_isFile.store(isFile, std::memory_order_relaxed);
+        m_sysNonblock.store(isSocket, std::memory_order_relaxed);
+        m_userNonblock.store(false, std::memory_order_relaxed);
+        m_isClosed.store(false, std::memory_order_relaxed);
+        m_isInit.store(isInit, std::memory_order_relaxed);
+        return isInit;
+    }
+
+    void FdCtx::reopen()
+    {
+        // 先增加代数，还拿着旧连接的协程醒来后就能发现fd已经换了
+        // 不先把 m_isInit 清掉，否则并发的读者会在这段时间里把它当成未初始化的fd
+        m_generation.fetch_add(1, std::memory_order_acq_rel);
+        probe();
     }
 
     void FdCtx::setTimeout(int type, uint64_t timeout)
     {
         if (type == SO_RCVTIMEO)
         {
-            m_recvTimeout = timeout;
+            m_recvTimeout.store(timeout, std::memory_order_relaxed);
         }
         else
         {
-            m_sendTimeout = timeout;
+            m_sendTimeout.store(timeout, std::memory_order_relaxed);
         }
     }
 
@@ -78,58 +90,83 @@ namespace dbspider
     {
         if (type == SO_RCVTIMEO)
         {
-            return m_recvTimeout;
+            return m_recvTimeout.load(std::memory_order_relaxed);
         }
         else
         {
-            return m_sendTimeout;
+            return m_sendTimeout.load(std::memory_order_relaxed);
         }
     }
 
     FdManager::FdManager()
     {
-        m_fds.resize(64);
+        m_fds.getOrCreate(0);
     }
 
-    FdCtx::ptr FdManager::get(int fd, bool auto_create)
+    FdCtx *FdManager::get(int fd, bool auto_create)
     {
-        if (fd == -1)
+        if (fd < 0)
         {
             return nullptr;
         }
-        RWMutexType::ReadLock readLock(m_mutex);
-        if ((int)m_fds.size() <= fd)
+        Slot *slot = m_fds.get(fd);
+        if (slot)
         {
-            if (auto_create == false)
+            FdCtx *fdCtx = slot->ctx.load(std::memory_order_acquire);
+            if (fdCtx || auto_create == false)
             {
-                return nullptr;
+                return fdCtx;
             }
         }
-        else
+        else if (auto_create == false)
         {
-            if (m_fds[fd] || auto_create == false)
-            {
-                return m_fds[fd];
-            }
+            return nullptr;
         }
-        readLock.unlock();
-        RWMutexType::WriteLock writeLock(m_mutex);
-        if (fd >= (int)m_fds.size())
+        return create(fd, false);
+    }
+
+    FdCtx *FdManager::open(int fd)
+    {
+        if (fd < 0)
+        {
+            return nullptr;
+        }
+        return create(fd, true);
+    }
+
+    FdCtx *FdManager::create(int fd, bool reopen)
+    {
+        MutexType::Lock lock(m_mutex);
+        Slot *slot = m_fds.getOrCreate(fd);
+        if (!slot)
+        {
+            return nullptr;
+        }
+        // 其他线程可能已经在锁内打开过了
+        FdCtx *fdCtx = slot->ctx.load(std::memory_order_acquire);
+        if (!fdCtx || reopen)
         {
-            m_fds.resize(fd * 1.5);
+            if (slot->storage)
+            {
+                slot->storage->reopen();
+            }
+            else
+            {
+                slot->storage.reset(new FdCtx(fd));
+            }
+            fdCtx = slot->storage.get();
+            slot->ctx.store(fdCtx, std::memory_order_release);
         }
-        FdCtx::ptr fdCtx(new FdCtx(fd));
-        m_fds[fd] = fdCtx;
         return fdCtx;
     }
 
     void FdManager::del(int fd)
     {
-        RWMutexType::WriteLock writeLock(m_mutex);
-        if ((int)m_fds.size() <= fd)
+        Slot *slot = fd < 0 ? nullptr : m_fds.get(fd);
+        if (!slot)
         {
             return;
         }
-        m_fds[fd].reset();
+        slot->ctx.store(nullptr, std::memory_order_release);
     }
 }
\ No newline at end of file
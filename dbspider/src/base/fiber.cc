@@ -2,6 +2,12 @@
 #include "config.h"
 #include "fiber.h"
 #include "macro.h"
+#include "ring_queue.h"
+
+#include <algorithm>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 namespace dbspider
 {
@@ -19,51 +25,237 @@ namespace dbspider
     // 当前线程的主协程，切换到这个协程，就相当于切换到了主线程中运行
     static thread_local Fiber::ptr t_threadFiber = nullptr;
 
+    // 当前线程的抢占标记，只有调度线程设置
+    static thread_local std::atomic<bool> *t_preempt = nullptr;
+
+    // 在检查点被抢占让出的次数
+    static std::atomic<uint64_t> s_preempt_count{0};
+
+    // 已经分配的协程局部存储下标数
+    static std::atomic<size_t> s_local_count{0};
+
     static ConfigVar<uint32_t>::ptr g_fiber_stack_size =
         Config::Lookup<uint32_t>("fiber.stack_size", 128 * 1024, "Fiber stack size");
 
-    // malloc栈内存分配器
-    class MallocStackAllocator
+    static ConfigVar<uint32_t>::ptr g_fiber_stack_pool_max =
+        Config::Lookup<uint32_t>("fiber.stack_pool_max", 256, "Max idle fiber stacks cached per thread");
+
+    static ConfigVar<uint32_t>::ptr g_fiber_stack_pool_warm =
+        Config::Lookup<uint32_t>("fiber.stack_pool_warm", 16, "Idle fiber stacks per thread that keep their memory");
+
+    // 协程栈池命中/未命中次数
+    static std::atomic<uint64_t> s_stack_pool_hits{0};
+    static std::atomic<uint64_t> s_stack_pool_misses{0};
+
+    // mmap栈内存分配器，栈底有一个PROT_NONE的保护页，栈溢出时直接触发SIGSEGV而不是悄悄破坏堆内存
+    class MmapStackAllocator
+    {
+    public:
+        static void *Alloc(size_t size)
+        {
+            size_t page = PageSize();
+            void *base = mmap(nullptr, size + page, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            DBSPIDER_ASSERT2(base != MAP_FAILED, "System error: mmap fiber stack fail");
+            if (mprotect(base, page, PROT_NONE))
+            {
+                DBSPIDER_ASSERT2(false, "System error: mprotect fiber stack guard page fail");
+            }
+            return (char *)base + page;
+        }
+
+        static void Dealloc(void *vp, size_t size)
+        {
+            size_t page = PageSize();
+            munmap((char *)vp - page, size + page);
+        }
+
+        // 释放栈占用的物理内存，保留虚拟地址空间，再次使用时按需缺页
+        static void Trim(void *vp, size_t size)
+        {
+            madvise(vp, size, MADV_DONTNEED);
+        }
+
+    private:
+        static size_t PageSize()
+        {
+            static size_t s_page = sysconf(_SC_PAGESIZE);
+            return s_page;
+        }
+    };
+
+    // 每个线程缓存一批空闲的协程栈，协程创建和销毁时优先从本线程的缓存中取还，
+    // 短生命周期的协程在常见情况下不需要mmap/munmap
+    // 缓存按归还的先后排列，取还都在最新的一端，最近用过的 warm 个栈保留物理内存；
+    // 更旧的栈在落出这个范围时归还一次物理内存，缓存满了淘汰最旧的栈，所以反复创建销毁协程不会触发系统调用
+    class PooledStackAllocator
     {
     public:
-        static void *Alloc(size_t size) { return malloc(size); }
-        static void Dealloc(void *vp, size_t size) { free(vp); }
+        static void *Alloc(size_t size)
+        {
+            auto &stacks = GetPool().stacks;
+            // 只复用大小相同的栈，栈大小配置修改后旧栈会逐渐被淘汰
+            if (!stacks.empty() && stacks.back().size == size)
+            {
+                // 热端的栈通常没有归还过物理内存，不需要重新缺页
+                void *vp = stacks.back().sp;
+                stacks.pop_back();
+                ++s_stack_pool_hits;
+                return vp;
+            }
+            ++s_stack_pool_misses;
+            return MmapStackAllocator::Alloc(size);
+        }
+
+        static void Dealloc(void *vp, size_t size)
+        {
+            auto &stacks = GetPool().stacks;
+            size_t max = g_fiber_stack_pool_max->getValue();
+            if (max == 0)
+            {
+                MmapStackAllocator::Dealloc(vp, size);
+                return;
+            }
+            // 缓存满了淘汰最旧的栈
+            if (stacks.size() >= max)
+            {
+                MmapStackAllocator::Dealloc(stacks.front().sp, stacks.front().size);
+                stacks.pop_front();
+            }
+            stacks.push_back({vp, size, false});
+            // 刚落出 warm 范围的栈归还物理内存，每个栈在缓存中最多归还一次
+            size_t warm = g_fiber_stack_pool_warm->getValue();
+            if (stacks.size() > warm)
+            {
+                Stack &cold = stacks[stacks.size() - warm - 1];
+                if (!cold.trimmed)
+                {
+                    MmapStackAllocator::Trim(cold.sp, cold.size);
+                    cold.trimmed = true;
+                }
+            }
+        }
+
+    private:
+        struct Stack
+        {
+            void *sp;
+            size_t size;
+            bool trimmed; // 是否已经归还了物理内存
+        };
+
+        struct Pool
+        {
+            RingQueue<Stack> stacks; // 队头最旧，队尾最新，容量稳定后取还不分配内存
+
+            ~Pool()
+            {
+                for (size_t i = 0; i < stacks.size(); ++i)
+                {
+                    MmapStackAllocator::Dealloc(stacks[i].sp, stacks[i].size);
+                }
+            }
+        };
+
+        static Pool &GetPool()
+        {
+            static thread_local Pool t_pool;
+            return t_pool;
+        }
+    };
+
+    using StackAllocator = PooledStackAllocator;
+
+    static ConfigVar<uint32_t>::ptr g_fiber_shared_stack_size =
+        Config::Lookup<uint32_t>("fiber.shared_stack_size", 1024 * 1024, "Shared fiber stack size");
+
+    static ConfigVar<uint32_t>::ptr g_fiber_shared_stack_count =
+        Config::Lookup<uint32_t>("fiber.shared_stack_count", 4, "Shared fiber stacks per thread");
+
+    // 线程的共享栈，多个共享栈协程轮流在上面运行
+    struct SharedStack
+    {
+        void *stack = nullptr; // 栈底（低地址）
+        size_t size = 0;       // 栈大小
+        uint64_t last = 0;     // 最后一个在这个栈上运行的协程id，栈上的内容还是它的
+
+        char *top() const { return (char *)stack + size; }
     };
 
-    using StackAllocator = MallocStackAllocator;
+    // 每个线程若干个共享栈，共享栈协程按轮转的方式分配到其中一个上
+    class SharedStackPool
+    {
+    public:
+        static SharedStack *Next()
+        {
+            auto &pool = GetPool();
+            if (pool.stacks.empty())
+            {
+                size_t count = std::max(g_fiber_shared_stack_count->getValue(), 1u);
+                size_t size = g_fiber_shared_stack_size->getValue();
+                pool.stacks.resize(count);
+                for (auto &s : pool.stacks)
+                {
+                    s.size = size;
+                    s.stack = MmapStackAllocator::Alloc(size);
+                }
+            }
+            return &pool.stacks[pool.next++ % pool.stacks.size()];
+        }
+
+    private:
+        struct Pool
+        {
+            std::vector<SharedStack> stacks;
+            size_t next = 0;
+
+            ~Pool()
+            {
+                for (auto &s : stacks)
+                {
+                    MmapStackAllocator::Dealloc(s.stack, s.size);
+                }
+            }
+        };
+
+        static Pool &GetPool()
+        {
+            static thread_local Pool t_pool;
+            return t_pool;
+        }
+    };
 
     // 主协程构造
     Fiber::Fiber()
     {
         m_state = EXEC;
         SetThis(this);
+#ifdef DBSPIDER_FIBER_UCONTEXT
         if (getcontext(&m_ctx))
         {
             DBSPIDER_ASSERT2(false, "System error: getcontext fail");
         }
+#endif
         ++s_fiber_count;
     }
 
     // 普通协程构造
-    Fiber::Fiber(std::function<void()> cb, size_t stacksize)
+    Fiber::Fiber(SmallTask cb, size_t stacksize, bool shared_stack)
         : m_id(++s_fiber_id),
-          m_cb(cb)
+          m_cb(std::move(cb)),
+          m_sharedMode(shared_stack)
     {
         DBSPIDER_ASSERT2(t_fiber, "Fiber error: no main fiber");
 
         s_fiber_count++;
-        m_stacksize = stacksize ? stacksize : g_fiber_stack_size->getValue();
-        m_stack = StackAllocator::Alloc(m_stacksize);
-
-        if (getcontext(&m_ctx))
+        if (m_sharedMode)
         {
-            DBSPIDER_ASSERT2(false, "System error: getcontext fail");
+            // 共享栈在第一次切入时才绑定，上下文也在那时构造
+            DBSPIDER_LOG_DEBUG(g_logger) << "Fiber::Fiber id=" << m_id << " shared stack";
+            return;
         }
-        m_ctx.uc_stack.ss_size = m_stacksize;
-        m_ctx.uc_stack.ss_sp = m_stack;
-        m_ctx.uc_link = nullptr;
-
-        makecontext(&m_ctx, MainFunc, 0);
+        // 栈在第一次切入时由运行协程的线程分配，绑核之后栈来自该线程的栈池，首次访问的内存也在本地 NUMA 节点上
+        m_stacksize = stacksize ? stacksize : g_fiber_stack_size->getValue();
         DBSPIDER_LOG_DEBUG(g_logger) << "Fiber::Fiber id=" << m_id;
     }
 
@@ -71,12 +263,22 @@ namespace dbspider
     Fiber::~Fiber()
     {
         --s_fiber_count;
-        if (m_stack)
+        if (m_sharedMode)
+        {
+            DBSPIDER_ASSERT(m_state == INIT || m_state == TERM || m_state == EXCEPT);
+            free(m_savedStack);
+        }
+        else if (m_stack)
         {
             // 有栈，说明是子协程，需要确保子协程一定是结束状态
             DBSPIDER_ASSERT(m_state == INIT || m_state == TERM || m_state == EXCEPT);
             StackAllocator::Dealloc(m_stack, m_stacksize);
         }
+        else if (m_id)
+        {
+            // 没有栈的子协程，说明从来没有被切入过
+            DBSPIDER_ASSERT(m_state == INIT || m_state == TERM || m_state == EXCEPT);
+        }
         else
         {
             // 没有栈，说明是线程的主协程
@@ -96,12 +298,32 @@ namespace dbspider
     {
         SetThis(this);
         DBSPIDER_ASSERT2(m_state != EXEC, "Fiber id=" + std::to_string(m_id));
+        if (m_sharedMode)
+        {
+            switchInSharedStack();
+        }
+        else if (!m_stack)
+        {
+            m_stack = StackAllocator::Alloc(m_stacksize);
+            makeContext();
+        }
         m_state = EXEC;
 
         // 保存当前上下文到主协程，切换到子协程上下文
-        if (swapcontext(&(t_threadFiber->m_ctx), &m_ctx))
+        SwapContext(t_threadFiber.get(), this);
+
+        // 回到主协程后，共享栈协程的栈已经不再被使用，可以安全地拷贝出来
+        if (m_sharedMode)
         {
-            DBSPIDER_ASSERT2(false, "system error: swapcontext() fail");
+            switchOutSharedStack();
+        }
+
+        // 上下文保存完成后才公布让出时的状态，否则其他线程看到 HOLD/READY 后可能在协程还没切出时就恢复它
+        State state = m_yieldState;
+        m_yieldState = EXEC;
+        if (state != EXEC)
+        {
+            m_state = state;
         }
     }
 
@@ -111,31 +333,123 @@ namespace dbspider
         SetThis(t_threadFiber.get());
 
         // 保存子协程上下文，切换到主协程上下文
-        if (swapcontext(&m_ctx, &(t_threadFiber->m_ctx)))
-        {
-            DBSPIDER_ASSERT2(false, "system error: swapcontext() fail");
-        }
+        SwapContext(this, t_threadFiber.get());
     }
 
     // 重置协程执行函数，并重置状态
-    void Fiber::reset(std::function<void()> cb)
+    void Fiber::reset(SmallTask cb)
     {
-        DBSPIDER_ASSERT(m_stack);
+        DBSPIDER_ASSERT(m_id); // 主协程不能重置
         DBSPIDER_ASSERT(m_state == INIT || m_state == TERM || m_state == EXCEPT);
 
-        m_cb = cb;
+        m_cb = std::move(cb);
+        for (auto &slot : m_locals.slots)
+        {
+            slot.reset();
+        }
+        m_locals.overflow.clear();
+        m_localsSnapshot.reset();
+
+        // 共享栈协程和还没有分配栈的协程在切入时构造上下文
+        if (!m_sharedMode && m_stack)
+        {
+            makeContext();
+        }
+        m_state = INIT;
+    }
 
+    // 在协程栈上构造以MainFunc为入口的上下文
+    void Fiber::makeContext()
+    {
+#ifdef DBSPIDER_FIBER_UCONTEXT
         if (getcontext(&m_ctx))
         {
             DBSPIDER_ASSERT2(false, "System error: getcontext fail");
         }
 
-        m_ctx.uc_stack.ss_size = m_stacksize;
-        m_ctx.uc_stack.ss_sp = m_stack;
+        m_ctx.uc_stack.ss_size = m_sharedMode ? m_sharedStack->size : m_stacksize;
+        m_ctx.uc_stack.ss_sp = m_sharedMode ? m_sharedStack->stack : m_stack;
         m_ctx.uc_link = nullptr;
 
         makecontext(&m_ctx, MainFunc, 0);
-        m_state = INIT;
+#else
+        if (m_sharedMode)
+        {
+            m_ctx = MakeFContext(m_sharedStack->stack, m_sharedStack->size, MainFunc);
+        }
+        else
+        {
+            m_ctx = MakeFContext(m_stack, m_stacksize, MainFunc);
+        }
+#endif
+    }
+
+    // 共享栈协程切入前绑定共享栈，并把保存的栈拷贝回共享栈
+    void Fiber::switchInSharedStack()
+    {
+        if (!m_sharedStack)
+        {
+            m_sharedStack = SharedStackPool::Next();
+            m_thread = GetThreadId();
+        }
+        // 栈上保存的是共享栈的地址，只能回到原来的线程、原来的共享栈上运行
+        DBSPIDER_ASSERT2(m_thread == GetThreadId(), "Fiber id=" + std::to_string(m_id) + " bound to another thread");
+
+        if (m_state == INIT)
+        {
+            makeContext();
+        }
+        else if (m_sharedStack->last != m_id)
+        {
+            // 共享栈上次被其他协程用过，把自己的栈拷贝回去
+            memcpy(m_sharedStack->top() - m_savedSize, m_savedStack, m_savedSize);
+        }
+        m_sharedStack->last = m_id;
+    }
+
+    // 共享栈协程让出后把用到的栈拷贝出来
+    void Fiber::switchOutSharedStack()
+    {
+        if (isTerminate())
+        {
+            free(m_savedStack);
+            m_savedStack = nullptr;
+            m_savedSize = 0;
+            return;
+        }
+
+        // 切出时的栈顶，以下的部分不再需要保存
+#ifndef DBSPIDER_FIBER_UCONTEXT
+        char *sp = (char *)m_ctx;
+#elif defined(__x86_64__)
+        char *sp = (char *)m_ctx.uc_mcontext.gregs[REG_RSP] - 128; // 留出红区
+#elif defined(__aarch64__)
+        char *sp = (char *)m_ctx.uc_mcontext.sp;
+#else
+        char *sp = (char *)m_sharedStack->stack; // 不知道栈顶在哪，保守地保存整个栈
+#endif
+        sp = std::max(sp, (char *)m_sharedStack->stack);
+        size_t used = m_sharedStack->top() - sp;
+        if (used != m_savedSize)
+        {
+            m_savedStack = (char *)realloc(m_savedStack, used);
+            DBSPIDER_ASSERT2(m_savedStack, "System error: realloc saved stack fail");
+            m_savedSize = used;
+        }
+        memcpy(m_savedStack, sp, used);
+    }
+
+    // 保存当前上下文到from，切换到to的上下文
+    void Fiber::SwapContext(Fiber *from, Fiber *to)
+    {
+#ifdef DBSPIDER_FIBER_UCONTEXT
+        if (swapcontext(&from->m_ctx, &to->m_ctx))
+        {
+            DBSPIDER_ASSERT2(false, "system error: swapcontext() fail");
+        }
+#else
+        JumpFContext(&from->m_ctx, to->m_ctx);
+#endif
     }
 
     // 在当前线程启用协程
@@ -179,7 +493,7 @@ namespace dbspider
     void Fiber::YieldToHold()
     {
         Fiber::ptr cur = GetThis();
-        cur->m_state = HOLD;
+        cur->m_yieldState = HOLD;
         cur->yield();
     }
 
@@ -187,7 +501,7 @@ namespace dbspider
     void Fiber::YieldToReady()
     {
         Fiber::ptr cur = GetThis();
-        cur->m_state = READY;
+        cur->m_yieldState = READY;
         cur->yield();
     }
 
@@ -219,4 +533,105 @@ namespace dbspider
         return s_fiber_count;
     }
 
+    // 协程栈池命中次数
+    uint64_t Fiber::StackPoolHits()
+    {
+        return s_stack_pool_hits;
+    }
+
+    // 协程栈池未命中次数
+    uint64_t Fiber::StackPoolMisses()
+    {
+        return s_stack_pool_misses;
+    }
+
+    bool Fiber::MaybeYield()
+    {
+        if (!t_preempt || !t_preempt->load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+        // 主协程（调度协程）不能让出
+        if (!t_fiber || t_fiber == t_threadFiber.get())
+        {
+            return false;
+        }
+        t_preempt->store(false, std::memory_order_relaxed);
+        s_preempt_count.fetch_add(1, std::memory_order_relaxed);
+        YieldToReady();
+        return true;
+    }
+
+    void Fiber::SetPreemptFlag(std::atomic<bool> *flag)
+    {
+        t_preempt = flag;
+    }
+
+    uint64_t Fiber::TotalPreempts()
+    {
+        return s_preempt_count.load(std::memory_order_relaxed);
+    }
+
+    size_t Fiber::AllocLocalIndex()
+    {
+        return s_local_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void *Fiber::GetLocal(size_t index)
+    {
+        if (!t_fiber)
+        {
+            return nullptr;
+        }
+        Locals &locals = t_fiber->m_locals;
+        if (index < INLINE_LOCALS)
+        {
+            return locals.slots[index].get();
+        }
+        index -= INLINE_LOCALS;
+        return index < locals.overflow.size() ? locals.overflow[index].get() : nullptr;
+    }
+
+    void Fiber::SetLocal(size_t index, std::shared_ptr<void> value)
+    {
+        EnableFiber();
+        t_fiber->m_localsSnapshot.reset();
+        Locals &locals = t_fiber->m_locals;
+        if (index < INLINE_LOCALS)
+        {
+            locals.slots[index] = std::move(value);
+            return;
+        }
+        index -= INLINE_LOCALS;
+        if (index >= locals.overflow.size())
+        {
+            if (!value)
+            {
+                return;
+            }
+            locals.overflow.resize(index + 1);
+        }
+        locals.overflow[index] = std::move(value);
+    }
+
+    std::shared_ptr<const Fiber::Locals> Fiber::LocalsSnapshot()
+    {
+        if (!t_fiber)
+        {
+            return nullptr;
+        }
+        if (!t_fiber->m_localsSnapshot && !t_fiber->m_locals.empty())
+        {
+            t_fiber->m_localsSnapshot = std::make_shared<const Locals>(t_fiber->m_locals);
+        }
+        return t_fiber->m_localsSnapshot;
+    }
+
+    void Fiber::LoadLocals(const Locals &locals)
+    {
+        EnableFiber();
+        t_fiber->m_locals = locals;
+        t_fiber->m_localsSnapshot.reset();
+    }
+
 }
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "fiber_context.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace dbspider
+{
+#ifndef DBSPIDER_FIBER_UCONTEXT
+
+#if defined(__x86_64__)
+    // System V AMD64 ABI 的被调用者保存寄存器是 rbx、rbp、r12~r15，另外保存 MXCSR 和 x87 控制字
+    // 切出时栈顶（低地址在前）的布局：
+    //   [mxcsr(4) fpucw(4)] r12 r13 r14 r15 rbx rbp 返回地址
+    // rdi = from，rsi = to
+    __asm__(
+        ".text\n"
+        ".globl dbspider_jump_fcontext\n"
+        ".type dbspider_jump_fcontext,@function\n"
+        ".align 16\n"
+        "dbspider_jump_fcontext:\n"
+        "    pushq %rbp\n"
+        "    pushq %rbx\n"
+        "    pushq %r15\n"
+        "    pushq %r14\n"
+        "    pushq %r13\n"
+        "    pushq %r12\n"
+        "    leaq -8(%rsp), %rsp\n"
+        "    stmxcsr (%rsp)\n"
+        "    fnstcw 4(%rsp)\n"
+        "    movq %rsp, (%rdi)\n"
+        "    movq %rsi, %rsp\n"
+        "    ldmxcsr (%rsp)\n"
+        "    fldcw 4(%rsp)\n"
+        "    leaq 8(%rsp), %rsp\n"
+        "    popq %r12\n"
+        "    popq %r13\n"
+        "    popq %r14\n"
+        "    popq %r15\n"
+        "    popq %rbx\n"
+        "    popq %rbp\n"
+        "    ret\n"
+        ".size dbspider_jump_fcontext,.-dbspider_jump_fcontext\n");
+
+    // 被保存的寄存器个数，不含返回地址
+    static const size_t s_saved_regs = 6;
+
+    fcontext_t MakeFContext(void *stack, size_t size, void (*fn)())
+    {
+        // 栈顶按 16 字节对齐，第一次切入时 ret 弹出 fn 作为返回地址，
+        // 进入 fn 时 rsp + 8 是 16 字节对齐的，与正常 call 进入函数时一致；fn 自己的返回地址为 0
+        uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+        uint64_t *sp = (uint64_t *)top - 2;
+        sp[1] = 0;
+        sp[0] = (uint64_t)fn;
+        sp -= s_saved_regs + 1;
+        memset(sp, 0, (s_saved_regs + 1) * sizeof(uint64_t));
+        uint32_t *ctrl = (uint32_t *)sp;
+        ctrl[0] = 0x1f80; // MXCSR 默认值，屏蔽所有浮点异常
+        ctrl[1] = 0x037f; // x87 控制字默认值
+        return sp;
+    }
+
+#elif defined(__aarch64__)
+    // AAPCS64 的被调用者保存寄存器是 x19~x28、x29(fp)、x30(lr) 以及 d8~d15 的低 64 位
+    // 切出时栈顶的布局：x19~x28 x29 x30 d8~d15，共 160 字节
+    // x0 = from，x1 = to
+    __asm__(
+        ".text\n"
+        ".globl dbspider_jump_fcontext\n"
+        ".type dbspider_jump_fcontext,%function\n"
+        ".align 4\n"
+        "dbspider_jump_fcontext:\n"
+        "    sub sp, sp, #160\n"
+        "    stp x19, x20, [sp, #0]\n"
+        "    stp x21, x22, [sp, #16]\n"
+        "    stp x23, x24, [sp, #32]\n"
+        "    stp x25, x26, [sp, #48]\n"
+        "    stp x27, x28, [sp, #64]\n"
+        "    stp x29, x30, [sp, #80]\n"
+        "    stp d8, d9, [sp, #96]\n"
+        "    stp d10, d11, [sp, #112]\n"
+        "    stp d12, d13, [sp, #128]\n"
+        "    stp d14, d15, [sp, #144]\n"
+        "    mov x9, sp\n"
+        "    str x9, [x0]\n"
+        "    mov sp, x1\n"
+        "    ldp x19, x20, [sp, #0]\n"
+        "    ldp x21, x22, [sp, #16]\n"
+        "    ldp x23, x24, [sp, #32]\n"
+        "    ldp x25, x26, [sp, #48]\n"
+        "    ldp x27, x28, [sp, #64]\n"
+        "    ldp x29, x30, [sp, #80]\n"
+        "    ldp d8, d9, [sp, #96]\n"
+        "    ldp d10, d11, [sp, #112]\n"
+        "    ldp d12, d13, [sp, #128]\n"
+        "    ldp d14, d15, [sp, #144]\n"
+        "    add sp, sp, #160\n"
+        "    ret\n"
+        ".size dbspider_jump_fcontext,.-dbspider_jump_fcontext\n");
+
+    // 保存寄存器区的大小
+    static const size_t s_saved_size = 160;
+
+    fcontext_t MakeFContext(void *stack, size_t size, void (*fn)())
+    {
+        // 第一次切入时从 x30 返回到 fn，此时 sp 正好回到 16 字节对齐的栈顶，fp 为 0 作为栈回溯的终点
+        uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+        uint64_t *sp = (uint64_t *)(top - s_saved_size);
+        memset(sp, 0, s_saved_size);
+        sp[11] = (uint64_t)fn;
+        return sp;
+    }
+#endif
+
+    const char *FiberContextBackend()
+    {
+#if defined(__x86_64__)
+        return "asm-x86_64";
+#else
+        return "asm-aarch64";
+#endif
+    }
+
+#else
+
+    const char *FiberContextBackend()
+    {
+        return "ucontext";
+    }
+
+#endif
+}
@@ -1,12 +1,16 @@
 #include <dlfcn.h>
 #include <fcntl.h>
+#include <linux/io_uring.h>
 #include <stdarg.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <stdint.h>
 #include <time.h>
 #include <unistd.h>
+#include "blocking_pool.h"
+#include "cancel.h"
 #include "config.h"
 #include "fiber.h"
 #include "fd_manager.h"
@@ -19,6 +23,9 @@ static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_NAME("system");
 static dbspider::ConfigVar<int>::ptr g_tcp_connect_timeout =
     dbspider::Config::Lookup("tcp.connect.timeout", 5000, "tcp connect timeout");
 
+static dbspider::ConfigVar<bool>::ptr g_file_io_offload =
+    dbspider::Config::Lookup("hook.file_io_offload", true, "hooked read/write on regular files run in the blocking pool");
+
 namespace dbspider
 {
     static thread_local bool t_hook_enable = false;
@@ -30,6 +37,8 @@ namespace dbspider
     XX(socket)       \
     XX(connect)      \
     XX(accept)       \
+    XX(open)         \
+    XX(openat)       \
     XX(read)         \
     XX(readv)        \
     XX(recv)         \
@@ -59,6 +68,7 @@ namespace dbspider
     }
 
     static uint64_t s_connect_timout = -1;
+    static bool s_file_io_offload = true;
 
     struct _HookIniter
     {
@@ -71,6 +81,9 @@ namespace dbspider
             DBSPIDER_LOG_INFO(g_logger) << "tcp connect timeout changed from "
                                      << old_val << " to " << new_val;
             s_connect_timout = new_val; });
+            s_file_io_offload = g_file_io_offload->getValue();
+            g_file_io_offload->addListener([](const bool &old_val, const bool &new_val)
+                                           { s_file_io_offload = new_val; });
         }
     };
 
@@ -88,14 +101,124 @@ namespace dbspider
 
 }
 
-template <typename OriginFun, typename... Args>
-ssize_t do_io(int fd, dbspider::IOManager::Event event, const char *func_name, OriginFun fun, Args &&...args)
+// 是否可以把当前协程的IO提交给 io_uring
+// 共享栈协程挂起后栈会被其他协程覆盖，内核不能在完成时写入栈上的缓冲区，这种协程仍然走 epoll
+static bool can_use_io_uring(dbspider::IOManager *ioManager)
+{
+    return ioManager->isIoUring() && !dbspider::Fiber::GetThis()->isSharedStack();
+}
+
+// 把 io_uring 的结果转换为系统调用的返回值和 errno
+// 被取消的IO：协程的令牌已经取消时是 submitIo 响应令牌取消的，返回令牌的原因；
+// 否则如果设置了超时并且fd还没有关闭，就是被链接的超时请求取消的，再否则是 close 时取消的
+static ssize_t io_uring_result(int fd, int res, uint64_t timeout)
+{
+    if (res >= 0)
+    {
+        return res;
+    }
+    if (res == -ECANCELED)
+    {
+        dbspider::CancelToken::ptr token = dbspider::CancelToken::GetThis();
+        if (token && token->isCancelled())
+        {
+            res = -token->getError();
+        }
+        else
+        {
+            dbspider::FdCtx *ctx = dbspider::FdMgr::GetInstance()->get(fd);
+            res = (timeout != (uint64_t)-1 && ctx && !ctx->isClose()) ? -ETIMEDOUT : -EBADF;
+        }
+    }
+    errno = -res;
+    return -1;
+}
+
+// 填写读写类的 SQE
+static void prep_rw(io_uring_sqe &sqe, int op, int fd, const void *addr, uint32_t len, uint64_t offset)
+{
+    sqe.opcode = op;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(addr);
+    sqe.len = len;
+    sqe.off = offset;
+}
+
+// 当前协程的令牌已经取消时设置 errno 并返回 true，否则把超时时间收紧到令牌的截止时间
+static bool check_cancel(uint64_t &timeout)
+{
+    dbspider::CancelToken::ptr token = dbspider::CancelToken::GetThis();
+    if (!token)
+    {
+        return false;
+    }
+    if (token->isCancelled())
+    {
+        errno = token->getError();
+        return true;
+    }
+    timeout = std::min(timeout, token->getRemainingMS());
+    return false;
+}
+
+// 挂起当前协程 ns 纳秒，令牌取消时提前唤醒
+// 返回值：0 表示睡满; 否则为取消的原因，remain_ns 为剩余的时间
+static int sleep_ns(uint64_t ns, uint64_t *remain_ns = nullptr)
+{
+    dbspider::Fiber::ptr fiber = dbspider::Fiber::GetThis();
+    dbspider::IOManager *iom = dbspider::IOManager::GetThis();
+    DBSPIDER_ASSERT2(iom, "IOManager is not start");
+    uint64_t start = dbspider::GetCurrentUS();
+    // 定时器和取消回调只有先到的一个把协程加入调度，-1 表示还没有唤醒
+    std::shared_ptr<std::atomic<int>> woken(new std::atomic<int>{-1});
+    auto wake = [iom, fiber, woken](int err) mutable
+    {
+        int expect = -1;
+        if (woken->compare_exchange_strong(expect, err))
+        {
+            iom->submit(fiber, -1);
+        }
+    };
+    // 唤醒的定时器继承协程的优先级，高优先级协程醒来时不排在普通任务后面
+    dbspider::Timer::ptr timer = iom->addTimerNS(ns, [wake]() mutable
+                                                 { wake(0); });
+    timer->setPriority(fiber->getPriority());
+    dbspider::CancelToken::Listener listener(wake);
+    int expect = -1;
+    if (listener.cancelled() && woken->compare_exchange_strong(expect, errno))
+    {
+        // 定时器还没有唤醒协程，不需要挂起
+        timer->cancel();
+    }
+    else
+    {
+        dbspider::Fiber::YieldToHold();
+        timer->cancel();
+    }
+    int err = *woken;
+    if (err && remain_ns)
+    {
+        uint64_t elapsed = (dbspider::GetCurrentUS() - start) * 1000;
+        *remain_ns = elapsed < ns ? ns - elapsed : 0;
+    }
+    return err;
+}
+
+// fd 是否仍然是 generation 这一代打开的那个连接，FdCtx 在 fd 号复用时原地重新初始化，只比较指针分辨不出新旧连接
+static bool fd_unchanged(int fd, dbspider::FdCtx *ctx, uint64_t generation)
+{
+    return dbspider::FdMgr::GetInstance()->get(fd) == ctx && ctx->getGeneration() == generation;
+}
+
+// prep 用于在 io_uring 后端下填写对应的 SQE，为 nullptr 时该操作只走 epoll
+template <typename Prep, typename OriginFun, typename... Args>
+ssize_t do_io(int fd, dbspider::IOManager::Event event, const char *func_name, Prep prep, OriginFun fun, Args &&...args)
 {
     if (dbspider::t_hook_enable == false)
     {
         return fun(fd, std::forward<Args>(args)...);
     }
-    dbspider::FdCtx::ptr ctx = dbspider::FdMgr::GetInstance()->get(fd);
+    dbspider::FdCtx *ctx = dbspider::FdMgr::GetInstance()->get(fd);
     if (!ctx)
     {
         return fun(fd, std::forward<Args>(args)...);
@@ -105,6 +228,12 @@ ssize_t do_io(int fd, dbspider::IOManager::Event event, const char *func_name, O
         errno = EBADF;
         return -1;
     }
+    if (ctx->isFile() && dbspider::s_file_io_offload)
+    {
+        // 普通文件不支持 epoll ，读写时调度线程会阻塞在磁盘上，交给阻塞线程池执行，当前协程让出
+        return dbspider::BlockingPool::GetInstance()->run([&]
+                                                          { return fun(fd, args...); });
+    }
     if (!ctx->isSocket() || ctx->getUserNonblock())
     {
         return fun(fd, std::forward<Args>(args)...);
@@ -119,6 +248,11 @@ ssize_t do_io(int fd, dbspider::IOManager::Event event, const char *func_name, O
     {
         timeout = ctx->getSendTimeout();
     }
+    if (check_cancel(timeout))
+    {
+        return -1;
+    }
+    uint64_t generation = ctx->getGeneration();
 retry:
     ssize_t n = fun(fd, std::forward<Args>(args)...);
     while (n == -1 && errno == EINTR)
@@ -129,6 +263,22 @@ retry:
     {
         dbspider::IOManager *ioManager = dbspider::IOManager::GetThis();
         DBSPIDER_ASSERT2(ioManager, "IOManager is not start");
+        if constexpr (!std::is_null_pointer_v<Prep>)
+        {
+            // io_uring 后端直接把IO交给内核，完成后恢复协程，不再等 epoll 通知可读写后重试
+            // 内核仍然返回 EAGAIN 时(比如设置了 MSG_DONTWAIT)退回 epoll 等待
+            if (can_use_io_uring(ioManager))
+            {
+                io_uring_sqe sqe;
+                memset(&sqe, 0, sizeof(sqe));
+                prep(sqe);
+                int res = ioManager->submitIo(sqe, timeout);
+                if (res != -EAGAIN)
+                {
+                    return io_uring_result(fd, res, timeout);
+                }
+            }
+        }
         dbspider::Timer::ptr timer;
         std::weak_ptr<int> weakPtr(timeCondition);
         if (timeout != (uint64_t)-1)
@@ -144,7 +294,8 @@ retry:
                 ioManager->cancelEvent(fd,event); },
                 weakPtr);
         }
-        int rt = ioManager->addEvent(fd, event);
+        bool ready = false;
+        int rt = ioManager->addEvent(fd, event, nullptr, &ready);
         if (!rt)
         {
             DBSPIDER_LOG_ERROR(g_logger) << func_name << " addEvent(" << fd << ", " << event << ")";
@@ -154,6 +305,35 @@ retry:
             }
             return -1;
         }
+        if (ready)
+        {
+            // 常驻注册的fd在没有等待者时已经就绪，没有注册事件，直接重试
+            if (timer)
+            {
+                timer->cancel();
+            }
+            goto retry;
+        }
+        // close 先从 FdManager 中删除再取消事件，这里在注册之后检查，
+        // 避免 fd 在 cancelAllEvent 之后、真正关闭之前注册的事件永远得不到触发
+        if (!fd_unchanged(fd, ctx, generation))
+        {
+            ioManager->cancelEvent(fd, event);
+        }
+        // 令牌取消时与超时一样取消事件，唤醒协程
+        dbspider::CancelToken::Listener listener([weakPtr, ioManager, fd, event](int err)
+                                                 {
+                auto t = weakPtr.lock();
+                if(!t || *t){
+                    return ;
+                }
+                *t = err;
+                ioManager->cancelEvent(fd,event); });
+        if (listener.cancelled())
+        {
+            *timeCondition = errno;
+            ioManager->cancelEvent(fd, event);
+        }
         dbspider::Fiber::YieldToHold();
         if (timer)
         {
@@ -164,6 +344,11 @@ retry:
             errno = *timeCondition;
             return -1;
         }
+        if (!fd_unchanged(fd, ctx, generation))
+        {
+            errno = EBADF;
+            return -1;
+        }
         goto retry;
     }
     return n;
@@ -180,26 +365,28 @@ extern "C"
         {
             return sleep_f(seconds);
         }
-        dbspider::Fiber::ptr fiber = dbspider::Fiber::GetThis();
-        dbspider::IOManager *iom = dbspider::IOManager::GetThis();
-        DBSPIDER_ASSERT2(iom, "IOManager is not start");
-        iom->addTimer(seconds * 1000, [iom, fiber]() mutable
-                      { iom->submit(fiber, -1); });
-        dbspider::Fiber::YieldToHold();
+        uint64_t remain = 0;
+        int err = sleep_ns(seconds * 1000ull * 1000 * 1000, &remain);
+        if (err)
+        {
+            // 被取消时与被信号打断一样返回没有睡完的秒数
+            errno = err;
+            return (remain + 999999999) / 1000000000;
+        }
         return 0;
     }
     int usleep(useconds_t useconds)
     {
         if (!dbspider::t_hook_enable)
         {
-            return sleep_f(useconds);
+            return usleep_f(useconds);
+        }
+        int err = sleep_ns(useconds * 1000ull);
+        if (err)
+        {
+            errno = err;
+            return -1;
         }
-        dbspider::Fiber::ptr fiber = dbspider::Fiber::GetThis();
-        dbspider::IOManager *iom = dbspider::IOManager::GetThis();
-        DBSPIDER_ASSERT2(iom, "IOManager is not start");
-        iom->addTimer(useconds / 1000, [iom, fiber]() mutable
-                      { iom->submit(fiber, -1); });
-        dbspider::Fiber::YieldToHold();
         return 0;
     }
 
@@ -210,13 +397,19 @@ extern "C"
             return nanosleep_f(req, rem);
         }
 
-        int timeout_ms = req->tv_sec * 1000 + req->tv_nsec / 1000 / 1000;
-        dbspider::Fiber::ptr fiber = dbspider::Fiber::GetThis();
-        dbspider::IOManager *iom = dbspider::IOManager::GetThis();
-        DBSPIDER_ASSERT2(iom, "IOManager is not start");
-        iom->addTimer(timeout_ms, [iom, fiber]() mutable
-                      { iom->submit(fiber, -1); });
-        dbspider::Fiber::YieldToHold();
+        uint64_t timeout_ns = req->tv_sec * 1000ull * 1000 * 1000 + req->tv_nsec;
+        uint64_t remain = 0;
+        int err = sleep_ns(timeout_ns, &remain);
+        if (err)
+        {
+            errno = err;
+            if (rem)
+            {
+                rem->tv_sec = remain / 1000000000;
+                rem->tv_nsec = remain % 1000000000;
+            }
+            return -1;
+        }
         return 0;
     }
 
@@ -232,7 +425,7 @@ extern "C"
         {
             return fd;
         }
-        dbspider::FdMgr::GetInstance()->get(fd, true);
+        dbspider::FdMgr::GetInstance()->open(fd);
         return fd;
     }
 
@@ -243,10 +436,51 @@ extern "C"
 
     int accept(int s, struct sockaddr *addr, socklen_t *addrlen)
     {
-        int fd = do_io(s, dbspider::IOManager::READ, "accept", accept_f, addr, addrlen);
+        int fd = do_io(
+            s, dbspider::IOManager::READ, "accept", [=](io_uring_sqe &sqe)
+            {
+            prep_rw(sqe, IORING_OP_ACCEPT, s, addr, 0, reinterpret_cast<uint64_t>(addrlen)); },
+            accept_f, addr, addrlen);
+        if (fd >= 0 && dbspider::t_hook_enable)
+        {
+            dbspider::FdMgr::GetInstance()->open(fd);
+        }
+        return fd;
+    }
+
+    // 调度线程上打开的文件登记到 FdManager ，之后的读写由 do_io 交给阻塞线程池
+    int open(const char *pathname, int flags, ...)
+    {
+        mode_t mode = 0;
+        if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE)
+        {
+            va_list va;
+            va_start(va, flags);
+            mode = va_arg(va, mode_t);
+            va_end(va);
+        }
+        int fd = open_f(pathname, flags, mode);
+        if (fd >= 0 && dbspider::t_hook_enable)
+        {
+            dbspider::FdMgr::GetInstance()->open(fd);
+        }
+        return fd;
+    }
+
+    int openat(int dirfd, const char *pathname, int flags, ...)
+    {
+        mode_t mode = 0;
+        if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE)
+        {
+            va_list va;
+            va_start(va, flags);
+            mode = va_arg(va, mode_t);
+            va_end(va);
+        }
+        int fd = openat_f(dirfd, pathname, flags, mode);
         if (fd >= 0 && dbspider::t_hook_enable)
         {
-            dbspider::FdMgr::GetInstance()->get(fd, true);
+            dbspider::FdMgr::GetInstance()->open(fd);
         }
         return fd;
     }
@@ -257,15 +491,16 @@ extern "C"
         {
             return close_f(fd);
         }
-        dbspider::FdCtx::ptr fdCtx = dbspider::FdMgr::GetInstance()->get(fd);
+        dbspider::FdCtx *fdCtx = dbspider::FdMgr::GetInstance()->get(fd);
         if (fdCtx)
         {
+            dbspider::FdMgr::GetInstance()->del(fd);
             dbspider::IOManager *ioManager = dbspider::IOManager::GetThis();
             if (ioManager)
             {
                 ioManager->cancelAllEvent(fd);
+                ioManager->cancelIo(fd);
             }
-            dbspider::FdMgr::GetInstance()->del(fd);
         }
         return close_f(fd);
     }
@@ -273,53 +508,85 @@ extern "C"
     // read
     ssize_t read(int fd, void *buf, size_t count)
     {
-        return do_io(fd, dbspider::IOManager::READ, "read", read_f, buf, count);
+        return do_io(
+            fd, dbspider::IOManager::READ, "read", [=](io_uring_sqe &sqe)
+            { prep_rw(sqe, IORING_OP_READ, fd, buf, count, (uint64_t)-1); },
+            read_f, buf, count);
     }
 
     ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
     {
-        return do_io(fd, dbspider::IOManager::READ, "readv", readv_f, iov, iovcnt);
+        return do_io(
+            fd, dbspider::IOManager::READ, "readv", [=](io_uring_sqe &sqe)
+            { prep_rw(sqe, IORING_OP_READV, fd, iov, iovcnt, (uint64_t)-1); },
+            readv_f, iov, iovcnt);
     }
 
     ssize_t recv(int sockfd, void *buf, size_t len, int flags)
     {
-        return do_io(sockfd, dbspider::IOManager::READ, "recv", recv_f, buf, len, flags);
+        return do_io(
+            sockfd, dbspider::IOManager::READ, "recv", [=](io_uring_sqe &sqe)
+            {
+            prep_rw(sqe, IORING_OP_RECV, sockfd, buf, len, 0);
+            sqe.msg_flags = flags; },
+            recv_f, buf, len, flags);
     }
 
     ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen)
     {
-        return do_io(sockfd, dbspider::IOManager::READ, "recvfrom", recvfrom_f, buf, len, flags, src_addr, addrlen);
+        return do_io(sockfd, dbspider::IOManager::READ, "recvfrom", nullptr, recvfrom_f, buf, len, flags, src_addr, addrlen);
     }
 
     ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags)
     {
-        return do_io(sockfd, dbspider::IOManager::READ, "recvmsg", recvmsg_f, msg, flags);
+        return do_io(
+            sockfd, dbspider::IOManager::READ, "recvmsg", [=](io_uring_sqe &sqe)
+            {
+            prep_rw(sqe, IORING_OP_RECVMSG, sockfd, msg, 1, 0);
+            sqe.msg_flags = flags; },
+            recvmsg_f, msg, flags);
     }
 
     // write
     ssize_t write(int fd, const void *buf, size_t count)
     {
-        return do_io(fd, dbspider::IOManager::WRITE, "write", write_f, buf, count);
+        return do_io(
+            fd, dbspider::IOManager::WRITE, "write", [=](io_uring_sqe &sqe)
+            { prep_rw(sqe, IORING_OP_WRITE, fd, buf, count, (uint64_t)-1); },
+            write_f, buf, count);
     }
 
     ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
     {
-        return do_io(fd, dbspider::IOManager::WRITE, "writev", writev_f, iov, iovcnt);
+        return do_io(
+            fd, dbspider::IOManager::WRITE, "writev", [=](io_uring_sqe &sqe)
+            { prep_rw(sqe, IORING_OP_WRITEV, fd, iov, iovcnt, (uint64_t)-1); },
+            writev_f, iov, iovcnt);
     }
 
     ssize_t send(int s, const void *msg, size_t len, int flags)
     {
-        return do_io(s, dbspider::IOManager::WRITE, "send", send_f, msg, len, flags);
+        return do_io(
+            s, dbspider::IOManager::WRITE, "send", [=](io_uring_sqe &sqe)
+            {
+            prep_rw(sqe, IORING_OP_SEND, s, msg, len, 0);
+            sqe.msg_flags = flags; },
+            send_f, msg, len, flags);
     }
 
     ssize_t sendto(int s, const void *msg, size_t len, int flags, const struct sockaddr *to, socklen_t tolen)
     {
-        return do_io(s, dbspider::IOManager::WRITE, "send", sendto_f, msg, len, flags, to, tolen);
+        return do_io(s, dbspider::IOManager::WRITE, "send", nullptr, sendto_f, msg, len, flags, to, tolen);
     }
 
     ssize_t sendmsg(int s, const struct msghdr *msg, int flags)
     {
-        return do_io(s, dbspider::IOManager::WRITE, "sendmsg", sendmsg_f, msg, flags);
+        return do_io(
+            s, dbspider::IOManager::WRITE, "sendmsg", [=](io_uring_sqe &sqe)
+            {
+            prep_rw(sqe, IORING_OP_SENDMSG, s, msg, 1, 0);
+            sqe.msg_flags = flags; },
+            sendmsg_f, msg, flags);
     }
 
     int fcntl(int fd, int cmd, ...)
@@ -332,7 +599,7 @@ extern "C"
         {
             int arg = va_arg(va, int);
             va_end(va);
-            dbspider::FdCtx::ptr ctx = dbspider::FdMgr::GetInstance()->get(fd);
+            dbspider::FdCtx *ctx = dbspider::FdMgr::GetInstance()->get(fd);
             if (!ctx || ctx->isClose() || !ctx->isSocket())
             {
                 return fcntl_f(fd, cmd, arg);
@@ -353,7 +620,7 @@ extern "C"
         {
             va_end(va);
             int arg = fcntl_f(fd, cmd);
-            dbspider::FdCtx::ptr ctx = dbspider::FdMgr::GetInstance()->get(fd);
+            dbspider::FdCtx *ctx = dbspider::FdMgr::GetInstance()->get(fd);
             if (!ctx || ctx->isClose() || !ctx->isSocket())
             {
                 return arg;
@@ -423,7 +690,7 @@ extern "C"
         if (request == FIONBIO)
         {
             bool user_nonblock = !!*(int *)arg;
-            dbspider::FdCtx::ptr ctx = dbspider::FdMgr::GetInstance()->get(d);
+            dbspider::FdCtx *ctx = dbspider::FdMgr::GetInstance()->get(d);
             if (!ctx || ctx->isClose() || !ctx->isSocket())
             {
                 return ioctl_f(d, request, arg);
@@ -448,7 +715,7 @@ extern "C"
         {
             if (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO)
             {
-                dbspider::FdCtx::ptr ctx = dbspider::FdMgr::GetInstance()->get(sockfd);
+                dbspider::FdCtx *ctx = dbspider::FdMgr::GetInstance()->get(sockfd);
                 if (ctx)
                 {
                     const timeval *v = (const timeval *)optval;
@@ -465,7 +732,7 @@ extern "C"
         {
             return connect_f(fd, addr, addrlen);
         }
-        dbspider::FdCtx::ptr ctx = dbspider::FdMgr::GetInstance()->get(fd);
+        dbspider::FdCtx *ctx = dbspider::FdMgr::GetInstance()->get(fd);
         if (!ctx || ctx->isClose())
         {
             errno = EBADF;
@@ -482,6 +749,22 @@ extern "C"
             return connect_f(fd, addr, addrlen);
         }
 
+        if (check_cancel(timeout_ms))
+        {
+            return -1;
+        }
+
+        dbspider::IOManager *iom = dbspider::IOManager::GetThis();
+        if (can_use_io_uring(iom))
+        {
+            // 连接发起之后不能再次 connect，io_uring 后端直接提交连接请求，由内核等待连接完成
+            io_uring_sqe sqe;
+            memset(&sqe, 0, sizeof(sqe));
+            prep_rw(sqe, IORING_OP_CONNECT, fd, addr, 0, addrlen);
+            int res = iom->submitIo(sqe, timeout_ms);
+            return io_uring_result(fd, res, timeout_ms);
+        }
+
         int n = connect_f(fd, addr, addrlen);
         if (n == 0)
         {
@@ -492,7 +775,6 @@ extern "C"
             return n;
         }
 
-        dbspider::IOManager *iom = dbspider::IOManager::GetThis();
         dbspider::Timer::ptr timer;
         std::shared_ptr<int> timeCondition(new int{0});
         std::weak_ptr<int> weakPtr(timeCondition);
@@ -511,9 +793,31 @@ extern "C"
                 weakPtr);
         }
 
-        int rt = iom->addEvent(fd, dbspider::IOManager::WRITE);
-        if (rt)
+        bool ready = false;
+        int rt = iom->addEvent(fd, dbspider::IOManager::WRITE, nullptr, &ready);
+        if (rt && ready)
         {
+            // 已经可写，连接已经有结果，不需要等待
+            if (timer)
+            {
+                timer->cancel();
+            }
+        }
+        else if (rt)
+        {
+            dbspider::CancelToken::Listener listener([weakPtr, fd, iom](int err)
+                                                     {
+            auto t = weakPtr.lock();
+            if(!t || *t) {
+                return;
+            }
+            *t = err;
+            iom->cancelEvent(fd, dbspider::IOManager::WRITE); });
+            if (listener.cancelled())
+            {
+                *timeCondition = errno;
+                iom->cancelEvent(fd, dbspider::IOManager::WRITE);
+            }
             dbspider::Fiber::YieldToHold();
             if (timer)
             {
@@ -550,4 +854,4 @@ extern "C"
             return -1;
         }
     }
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "io_awaitable.h"
+#include "fd_manager.h"
+#include "hook.h"
+
+namespace dbspider
+{
+    static Logger::ptr g_logger = DBSPIDER_LOG_NAME("system");
+
+    bool EventAwaiter::await_suspend(std::coroutine_handle<> handle)
+    {
+        IOManager *ioManager = IOManager::GetThis();
+        DBSPIDER_ASSERT2(ioManager, "IOManager is not start");
+        if (m_timeout != (uint64_t)-1)
+        {
+            m_timeoutError.reset(new int{0});
+            std::weak_ptr<int> weakPtr(m_timeoutError);
+            int fd = m_fd;
+            IOManager::Event event = m_event;
+            m_timer = ioManager->addConditionTimer(
+                m_timeout, [weakPtr, ioManager, fd, event]
+                {
+                    auto t = weakPtr.lock();
+                    if (!t || *t)
+                    {
+                        return;
+                    }
+                    *t = ETIMEDOUT;
+                    ioManager->cancelEvent(fd, event); },
+                weakPtr);
+        }
+        // 注册成功后协程随时可能在别的线程被恢复，之后不能再访问成员
+        Timer::ptr timer = m_timer;
+        if (!ioManager->addEvent(m_fd, m_event, [handle]
+                                 { handle.resume(); }))
+        {
+            DBSPIDER_LOG_ERROR(g_logger) << "EventAwaiter addEvent(" << m_fd << ", " << m_event << ")";
+            if (timer)
+            {
+                timer->cancel();
+            }
+            m_error = errno ? errno : EBADF;
+            return false;
+        }
+        return true;
+    }
+
+    int EventAwaiter::await_resume()
+    {
+        if (m_error)
+        {
+            return m_error;
+        }
+        if (m_timer)
+        {
+            m_timer->cancel();
+        }
+        if (m_timeoutError && *m_timeoutError)
+        {
+            return *m_timeoutError;
+        }
+        return 0;
+    }
+
+    // 与 hook 的 do_io 相同的流程：先直接调用原始的系统调用，EAGAIN 时挂起等待事件再重试
+    template <typename OriginFun, typename... Args>
+    static Task<ssize_t> async_io(int fd, IOManager::Event event, OriginFun fun, Args... args)
+    {
+        FdCtx *ctx = FdMgr::GetInstance()->get(fd);
+        if (ctx && ctx->isClose())
+        {
+            errno = EBADF;
+            co_return -1;
+        }
+        uint64_t timeout = (uint64_t)-1;
+        if (ctx)
+        {
+            timeout = event == IOManager::READ ? ctx->getRecvTimeout() : ctx->getSendTimeout();
+        }
+        while (true)
+        {
+            ssize_t n = fun(fd, args...);
+            while (n == -1 && errno == EINTR)
+            {
+                n = fun(fd, args...);
+            }
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                int error = co_await EventAwaiter(fd, event, timeout);
+                if (error)
+                {
+                    errno = error;
+                    co_return -1;
+                }
+                continue;
+            }
+            co_return n;
+        }
+    }
+
+    Task<ssize_t> AsyncRead(int fd, void *buf, size_t count)
+    {
+        return async_io(fd, IOManager::READ, read_f, buf, count);
+    }
+
+    Task<ssize_t> AsyncWrite(int fd, const void *buf, size_t count)
+    {
+        return async_io(fd, IOManager::WRITE, write_f, buf, count);
+    }
+
+    // socket 使用 MSG_DONTWAIT，即使 fd 不是系统非阻塞的也不会阻塞线程
+    Task<ssize_t> AsyncRecv(int fd, void *buf, size_t len, int flags)
+    {
+        return async_io(fd, IOManager::READ, recv_f, buf, len, flags | MSG_DONTWAIT);
+    }
+
+    Task<ssize_t> AsyncSend(int fd, const void *buf, size_t len, int flags)
+    {
+        return async_io(fd, IOManager::WRITE, send_f, buf, len, flags | MSG_DONTWAIT);
+    }
+}
@@ -1,14 +1,23 @@
 #include "io_manager.h"
 
+#include <algorithm>
 #include <error.h>
 #include <fcntl.h>
 #include <string.h>
+#include <sched.h>
 #include <signal.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
 #include <unistd.h>
 
+#include "cancel.h"
 #include "config.h"
+#include "fd_manager.h"
+#include "hook.h"
 #include "io_manager.h"
+#include "io_uring.h"
 #include "log.h"
 #include "macro.h"
 
@@ -23,8 +32,34 @@ namespace dbspider
         Config::Lookup<std::string>("scheduler.name", "main",
                                     "scheduler default name");
 
+    static ConfigVar<bool>::ptr g_epoll_persistent =
+        Config::Lookup<bool>("iomanager.epoll_persistent", false,
+                             "iomanager register sockets in epoll once for their whole life");
+    static ConfigVar<uint64_t>::ptr g_idle_spin_us =
+        Config::Lookup<uint64_t>("scheduler.idle_spin_us", 0,
+                                 "scheduler idle threads spin this many microseconds before sleeping in epoll_wait");
+    static ConfigVar<uint64_t>::ptr g_busy_timer_interval_us =
+        Config::Lookup<uint64_t>("iomanager.busy_timer_interval_us", 1000,
+                                 "iomanager busy threads check expired timers at this interval, 0 means only when idle");
+    static ConfigVar<bool>::ptr g_multi_reactor =
+        Config::Lookup<bool>("iomanager.multi_reactor", false,
+                             "iomanager use one epoll per scheduler thread");
+    static ConfigVar<int>::ptr g_wakeup_signal =
+        Config::Lookup<int>("iomanager.wakeup_signal", 0,
+                            "iomanager realtime signal that wakes one specific thread when threads share one epoll, 0 means SIGRTMIN");
+    static ConfigVar<std::string>::ptr g_io_backend =
+        Config::Lookup<std::string>("iomanager.io_backend", "epoll",
+                                    "iomanager io backend, epoll or io_uring");
+    static ConfigVar<uint32_t>::ptr g_io_uring_entries =
+        Config::Lookup<uint32_t>("iomanager.io_uring_entries", 1024,
+                                 "iomanager io_uring queue entries");
+    static ConfigVar<uint32_t>::ptr g_io_uring_batch =
+        Config::Lookup<uint32_t>("iomanager.io_uring_batch", 32,
+                                 "iomanager io_uring submit batch size");
+
     static uint64_t s_scheduler_threads = 0;
     static std::string s_scheduler_name;
+    static std::atomic<IOManager *> s_default_scheduler{nullptr};
 
     struct _IOManagerIniter
     {
@@ -39,6 +74,12 @@ namespace dbspider
                     DBSPIDER_LOG_INFO(g_logger) << "scheduler threads from "
                                                 << old_val << " to " << new_val;
                     s_scheduler_threads = new_val;
+                    // 默认调度器已经在运行时直接调整它的线程数
+                    IOManager *iom = s_default_scheduler.load();
+                    if (iom)
+                    {
+                        iom->setThreadCount(new_val);
+                    }
                 });
 
             g_scheduler_name->addListener(
@@ -74,6 +115,7 @@ namespace dbspider
         event.scheduler = nullptr;
         event.fiber.reset();
         event.cb = nullptr;
+        event.thread = -1;
     }
 
     // 触发事件
@@ -93,41 +135,191 @@ namespace dbspider
         EventContext &eventContext = getContext(event);
         if (eventContext.cb)
         {
-            eventContext.scheduler->submit(std::move(eventContext.cb));
+            eventContext.scheduler->submit(std::move(eventContext.cb), eventContext.thread);
         }
         else
         {
-            eventContext.scheduler->submit(std::move(eventContext.fiber));
+            eventContext.scheduler->submit(std::move(eventContext.fiber), eventContext.thread);
         }
         eventContext.scheduler = nullptr;
+        eventContext.thread = -1;
+    }
+
+    // 通过 io_uring 提交的一次IO请求
+    // 共享栈协程挂起时栈上的数据会被换出，内核和收割线程要访问的数据放在堆上
+    struct IOManager::IoRequest
+    {
+        Fiber::ptr fiber;          // 等待IO完成的协程
+        int result = 0;            // CQE 的结果
+        __kernel_timespec timeout; // 链接超时的时间，内核在提交时读取
+    };
+
+    // 所有线程共享一个epoll时，定向唤醒调度线程的实时信号，进程内只安装一次
+    static struct sigaction s_old_wakeup_action;
+    // IOManager 发出的唤醒信号带上这个值，其他来源的同一信号交给原来的处理函数
+    static const int WAKEUP_SIGNAL_VALUE = 0x64627370;
+
+    static void OnWakeupSignal(int sig, siginfo_t *info, void *context)
+    {
+        if (info && info->si_code == SI_QUEUE && info->si_pid == getpid() &&
+            info->si_value.sival_int == WAKEUP_SIGNAL_VALUE)
+        {
+            // 只是为了让 epoll_pwait 返回 EINTR
+            return;
+        }
+        if (s_old_wakeup_action.sa_flags & SA_SIGINFO)
+        {
+            if (s_old_wakeup_action.sa_sigaction)
+            {
+                s_old_wakeup_action.sa_sigaction(sig, info, context);
+            }
+        }
+        else if (s_old_wakeup_action.sa_handler != SIG_DFL && s_old_wakeup_action.sa_handler != SIG_IGN)
+        {
+            s_old_wakeup_action.sa_handler(sig);
+        }
+    }
+
+    // 安装唤醒信号的处理函数并返回信号值，配置的不是实时信号时使用 SIGRTMIN
+    static int InitWakeupSignal()
+    {
+        static int s_signal = []
+        {
+            int sig = g_wakeup_signal->getValue();
+            if (sig == 0)
+            {
+                sig = SIGRTMIN;
+            }
+            else if (sig < SIGRTMIN || sig > SIGRTMAX)
+            {
+                DBSPIDER_LOG_WARN(g_logger) << "iomanager.wakeup_signal=" << sig
+                                            << " is not a realtime signal, use SIGRTMIN";
+                sig = SIGRTMIN;
+            }
+            struct sigaction sa;
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_sigaction = OnWakeupSignal;
+            sa.sa_flags = SA_SIGINFO;
+            sigemptyset(&sa.sa_mask);
+            int rt = sigaction(sig, &sa, &s_old_wakeup_action);
+            DBSPIDER_ASSERT(rt == 0);
+            return sig;
+        }();
+        return s_signal;
     }
 
     IOManager::IOManager(size_t threads, const std::string &name)
-        : Scheduler(threads, name)
+        : Scheduler(threads, name),
+          TimeManager(threads),
+          m_sleeping(getMaxThreads()),
+          m_persistent(g_epoll_persistent->getValue()),
+          m_ownedFds(getMaxThreads()),
+          m_idleSpinUs(g_idle_spin_us->getValue()),
+          m_busyTimerUs(g_busy_timer_interval_us->getValue())
     {
-        // 创建pipe，获取m_tickleFds[2]，其中m_tickleFds[0]是管道的读端，m_tickleFds[1]是管道的写端
-        int rt = pipe(m_tickleFds);
-        DBSPIDER_ASSERT(!rt);
+        // 创建eventfd，写入计数即可唤醒epoll_wait，只需一个fd，内核开销比pipe小
+        m_tickleFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        DBSPIDER_ASSERT(m_tickleFd >= 0);
 
         // 创建epoll实例
         m_epfd = epoll_create(1);
         DBSPIDER_ASSERT(m_epfd > 0);
 
-        // 注册pipe读句柄的可读事件，用于tickle调度协程，通过epoll_event.data.fd保存描述符
+        // 注册eventfd的可读事件，用于tickle调度协程，通过epoll_event.data.fd保存描述符
+        // 边缘触发，每次写入只唤醒一个等待的线程
         epoll_event event;
         memset(&event, 0, sizeof(epoll_event));
         event.events = EPOLLIN | EPOLLET;
-        event.data.fd = m_tickleFds[0];
+        event.data.fd = m_tickleFd;
 
-        // 非阻塞方式，配合边缘触发
-        rt = fcntl(m_tickleFds[0], F_SETFL, O_NONBLOCK);
+        // 将eventfd加入epoll多路复用，如果eventfd可读，idle中的epoll_wait会返回
+        int rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_tickleFd, &event);
         DBSPIDER_ASSERT(!rt);
 
-        // 将管道的读描述符加入epoll多路复用，如果管道可读，idle中的epoll_wait会返回
-        rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_tickleFds[0], &event);
+        // epoll_wait 的超时只能精确到毫秒，定时器到期改由 timerfd 唤醒，可以精确到微秒
+        m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        DBSPIDER_ASSERT(m_timerFd >= 0);
+        event.events = EPOLLIN | EPOLLET;
+        event.data.fd = m_timerFd;
+        rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_timerFd, &event);
         DBSPIDER_ASSERT(!rt);
 
-        contextResize(64);
+        if (g_io_backend->getValue() == "io_uring")
+        {
+            // 内核不支持 io_uring 或者缺少需要的操作时退回 epoll
+            std::unique_ptr<IoUring> uring(new IoUring(g_io_uring_entries->getValue()));
+            if (uring->isValid() &&
+                uring->probe({IORING_OP_RECV, IORING_OP_SEND, IORING_OP_READ, IORING_OP_WRITE,
+                              IORING_OP_READV, IORING_OP_WRITEV, IORING_OP_RECVMSG, IORING_OP_SENDMSG,
+                              IORING_OP_ACCEPT, IORING_OP_CONNECT, IORING_OP_LINK_TIMEOUT,
+                              IORING_OP_ASYNC_CANCEL}))
+            {
+                // 有IO完成时内核写 eventfd，空闲线程从 epoll_wait 返回后收割完成队列
+                m_uringEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                DBSPIDER_ASSERT(m_uringEventFd >= 0);
+                if (uring->registerEventFd(m_uringEventFd))
+                {
+                    event.events = EPOLLIN | EPOLLET;
+                    event.data.fd = m_uringEventFd;
+                    rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_uringEventFd, &event);
+                    DBSPIDER_ASSERT(!rt);
+                    m_uring = std::move(uring);
+                    m_uringBatch = std::max<uint32_t>(g_io_uring_batch->getValue(), 1);
+                }
+                else
+                {
+                    close(m_uringEventFd);
+                    m_uringEventFd = -1;
+                }
+            }
+            if (!m_uring)
+            {
+                DBSPIDER_LOG_WARN(g_logger) << "name=" << getName()
+                                            << " io_uring unavailable, fallback to epoll";
+            }
+        }
+
+        if (g_multi_reactor->getValue())
+        {
+            // 每个调度线程一个epoll，fd只注册在所属线程的epoll上
+            // 唤醒用的 eventfd/timerfd 注册到所有epoll，EPOLLEXCLUSIVE 保证每次只唤醒一个睡眠的线程
+            // 按线程池容量创建，弹性增加的线程也有自己的epoll
+            m_epfds.resize(getMaxThreads());
+            for (size_t i = 0; i < m_epfds.size(); ++i)
+            {
+                m_epfds[i] = epoll_create1(EPOLL_CLOEXEC);
+                DBSPIDER_ASSERT(m_epfds[i] >= 0);
+                for (int fd : {m_tickleFd, m_timerFd, m_uringEventFd})
+                {
+                    if (fd < 0)
+                    {
+                        continue;
+                    }
+                    event.events = EPOLLIN | EPOLLET | EPOLLEXCLUSIVE;
+                    event.data.fd = fd;
+                    rt = epoll_ctl(m_epfds[i], EPOLL_CTL_ADD, fd, &event);
+                    DBSPIDER_ASSERT(!rt);
+                }
+            }
+            // 每个线程还有自己的 eventfd ，只注册在自己的epoll上，定向唤醒时写它，不需要信号
+            m_wakeFds.resize(getMaxThreads());
+            for (size_t i = 0; i < m_wakeFds.size(); ++i)
+            {
+                m_wakeFds[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                DBSPIDER_ASSERT(m_wakeFds[i] >= 0);
+                event.events = EPOLLIN | EPOLLET;
+                event.data.fd = m_wakeFds[i];
+                rt = epoll_ctl(m_epfds[i], EPOLL_CTL_ADD, m_wakeFds[i], &event);
+                DBSPIDER_ASSERT(!rt);
+            }
+        }
+        else
+        {
+            // 共享的epoll上无法只唤醒某一个线程，退而使用实时信号
+            m_wakeupSignal = InitWakeupSignal();
+        }
+
+        getFdContext(0, true);
 
         // 这里直接开启了Schedluer，也就是说IOManager创建即可调度协程
         start();
@@ -143,37 +335,33 @@ namespace dbspider
         }
         stop();
         close(m_epfd);
-        close(m_tickleFds[0]);
-        close(m_tickleFds[1]);
-
-        for (size_t i = 0; i < m_fdContexts.size(); ++i)
+        for (int epfd : m_epfds)
         {
-            if (m_fdContexts[i])
-            {
-                delete m_fdContexts[i];
-            }
+            close(epfd);
+        }
+        for (int fd : m_wakeFds)
+        {
+            close(fd);
+        }
+        close(m_tickleFd);
+        close(m_timerFd);
+        if (m_uring)
+        {
+            m_uring.reset();
+            close(m_uringEventFd);
         }
     }
 
     // 添加事件
-    bool IOManager::addEvent(int fd, Event event, std::function<void()> cb)
+    bool IOManager::addEvent(int fd, Event event, std::function<void()> cb, bool *ready)
     {
         DBSPIDER_LOG_DEBUG(g_logger) << "addEvent() : fd=" << fd << " event=" << (event == 1 ? "read" : "write");
 
         // 找到fd对应的FdContext，如果不存在，那就分配一个
-        FdContext *fdContext = nullptr;
-        RWMutexType::ReadLock lock(m_mutex);
-        if ((int)m_fdContexts.size() > fd)
+        FdContext *fdContext = getFdContext(fd, true);
+        if (!fdContext)
         {
-            fdContext = m_fdContexts[fd];
-            lock.unlock();
-        }
-        else
-        {
-            lock.unlock();
-            RWMutexType::WriteLock lock1(m_mutex);
-            contextResize(fd * 1.5);
-            fdContext = m_fdContexts[fd];
+            return false;
         }
         // 同一个fd不允许重复添加相同的事件
         FdContext::MutexType::Lock lock2(fdContext->mutex);
@@ -184,19 +372,81 @@ namespace dbspider
             DBSPIDER_ASSERT(!(fdContext->events & event));
         }
 
+        // 多 reactor 模式下还没有分配线程的fd归属于第一次等待它的调度线程
+        if (isMultiReactor() && fdContext->owner < 0)
+        {
+            int index = getCurrentIndex();
+            fdContext->owner = index >= 0 ? index : fd % getThreadCount();
+            ++m_ownedFds[fdContext->owner];
+            wakeOwner(fdContext->owner);
+        }
+
+        // 常驻注册模式下，socket第一次等待事件时同时注册读写两个方向，直到关闭之前都不再修改epoll
+        if (m_persistent)
+        {
+            FdCtx *ctx = FdMgr::GetInstance()->get(fd);
+            // fd 不一定经过 cancelAllEvent 才关闭(比如在未hook的线程或其他IOManager上关闭)，内核随 close 删除了注册，
+            // fd 号复用后代数不同，丢掉旧连接的常驻状态和就绪事件，重新注册
+            if (fdContext->persistent && (!ctx || ctx->getGeneration() != fdContext->generation))
+            {
+                fdContext->persistent = false;
+                fdContext->ready = NONE;
+            }
+            if (!fdContext->persistent && ctx && ctx->isSocket())
+            {
+                epoll_event epevent;
+                memset(&epevent, 0, sizeof(epoll_event));
+                epevent.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
+                epevent.data.ptr = fdContext;
+                int op = EPOLL_CTL_ADD;
+                int rt = epollCtl(fdContext, op, &epevent);
+                if (rt && errno == EEXIST)
+                {
+                    // 已经按普通方式注册了事件，改为常驻注册
+                    op = EPOLL_CTL_MOD;
+                    rt = epollCtl(fdContext, op, &epevent);
+                }
+                if (rt)
+                {
+                    DBSPIDER_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
+                                                 << epevent.events << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
+                    return false;
+                }
+                fdContext->persistent = true;
+                fdContext->ready = NONE;
+                fdContext->generation = ctx->getGeneration();
+            }
+        }
+
+        // 常驻注册时事件可能在没有等待者的时候已经就绪过，边缘触发不会再次通知；
+        // 调用方能重试时直接告诉它，不注册等待者
+        if (ready)
+        {
+            *ready = false;
+            if (fdContext->ready & event)
+            {
+                fdContext->ready &= ~event;
+                *ready = true;
+                return true;
+            }
+        }
+
         // 将新的事件加入epoll_wait，使用epoll_event的私有指针存储FdContext的位置
-        int op = fdContext->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
         Event newEvent = (Event)(event | fdContext->events);
-        epoll_event epevent;
-        memset(&epevent, 0, sizeof(epoll_event));
-        epevent.events = EPOLLET | newEvent;
-        epevent.data.ptr = fdContext;
-        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
-        if (rt)
+        if (!fdContext->persistent)
         {
-            DBSPIDER_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
-                                         << epevent.events << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
-            return false;
+            int op = fdContext->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+            epoll_event epevent;
+            memset(&epevent, 0, sizeof(epoll_event));
+            epevent.events = EPOLLET | newEvent;
+            epevent.data.ptr = fdContext;
+            int rt = epollCtl(fdContext, op, &epevent);
+            if (rt)
+            {
+                DBSPIDER_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
+                                             << epevent.events << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
+                return false;
+            }
         }
 
         // 待执行IO事件数加1
@@ -218,6 +468,23 @@ namespace dbspider
             eventContext.fiber = Fiber::GetThis();
             DBSPIDER_ASSERT(eventContext.fiber->getState() == Fiber::EXEC);
         }
+        if (fdContext->owner >= 0 && eventContext.scheduler == this)
+        {
+            // 多 reactor 模式下事件在所属线程的epoll上触发，等待的协程也回到该线程执行；
+            // 共享栈协程已经绑定了线程，只能回到绑定的线程，由 submit 按绑定的线程调度
+            if (!eventContext.fiber || eventContext.fiber->getBoundThread() == -1)
+            {
+                eventContext.thread = m_threadIds[fdContext->owner];
+            }
+        }
+
+        // 没有传入 ready 的调用方无法重试，已经就绪的事件直接触发
+        if (fdContext->ready & event)
+        {
+            fdContext->ready &= ~event;
+            fdContext->triggerEvent(event);
+            --m_pendingEventCount;
+        }
 
         return true;
     }
@@ -225,14 +492,12 @@ namespace dbspider
     // 删除事件
     bool IOManager::delEvent(int fd, Event event)
     {
-        RWMutexType::ReadLock lock(m_mutex);
         // 找到要删除的fd
-        if ((int)m_fdContexts.size() <= fd)
+        FdContext *fdContext = getFdContext(fd);
+        if (!fdContext)
         {
             return false;
         }
-        FdContext *fdContext = m_fdContexts[fd];
-        lock.unlock();
 
         FdContext::MutexType::Lock lock1(fdContext->mutex);
         if (!(fdContext->events & event))
@@ -240,14 +505,23 @@ namespace dbspider
             return false;
         }
 
+        // 常驻注册的fd不修改epoll，只清除事件上下文
+        if (fdContext->persistent)
+        {
+            fdContext->events = (Event)(fdContext->events & ~event);
+            fdContext->resetContext(fdContext->getContext(event));
+            m_pendingEventCount--;
+            return true;
+        }
+
         // 清除指定的事件，表示不关心这个事件了，如果清除之后结果为0，则从epoll_wait中删除该文件描述符
         Event newEvents = (Event)(fdContext->events & ~event);
-        int op = fdContext->events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+        int op = newEvents ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
         epoll_event epevent;
         memset(&epevent, 0, sizeof(epoll_event));
         epevent.events = EPOLLET | newEvents;
         epevent.data.ptr = fdContext;
-        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
+        int rt = epollCtl(fdContext, op, &epevent);
         if (rt)
         {
             DBSPIDER_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
@@ -269,28 +543,34 @@ namespace dbspider
     // 取消事件
     bool IOManager::cancelEvent(int fd, Event event)
     {
-        RWMutexType::ReadLock lock(m_mutex);
         // 找到fd对应的FdContext
-        if ((int)m_fdContexts.size() <= fd)
+        FdContext *fdContext = getFdContext(fd);
+        if (!fdContext)
         {
             return false;
         }
-        FdContext *fdContext = m_fdContexts[fd];
-        lock.unlock();
         FdContext::MutexType::Lock lock1(fdContext->mutex);
         if (!(fdContext->events & event))
         {
             return false;
         }
 
+        // 常驻注册的fd不修改epoll，直接触发事件
+        if (fdContext->persistent)
+        {
+            fdContext->triggerEvent(event);
+            m_pendingEventCount--;
+            return true;
+        }
+
         // 删除事件
         Event newEvents = (Event)(fdContext->events & ~event);
-        int op = fdContext->events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+        int op = newEvents ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
         epoll_event epevent;
         memset(&epevent, 0, sizeof(epoll_event));
         epevent.events = EPOLLET | newEvents;
         epevent.data.ptr = fdContext;
-        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
+        int rt = epollCtl(fdContext, op, &epevent);
         if (rt)
         {
             DBSPIDER_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
@@ -310,28 +590,31 @@ namespace dbspider
     bool IOManager::cancelAllEvent(int fd)
     {
         // 找到fd对应的FdContext
-        RWMutexType::ReadLock lock(m_mutex);
-        if ((int)m_fdContexts.size() <= fd)
+        FdContext *fdContext = getFdContext(fd);
+        if (!fdContext)
         {
             return false;
         }
-        FdContext *fdContext = m_fdContexts[fd];
-        lock.unlock();
         FdContext::MutexType::Lock lock1(fdContext->mutex);
-        if (!(fdContext->events))
+        if (!fdContext->persistent && !fdContext->events)
         {
+            releaseOwner(fdContext);
             return false;
         }
 
-        // 删除全部事件
+        // 删除全部事件，常驻注册的fd即将关闭，同样从epoll中删除，fd号被复用时重新注册
         int op = EPOLL_CTL_DEL;
         epoll_event epevent;
         memset(&epevent, 0, sizeof(epoll_event));
         epevent.events = 0;
         epevent.data.ptr = fdContext;
 
-        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
-        if (rt)
+        int rt = epollCtl(fdContext, op, &epevent);
+        bool persistent = fdContext->persistent;
+        fdContext->persistent = false;
+        fdContext->ready = NONE;
+        releaseOwner(fdContext);
+        if (rt && !persistent)
         {
             DBSPIDER_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
                                          << epevent.events << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
@@ -356,27 +639,290 @@ namespace dbspider
     // 返回当前的IOManager
     IOManager *IOManager::GetThis()
     {
-        // 默认调度器
-        static IOManager s_scheduler(s_scheduler_threads, s_scheduler_name);
         IOManager *iom = dynamic_cast<IOManager *>(Scheduler::GetThis());
-        return iom ? iom : &s_scheduler;
+        if (iom)
+        {
+            return iom;
+        }
+        // 默认调度器，只在当前线程不属于任何IOManager时才创建，
+        // 否则在调度线程上构造它会覆盖该线程的t_scheduler
+        static IOManager *s_scheduler = []
+        {
+            static IOManager scheduler(s_scheduler_threads, s_scheduler_name);
+            s_default_scheduler = &scheduler;
+            return &scheduler;
+        }();
+        return s_scheduler;
+    }
+
+    int IOManager::submitIo(const io_uring_sqe &sqe, uint64_t timeout)
+    {
+        DBSPIDER_ASSERT(m_uring);
+        std::unique_ptr<IoRequest> request(new IoRequest);
+        request->fiber = Fiber::GetThis();
+        uint32_t need = timeout == ~0ull ? 1 : 2;
+
+        Mutex::Lock lock(m_uringMutex);
+        // 提交队列满了先把攒下的 SQE 提交掉，内核因为完成队列积压拒绝提交时先收割完成队列
+        while (m_uring->space() < need)
+        {
+            flushIo();
+            if (m_uring->space() < need)
+            {
+                lock.unlock();
+                reapIo();
+                lock.lock();
+            }
+        }
+        io_uring_sqe *entry = m_uring->getSqe();
+        *entry = sqe;
+        entry->user_data = reinterpret_cast<uint64_t>(request.get());
+        if (timeout != ~0ull)
+        {
+            // 链接一个超时请求，到时内核取消前面的IO，IO以 -ECANCELED 完成
+            entry->flags |= IOSQE_IO_LINK;
+            request->timeout.tv_sec = timeout / 1000;
+            request->timeout.tv_nsec = timeout % 1000 * 1000000;
+            io_uring_sqe *link = m_uring->getSqe();
+            link->opcode = IORING_OP_LINK_TIMEOUT;
+            link->fd = -1;
+            link->addr = reinterpret_cast<uint64_t>(&request->timeout);
+            link->len = 1;
+            link->user_data = 0;
+        }
+        ++m_pendingEventCount;
+        m_uringPending += need;
+        lock.unlock();
+
+        // SQE 入队之后才注册，取消请求一定排在它要取消的请求后面；
+        // listener 先于 request 析构，析构后回调不会再执行，不会按已经释放、可能被复用的地址取消别的请求
+        uint64_t target = reinterpret_cast<uint64_t>(request.get());
+        auto cancel = [this, target](int)
+        {
+            Mutex::Lock lock(m_uringMutex);
+            if (!submitCancel(-1, target, 0))
+            {
+                DBSPIDER_LOG_ERROR(g_logger) << "submitIo cancel submission queue full";
+            }
+        };
+        CancelToken::Listener listener(cancel);
+        if (listener.cancelled())
+        {
+            cancel(errno);
+        }
+
+        // 挂起等待IO完成，SQE 由调度循环攒批提交，完成后 reapIo 把协程重新加入调度
+        Fiber::YieldToHold();
+        return request->result;
+    }
+
+    void IOManager::cancelIo(int fd)
+    {
+        if (!m_uring)
+        {
+            return;
+        }
+        Mutex::Lock lock(m_uringMutex);
+        // 关闭fd之前内核必须已经看到取消请求，被取消的IO以 -ECANCELED 完成
+        if (!submitCancel(fd, 0, IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL))
+        {
+            DBSPIDER_LOG_ERROR(g_logger) << "cancelIo(" << fd << ") submission queue full";
+        }
+    }
+
+    bool IOManager::submitCancel(int fd, uint64_t target, uint32_t flags)
+    {
+        io_uring_sqe *sqe = m_uring->getSqe();
+        if (!sqe)
+        {
+            flushIo();
+            sqe = m_uring->getSqe();
+        }
+        if (!sqe)
+        {
+            return false;
+        }
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = fd;
+        sqe->addr = target;
+        sqe->cancel_flags = flags;
+        sqe->user_data = 0;
+        ++m_uringPending;
+        flushIo();
+        return true;
+    }
+
+    void IOManager::poll()
+    {
+        if (m_busyTimerUs && hasTimer())
+        {
+            // 每个线程记录上次检查的时间，调度循环不会每轮都去锁定时器分片
+            static thread_local uint64_t t_last_check = 0;
+            uint64_t now = GetCurrentUS();
+            if (now - t_last_check >= m_busyTimerUs)
+            {
+                t_last_check = now;
+                submitExpiredTimers();
+            }
+        }
+        if (!m_uring)
+        {
+            return;
+        }
+        if (m_uringPending.load(std::memory_order_relaxed) >= m_uringBatch)
+        {
+            Mutex::Lock lock(m_uringMutex);
+            flushIo();
+        }
+        if (m_uring->hasCompletions())
+        {
+            reapIo();
+        }
+    }
+
+    void IOManager::submitExpiredTimers()
+    {
+        std::vector<std::function<void()>> cbs;
+        std::vector<std::function<void()>> high_cbs;
+        getExpiredCallbacks(cbs, high_cbs);
+        if (high_cbs.size())
+        {
+            submit(high_cbs.begin(), high_cbs.end(), Fiber::HIGH);
+        }
+        if (cbs.size())
+        {
+            submit(cbs.begin(), cbs.end());
+        }
+    }
+
+    void IOManager::flushIo()
+    {
+        // 内核返回 EAGAIN/EBUSY 或只接收了一部分时，剩下的 SQE 留在提交队列里，下次提交时重试，
+        // 只减去内核实际接收的个数，poll 才会继续按批次提交它们
+        int rt = m_uring->submit();
+        if (rt < 0 && rt != -EAGAIN && rt != -EBUSY)
+        {
+            DBSPIDER_LOG_ERROR(g_logger) << "io_uring submit error=" << -rt
+                                         << " errstr=" << strerror(-rt);
+        }
+        if (rt > 0)
+        {
+            uint32_t pending = m_uringPending.load(std::memory_order_relaxed);
+            m_uringPending = pending - std::min<uint32_t>(pending, rt);
+        }
+    }
+
+    void IOManager::reapIo()
+    {
+        std::vector<Fiber::ptr> fibers;
+        {
+            Mutex::Lock lock(m_uringMutex);
+            m_uring->reap([&fibers](io_uring_cqe *cqe)
+                          {
+                              // 链接超时和取消请求的 user_data 为 0，不需要处理
+                              if (!cqe->user_data)
+                              {
+                                  return;
+                              }
+                              IoRequest *request = reinterpret_cast<IoRequest *>(cqe->user_data);
+                              request->result = cqe->res;
+                              fibers.push_back(std::move(request->fiber)); });
+        }
+        if (fibers.empty())
+        {
+            return;
+        }
+        // 先加入调度再减少待处理事件数，避免调度器在协程入队之前判断为可以停止
+        size_t count = fibers.size();
+        submit(fibers.begin(), fibers.end());
+        m_pendingEventCount -= count;
     }
 
     void IOManager::notify()
     {
+        m_tickles.fetch_add(1, std::memory_order_relaxed);
         // 没有空闲线程返回
         if (!hasIdleThreads())
         {
             return;
         }
-        int rt = write(m_tickleFds[1], "N", 1);
-        DBSPIDER_ASSERT(rt == 1);
+        // 有线程正在自旋时由它在自旋中取到任务，不需要经过 eventfd；
+        // 与 idleSpin 退出自旋后的检查配对：要么这里看到自旋的线程，要么它看到新提交的任务
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_spinning.load(std::memory_order_relaxed) && !m_stop)
+        {
+            return;
+        }
+        tickle();
+    }
+
+    void IOManager::tickle()
+    {
+        // 已经有唤醒还没被处理时不再重复写入，被唤醒的线程取到任务后如果队列还有剩余会继续唤醒下一个，
+        // 唤醒的线程数不会超过可执行的任务数；停止时需要唤醒所有线程，不合并
+        if (m_tickled.exchange(true) && !m_stop)
+        {
+            return;
+        }
+        m_tickleWrites.fetch_add(1, std::memory_order_relaxed);
+        uint64_t one = 1;
+        int rt = write_f(m_tickleFd, &one, sizeof(one));
+        DBSPIDER_ASSERT(rt == sizeof(one));
+    }
+
+    void IOManager::notifyThread(size_t index)
+    {
+        // 与 wait 中先置睡眠标记再检查专属队列的顺序配对，保证不会漏掉唤醒
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        unpark(index);
+        m_tickles.fetch_add(1, std::memory_order_relaxed);
+        // 清掉睡眠标记，同一次睡眠只唤醒一次
+        if (index >= m_sleeping.size() || !m_sleeping[index].exchange(false))
+        {
+            return;
+        }
+        m_tickleWrites.fetch_add(1, std::memory_order_relaxed);
+        if (index < m_wakeFds.size())
+        {
+            uint64_t one = 1;
+            int rt = write_f(m_wakeFds[index], &one, sizeof(one));
+            DBSPIDER_ASSERT(rt == sizeof(one));
+        }
+        else if (index < m_threadIds.size())
+        {
+            siginfo_t info;
+            memset(&info, 0, sizeof(info));
+            info.si_signo = m_wakeupSignal;
+            info.si_code = SI_QUEUE;
+            info.si_pid = getpid();
+            info.si_uid = getuid();
+            info.si_value.sival_int = WAKEUP_SIGNAL_VALUE;
+            syscall(SYS_rt_tgsigqueueinfo, getpid(), m_threadIds[index].load(), m_wakeupSignal, &info);
+        }
     }
 
     void IOManager::wait()
     {
         DBSPIDER_LOG_DEBUG(g_logger) << "wait for event";
 
+        int index = getCurrentIndex();
+        // 多 reactor 模式下只等待本线程的epoll
+        int epfd = index >= 0 && isMultiReactor() ? m_epfds[index] : m_epfd;
+        // 定向唤醒本线程的 eventfd ，只有多 reactor 模式才有
+        int wakeFd = index >= 0 && (size_t)index < m_wakeFds.size() ? m_wakeFds[index] : -1;
+        // 使用唤醒信号时平时屏蔽它，epoll_pwait 期间使用不含唤醒信号的掩码
+        sigset_t wait_mask;
+        sigset_t *wait_mask_ptr = nullptr;
+        if (m_wakeupSignal)
+        {
+            sigset_t wakeup_set;
+            sigemptyset(&wakeup_set);
+            sigaddset(&wakeup_set, m_wakeupSignal);
+            pthread_sigmask(SIG_BLOCK, &wakeup_set, &wait_mask);
+            sigdelset(&wait_mask, m_wakeupSignal);
+            wait_mask_ptr = &wait_mask;
+        }
+
         const uint64_t MAX_EVNETS = 256; // 一次epoll_wait最多检测256个就绪事件，如果就绪事件超过了这个数，那么会在下轮epoll_wati继续处理
         epoll_event *events = new epoll_event[MAX_EVNETS]();
         std::unique_ptr<epoll_event[]> uniquePtr(events);
@@ -389,46 +935,110 @@ namespace dbspider
                                             << " idle stopping exit";
                 return;
             }
+            if (m_uring)
+            {
+                // 睡眠之前把攒下的 SQE 全部提交，已经有IO完成时收割后不再睡眠
+                {
+                    Mutex::Lock lock(m_uringMutex);
+                    flushIo();
+                }
+                if (m_uring->hasCompletions())
+                {
+                    reapIo();
+                    next_timeout = 0;
+                }
+            }
             int rt = 0;
             do
             {
                 static const int MAX_TIMEOUT = 3000;
-                if (next_timeout != ~0ull)
+                int timeout_ms = MAX_TIMEOUT;
+                if (next_timeout == 0)
                 {
-                    next_timeout = std::min((int)next_timeout, MAX_TIMEOUT);
+                    timeout_ms = 0;
                 }
-                else
+                else if (next_timeout < MAX_TIMEOUT * 1000ull)
+                {
+                    // 由 timerfd 准时唤醒，epoll_wait 的超时只作为兜底
+                    setTimerFd(next_timeout);
+                    timeout_ms = next_timeout / 1000 + 1;
+                }
+                if (m_idleSpinUs && timeout_ms != 0)
                 {
-                    next_timeout = MAX_TIMEOUT;
+                    // 先自旋一段时间，这期间到达的事件和任务不需要经过睡眠和唤醒
+                    rt = idleSpin(epfd, events, MAX_EVNETS, std::min(m_idleSpinUs, next_timeout));
+                    if (rt != 0)
+                    {
+                        m_idleSpinHits.fetch_add(1, std::memory_order_relaxed);
+                        rt = std::max(rt, 0);
+                        break;
+                    }
+                }
+                if (index >= 0)
+                {
+                    m_sleeping[index] = true;
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (hasPinnedTasks())
+                    {
+                        m_sleeping[index] = false;
+                        rt = 0;
+                        break;
+                    }
                 }
                 // 阻塞在epoll_wait上，等待事件发生
-                rt = epoll_wait(m_epfd, events, MAX_EVNETS, (int)next_timeout);
-                if (rt < 0 && errno == EINTR)
+                rt = epoll_pwait(epfd, events, MAX_EVNETS, timeout_ms, wait_mask_ptr);
+                if (index >= 0)
                 {
-                    continue;
+                    m_sleeping[index] = false;
                 }
-                else
+                if (rt < 0 && errno == EINTR)
                 {
-                    break;
+                    // 被唤醒信号定向唤醒，回到调度协程处理专属任务
+                    rt = 0;
                 }
+                break;
             } while (true);
 
-            std::vector<std::function<void()>> cbs;
-            getExpiredCallbacks(cbs);
-            if (cbs.size())
-            {
-                submit(cbs.begin(), cbs.end());
-            }
+            submitExpiredTimers();
 
             // 遍历所有发生的事件，根据epoll_event的私有指针找到对应的FdContext，进行事件处理
             for (int i = 0; i < rt; ++i)
             {
                 epoll_event &event = events[i];
-                if (event.data.fd == m_tickleFds[0])
+                if (wakeFd >= 0 && event.data.fd == wakeFd)
                 {
-                    // ticklefd[0]用于通知协程调度，这时只需要把管道里的内容读完即可，本轮 wait 结束 Scheduler::run 会重新执行协程调度
-                    uint8_t dummy[256];
-                    while (read(m_tickleFds[0], dummy, sizeof(dummy)) > 0)
+                    // 被定向唤醒，读出计数即可，本轮 wait 结束后回到调度协程处理专属任务
+                    uint64_t dummy;
+                    while (read_f(wakeFd, &dummy, sizeof(dummy)) > 0)
+                        ;
+                    continue;
+                }
+                if (event.data.fd == m_tickleFd)
+                {
+                    // eventfd用于通知协程调度，读出计数即可，本轮 wait 结束 Scheduler::run 会重新执行协程调度
+                    // 先读再清除标记：清除之前合并掉的唤醒，对应的任务会在本线程回到 Scheduler::run 后取到
+                    // 内部的 eventfd/timerfd 都直接调用原始的 read ，不经过 hook：fd 号可能和之前关闭的 socket 相同，
+                    // FdManager 中残留的 FdCtx 会让 hook 把它当成 socket 再注册一次 epoll
+                    uint64_t dummy;
+                    while (read_f(m_tickleFd, &dummy, sizeof(dummy)) > 0)
+                        ;
+                    m_tickled = false;
+                    continue;
+                }
+                if (event.data.fd == m_uringEventFd)
+                {
+                    // io_uring 有IO完成，读出计数后收割完成队列
+                    uint64_t completions;
+                    while (read_f(m_uringEventFd, &completions, sizeof(completions)) > 0)
+                        ;
+                    reapIo();
+                    continue;
+                }
+                if (event.data.fd == m_timerFd)
+                {
+                    // 定时器到期，读出超时次数即可，到期的定时器在上面已经取出
+                    uint64_t expirations;
+                    while (read_f(m_timerFd, &expirations, sizeof(expirations)) > 0)
                         ;
                     continue;
                 }
@@ -436,6 +1046,33 @@ namespace dbspider
                 FdContext *fdContext = static_cast<FdContext *>(event.data.ptr);
                 FdContext::MutexType::Lock lock(fdContext->mutex);
 
+                if (fdContext->persistent)
+                {
+                    // 常驻注册不修改epoll，有等待者的事件直接触发，没有等待者的记在 ready 中，等下次 addEvent 时取走
+                    int ready = NONE;
+                    if (event.events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP))
+                    {
+                        ready |= READ;
+                    }
+                    if (event.events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                    {
+                        ready |= WRITE;
+                    }
+                    int trigger = ready & fdContext->events;
+                    fdContext->ready |= ready & ~trigger;
+                    if (trigger & READ)
+                    {
+                        fdContext->triggerEvent(READ);
+                        --m_pendingEventCount;
+                    }
+                    if (trigger & WRITE)
+                    {
+                        fdContext->triggerEvent(WRITE);
+                        --m_pendingEventCount;
+                    }
+                    continue;
+                }
+
                 // EPOLLERR: 出错，比如写读端已经关闭的pipe
                 // EPOLLHUP: 套接字对端关闭
                 // 出现这两种事件，应该同时触发fd的读和写事件，否则有可能出现注册的事件永远执行不到的情况
@@ -462,7 +1099,7 @@ namespace dbspider
                 int left_events = fdContext->events & ~real_events;
                 int op = left_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
                 event.events = left_events | EPOLLET;
-                int res = epoll_ctl(m_epfd, op, fdContext->fd, &event);
+                int res = epollCtl(fdContext, op, &event);
                 if (res)
                 {
                     DBSPIDER_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fdContext->fd << ", "
@@ -495,27 +1132,170 @@ namespace dbspider
         return stopping(timeout);
     }
 
-    // 重置socket句柄上下文的容器大小
-    void IOManager::contextResize(size_t size)
+    IOManager::FdContext *IOManager::getFdContext(int fd, bool auto_create)
     {
-        size_t old_size = m_fdContexts.size();
-        m_fdContexts.resize(size);
-        for (size_t i = old_size; i < m_fdContexts.size(); ++i)
+        if (fd < 0)
         {
-            m_fdContexts[i] = new FdContext;
-            m_fdContexts[i]->fd = i;
+            return nullptr;
         }
+        if (!auto_create)
+        {
+            return m_fdContexts.get(fd);
+        }
+        return m_fdContexts.getOrCreate(fd, [](FdContext &fdContext, size_t index)
+                                        { fdContext.fd = index; });
     }
 
     void IOManager::onInsertAtFront()
     {
-        notify();
+        // 自旋的线程不检查定时器，新的最早定时器总是通过 eventfd 让空闲线程重新计算超时
+        m_tickles.fetch_add(1, std::memory_order_relaxed);
+        if (hasIdleThreads())
+        {
+            tickle();
+        }
+    }
+
+    size_t IOManager::getTimerShard()
+    {
+        // 调度线程使用自己的分片，其他线程按线程 id 分散
+        int index = getCurrentIndex();
+        return index >= 0 ? index : GetThreadId();
     }
 
     // 判断是否可以停止
     bool IOManager::stopping(uint64_t &timeout)
     {
-        timeout = getNextTimer();
+        timeout = getNextTimerUS();
         return timeout == ~0ull && m_pendingEventCount == 0 && Scheduler::stopping();
     }
+
+    int IOManager::epollCtl(FdContext *fdContext, int op, epoll_event *event)
+    {
+        m_epollCtls.fetch_add(1, std::memory_order_relaxed);
+        int epfd = fdContext->owner >= 0 ? m_epfds[fdContext->owner] : m_epfd;
+        return epoll_ctl(epfd, op, fdContext->fd, event);
+    }
+
+    bool IOManager::setFdOwner(int fd, size_t index)
+    {
+        if (!isMultiReactor() || index >= m_epfds.size())
+        {
+            return false;
+        }
+        FdContext *fdContext = getFdContext(fd, true);
+        if (!fdContext)
+        {
+            return false;
+        }
+        FdContext::MutexType::Lock lock2(fdContext->mutex);
+        if (fdContext->events || fdContext->persistent)
+        {
+            return fdContext->owner == (int)index;
+        }
+        releaseOwner(fdContext);
+        fdContext->owner = index;
+        ++m_ownedFds[index];
+        wakeOwner(index);
+        return true;
+    }
+
+    int IOManager::getFdOwner(int fd)
+    {
+        FdContext *fdContext = getFdContext(fd);
+        if (!fdContext)
+        {
+            return -1;
+        }
+        FdContext::MutexType::Lock lock1(fdContext->mutex);
+        return fdContext->owner;
+    }
+
+    void IOManager::wakeOwner(size_t index)
+    {
+        // fd 分给了正在退役或者已经停放的线程，叫醒它等待fd的事件，拥有fd的线程不会停放
+        if (index >= getThreadCount())
+        {
+            notifyThread(index);
+        }
+    }
+
+    bool IOManager::canRetire(size_t index)
+    {
+        // 多 reactor 模式下fd的事件只在所属线程的epoll上等待，拥有fd的线程停放后这些事件就没人处理了
+        return !isMultiReactor() || getOwnedFdCount(index) == 0;
+    }
+
+    int IOManager::idleSpin(int epfd, epoll_event *events, int max_events, uint64_t us)
+    {
+        uint64_t deadline = GetCurrentUS() + us;
+        int rt = 0;
+        m_spinning.fetch_add(1);
+        while (true)
+        {
+            // 自旋期间 notify 不写 eventfd，全局队列的任务直接检查；专属任务只在睡眠时才发信号，也直接检查
+            rt = epoll_wait(epfd, events, max_events, 0);
+            if (rt > 0)
+            {
+                break;
+            }
+            if (hasGlobalTasks() || hasPinnedTasks() || (m_uring && m_uring->hasCompletions()))
+            {
+                rt = -1;
+                break;
+            }
+            if (GetCurrentUS() >= deadline)
+            {
+                rt = 0;
+                break;
+            }
+            // 让出CPU给其他可运行的线程，线程数多于核数时自旋不会饿死产生事件的线程
+            sched_yield();
+        }
+        m_spinning.fetch_sub(1);
+        // 与 notify 配对：退出自旋之前提交、因此没有写 eventfd 的任务在这里取到
+        // 其他线程本地队列的任务（供窃取）在自旋期间不检查，最晚在这里发现
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (rt == 0 && hasPendingTasks())
+        {
+            rt = -1;
+        }
+        return rt;
+    }
+
+    void IOManager::releaseOwner(FdContext *fdContext)
+    {
+        if (fdContext->owner >= 0)
+        {
+            --m_ownedFds[fdContext->owner];
+            fdContext->owner = -1;
+        }
+    }
+
+    void IOManager::setTimerFd(uint64_t timeout)
+    {
+        // 按 CLOCK_MONOTONIC 的绝对时间设置，比较和设置在同一把锁内，不会被别的线程用更晚的时间覆盖
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t now_us = now.tv_sec * 1000000ull + now.tv_nsec / 1000;
+        uint64_t deadline = now_us + timeout;
+        Mutex::Lock lock(m_timerFdMutex);
+        // 所有空闲线程共享一个 timerfd ，已经设置了更早、还没到期的时间时不再修改，
+        // 否则后计算超时的线程会把它推迟，最早的定时器要等到 epoll_wait 的毫秒超时才执行
+        if (m_timerFdDeadline > now_us && m_timerFdDeadline <= deadline)
+        {
+            return;
+        }
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.it_value.tv_sec = deadline / 1000000;
+        spec.it_value.tv_nsec = deadline % 1000000 * 1000;
+        if (timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr))
+        {
+            DBSPIDER_LOG_ERROR(g_logger) << "timerfd_settime(" << m_timerFd << ") errno=" << errno
+                                         << " errstr=" << strerror(errno);
+            return;
+        }
+        m_timerFdDeadline = deadline;
+    }
 }
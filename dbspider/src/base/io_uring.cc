@@ -0,0 +1,194 @@
+#include "io_uring.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <memory>
+
+#include "log.h"
+
+namespace dbspider
+{
+    static Logger::ptr g_logger = DBSPIDER_LOG_NAME("system");
+
+    static int io_uring_setup(unsigned entries, io_uring_params *params)
+    {
+        return syscall(__NR_io_uring_setup, entries, params);
+    }
+
+    static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+        return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+    }
+
+    static int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+    {
+        return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+    }
+
+    IoUring::IoUring(unsigned entries)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = io_uring_setup(entries, &params);
+        if (fd < 0)
+        {
+            DBSPIDER_LOG_WARN(g_logger) << "io_uring_setup(" << entries << ") errno=" << errno
+                                        << " errstr=" << strerror(errno);
+            return;
+        }
+
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap)
+        {
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        }
+        m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_SQ_RING);
+        if (m_sqRing == MAP_FAILED)
+        {
+            m_sqRing = nullptr;
+            ::close(fd);
+            return;
+        }
+        if (single_mmap)
+        {
+            m_cqRing = m_sqRing;
+        }
+        else
+        {
+            m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            fd, IORING_OFF_CQ_RING);
+            if (m_cqRing == MAP_FAILED)
+            {
+                m_cqRing = nullptr;
+                munmap(m_sqRing, m_sqRingSize);
+                m_sqRing = nullptr;
+                ::close(fd);
+                return;
+            }
+        }
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            if (m_cqRing != m_sqRing)
+            {
+                munmap(m_cqRing, m_cqRingSize);
+            }
+            munmap(m_sqRing, m_sqRingSize);
+            m_sqRing = m_cqRing = nullptr;
+            ::close(fd);
+            return;
+        }
+        m_sqes = static_cast<io_uring_sqe *>(sqes);
+
+        char *sq = static_cast<char *>(m_sqRing);
+        m_sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        m_sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        m_sqEntries = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+
+        char *cq = static_cast<char *>(m_cqRing);
+        m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        m_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        m_cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+
+        m_sqeHead = m_sqeTail = *m_sqTail;
+        m_ringFd = fd;
+    }
+
+    IoUring::~IoUring()
+    {
+        if (m_ringFd < 0)
+        {
+            return;
+        }
+        munmap(m_sqes, m_sqesSize);
+        if (m_cqRing != m_sqRing)
+        {
+            munmap(m_cqRing, m_cqRingSize);
+        }
+        munmap(m_sqRing, m_sqRingSize);
+        ::close(m_ringFd);
+    }
+
+    io_uring_sqe *IoUring::getSqe()
+    {
+        if (space() == 0)
+        {
+            return nullptr;
+        }
+        io_uring_sqe *sqe = &m_sqes[m_sqeTail & m_sqMask];
+        ++m_sqeTail;
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    unsigned IoUring::space() const
+    {
+        unsigned head = std::atomic_ref<unsigned>(*m_sqHead).load(std::memory_order_acquire);
+        return m_sqEntries - (m_sqeTail - head);
+    }
+
+    int IoUring::submit()
+    {
+        // SQE 在数组中的下标与提交队列中的位置一一对应
+        unsigned tail = *m_sqTail;
+        for (; m_sqeHead != m_sqeTail; ++m_sqeHead, ++tail)
+        {
+            m_sqArray[tail & m_sqMask] = m_sqeHead & m_sqMask;
+        }
+        std::atomic_ref<unsigned>(*m_sqTail).store(tail, std::memory_order_release);
+
+        unsigned to_submit = tail - std::atomic_ref<unsigned>(*m_sqHead).load(std::memory_order_acquire);
+        if (to_submit == 0)
+        {
+            return 0;
+        }
+        int rt = 0;
+        do
+        {
+            rt = io_uring_enter(m_ringFd, to_submit, 0, 0);
+        } while (rt < 0 && errno == EINTR);
+        if (rt < 0)
+        {
+            // EAGAIN/EBUSY 时 SQE 仍在提交队列中，下次 submit 会再次提交
+            return -errno;
+        }
+        return rt;
+    }
+
+    bool IoUring::registerEventFd(int fd)
+    {
+        return io_uring_register(m_ringFd, IORING_REGISTER_EVENTFD, &fd, 1) == 0;
+    }
+
+    bool IoUring::probe(std::initializer_list<int> ops)
+    {
+        static const unsigned OPS = 256;
+        size_t size = sizeof(io_uring_probe) + OPS * sizeof(io_uring_probe_op);
+        std::unique_ptr<char[]> buf(new char[size]());
+        io_uring_probe *probe = reinterpret_cast<io_uring_probe *>(buf.get());
+        if (io_uring_register(m_ringFd, IORING_REGISTER_PROBE, probe, OPS) < 0)
+        {
+            return false;
+        }
+        for (int op : ops)
+        {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
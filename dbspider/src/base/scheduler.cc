@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <signal.h>
+#include "config.h"
 #include "hook.h"
 #include "scheduler.h"
 #include "macro.h"
@@ -12,13 +13,76 @@ namespace dbspider
 {
     static Logger::ptr g_logger = DBSPIDER_LOG_NAME("system");
 
+    static ConfigVar<bool>::ptr g_scheduler_work_stealing =
+        Config::Lookup<bool>("scheduler.work_stealing", false,
+                             "scheduler work stealing mode");
+
+    static ConfigVar<uint64_t>::ptr g_scheduler_min_threads =
+        Config::Lookup<uint64_t>("scheduler.min_threads", 0,
+                                 "scheduler elastic pool lower bound, 0 means the initial thread count");
+    static ConfigVar<uint64_t>::ptr g_scheduler_max_threads =
+        Config::Lookup<uint64_t>("scheduler.max_threads", 0,
+                                 "scheduler elastic pool upper bound, 0 means the initial thread count");
+    static ConfigVar<uint64_t>::ptr g_scheduler_grow_delay_ms =
+        Config::Lookup<uint64_t>("scheduler.grow_delay_ms", 10,
+                                 "scheduler add a thread after all threads stay busy with tasks waiting this long");
+    static ConfigVar<uint64_t>::ptr g_scheduler_retire_idle_ms =
+        Config::Lookup<uint64_t>("scheduler.retire_idle_ms", 1000,
+                                 "scheduler retire a thread after some threads stay idle this long");
+    static ConfigVar<std::vector<int>>::ptr g_scheduler_cpu_affinity =
+        Config::Lookup<std::vector<int>>("scheduler.cpu_affinity", {},
+                                         "scheduler pin thread i to cpu_affinity[i % size], empty means no pinning");
+    static ConfigVar<uint32_t>::ptr g_scheduler_high_priority_burst =
+        Config::Lookup<uint32_t>("scheduler.high_priority_burst", 8,
+                                 "scheduler run one normal task after this many high priority tasks in a row, 0 means strict priority");
+    static ConfigVar<uint64_t>::ptr g_scheduler_preempt_slice_us =
+        Config::Lookup<uint64_t>("scheduler.preempt_slice_us", 0,
+                                 "scheduler ask a fiber to yield at its next Fiber::MaybeYield after running this long, 0 means no preemption");
+    static ConfigVar<uint64_t>::ptr g_scheduler_long_run_warn_ms =
+        Config::Lookup<uint64_t>("scheduler.long_run_warn_ms", 0,
+                                 "scheduler warn about a fiber running this long without yielding, 0 means no warning");
+    static ConfigVar<uint64_t>::ptr g_scheduler_inject_capacity =
+        Config::Lookup<uint64_t>("scheduler.inject_capacity", 0,
+                                 "scheduler lock-free injection queue capacity, rounded up to a power of 2, 0 means a mutex protected queue only");
+
+    // 工作窃取模式下每调度这么多轮先看一次全局队列，本地队列一直有任务时外部提交和 IO 唤醒也不会饿死（同 Go 的 61）
+    static const uint32_t GLOBAL_POLL_INTERVAL = 61;
+
     // 当前线程的调度器，同一个调度器下的所有线程指向同一个调度器实例
     static thread_local Scheduler *t_scheduler = nullptr;
 
+    // 当前线程在所属调度器线程池中的下标，非调度线程为-1
+    static thread_local int t_scheduler_index = -1;
+
     Scheduler::Scheduler(size_t threads, const std::string &name)
-        : m_name(name), m_threadCount(threads)
+        : m_name(name), m_threadCount(std::max<size_t>(threads, 1))
     {
         t_scheduler = this;
+        m_workStealing = g_scheduler_work_stealing->getValue();
+
+        // 没有配置上下限时线程数固定
+        threads = m_threadCount;
+        size_t min_threads = g_scheduler_min_threads->getValue();
+        m_minThreads = min_threads ? std::min(min_threads, threads) : threads;
+        m_maxThreads = std::max<size_t>(g_scheduler_max_threads->getValue(), threads);
+        m_growDelayMs = g_scheduler_grow_delay_ms->getValue();
+        m_retireIdleMs = g_scheduler_retire_idle_ms->getValue();
+        m_cpuAffinity = g_scheduler_cpu_affinity->getValue();
+        m_highBurst = g_scheduler_high_priority_burst->getValue();
+        m_preemptSliceUs = g_scheduler_preempt_slice_us->getValue();
+        m_longRunUs = g_scheduler_long_run_warn_ms->getValue() * 1000;
+        size_t inject_capacity = g_scheduler_inject_capacity->getValue();
+        if (inject_capacity)
+        {
+            m_inject.reset(new MpmcQueue<ScheduleTask>(inject_capacity));
+        }
+        m_threadIds = std::vector<std::atomic<int>>(m_maxThreads);
+        size_t capacity = 4;
+        while (capacity < m_maxThreads * 2)
+        {
+            capacity <<= 1;
+        }
+        m_threadIndex = std::vector<ThreadIndexEntry>(capacity);
     }
 
     Scheduler::~Scheduler()
@@ -33,7 +97,7 @@ namespace dbspider
     // 启动调度器
     void Scheduler::start()
     {
-        MutexType::Lock lock(m_mutex);
+        MutexType::Lock lock(m_resizeMutex);
         // 调度器没有停止就直接返回
         if (m_stop == false)
         {
@@ -41,16 +105,52 @@ namespace dbspider
         }
         m_stop = false;
         DBSPIDER_ASSERT(m_threads.empty());
-        m_threads.resize(m_threadCount);
-        m_threadIds.resize(m_threadCount);
-        for (size_t i = 0; i < m_threadCount; ++i)
+        // 每个线程的队列按容量创建好，运行期间不再改变，增减线程时不需要和取任务的线程同步
+        m_threads.resize(m_maxThreads);
+        if (m_workStealing)
         {
-            m_threads[i].reset(new dbspider::Thread(m_name + "_" + std::to_string(i),
-                                                    [this]
-                                                    {
-                                                        this->run();
-                                                    }));
-            m_threadIds[i] = m_threads[i]->getId();
+            m_localQueues.resize(m_maxThreads);
+            for (auto &q : m_localQueues)
+            {
+                q.reset(new LocalQueue);
+            }
+        }
+        for (auto *queues : {&m_pinnedQueues, &m_pinnedHighQueues})
+        {
+            queues->resize(m_maxThreads);
+            for (auto &q : *queues)
+            {
+                q.reset(new LocalQueue);
+            }
+        }
+        m_parkings.resize(m_maxThreads);
+        for (auto &p : m_parkings)
+        {
+            p.reset(new Parking);
+        }
+        m_slices.resize(m_maxThreads);
+        for (auto &s : m_slices)
+        {
+            s.reset(new Slice);
+        }
+        // 重新启动时丢掉上次运行的线程，哈希表里最多只有线程池容量个线程
+        for (auto &entry : m_threadIndex)
+        {
+            entry.thread.store(0, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < getThreadCount(); ++i)
+        {
+            spawn(i);
+        }
+        if (m_minThreads < m_maxThreads)
+        {
+            m_monitor.reset(new Thread(m_name + "_monitor", [this]
+                                       { monitor(); }));
+        }
+        if (m_preemptSliceUs || m_longRunUs)
+        {
+            m_watchdog.reset(new Thread(m_name + "_watchdog", [this]
+                                        { watchdog(); }));
         }
     }
 
@@ -58,18 +158,118 @@ namespace dbspider
     void Scheduler::stop()
     {
         m_stop = true;
-        for (size_t i = 0; i < m_threadCount; ++i)
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (auto *thread : {&m_monitor, &m_watchdog})
+        {
+            if (*thread)
+            {
+                (*thread)->join();
+                thread->reset();
+            }
+        }
+        // 停放的线程也要唤醒，让它们退出调度循环
+        for (size_t i = 0; i < m_parkings.size(); ++i)
+        {
+            unpark(i);
+        }
+        for (size_t i = 0; i < m_maxThreads; ++i)
         {
             notify();
         }
         std::vector<Thread::ptr> vec;
-        vec.swap(m_threads);
+        {
+            MutexType::Lock lock(m_resizeMutex);
+            vec.swap(m_threads);
+        }
         for (auto &t : vec)
         {
-            t->join();
+            if (t)
+            {
+                t->join();
+            }
+        }
+    }
+
+    void Scheduler::setThreadCount(size_t threads)
+    {
+        if (threads > m_maxThreads)
+        {
+            DBSPIDER_LOG_WARN(g_logger) << "name=" << m_name << " threads=" << threads
+                                        << " exceeds max threads " << m_maxThreads << ", see scheduler.max_threads";
+        }
+        threads = std::min(std::max<size_t>(threads, 1), m_maxThreads);
+        MutexType::Lock lock(m_resizeMutex);
+        size_t old = getThreadCount();
+        if (threads == old)
+        {
+            return;
+        }
+        DBSPIDER_LOG_INFO(g_logger) << "name=" << m_name << " threads from " << old << " to " << threads;
+        m_threadCount = threads;
+        if (m_stop)
+        {
+            // 还没有启动，start 时按新的数量创建线程
+            return;
+        }
+        for (size_t i = old; i < threads; ++i)
+        {
+            if (m_threads[i])
+            {
+                unpark(i);
+            }
+            else
+            {
+                spawn(i);
+            }
+        }
+        // 叫醒睡眠中的退役线程，让它们发现自己退役了
+        for (size_t i = threads; i < old; ++i)
+        {
+            notifyThread(i);
+        }
+    }
+
+    void Scheduler::spawn(size_t index)
+    {
+        std::vector<int> cpus;
+        int cpu = getCpu(index);
+        if (cpu >= 0)
+        {
+            cpus.push_back(cpu);
+        }
+        m_threads[index].reset(new dbspider::Thread(m_name + "_" + std::to_string(index),
+                                                    [this, index]
+                                                    {
+                                                        t_scheduler_index = index;
+                                                        this->run();
+                                                    },
+                                                    cpus));
+        int thread = m_threads[index]->getId();
+        m_threadIds[index] = thread;
+        // spawn 都在 m_resizeMutex 内调用，只有一个写者；先写下标再发布线程ID
+        size_t mask = m_threadIndex.size() - 1;
+        for (size_t i = thread & mask;; i = (i + 1) & mask)
+        {
+            ThreadIndexEntry &entry = m_threadIndex[i];
+            int key = entry.thread.load(std::memory_order_relaxed);
+            if (key == 0 || key == thread)
+            {
+                entry.index.store(index, std::memory_order_relaxed);
+                entry.thread.store(thread, std::memory_order_release);
+                break;
+            }
         }
     }
 
+    int Scheduler::getCpu(size_t index) const
+    {
+        if (m_cpuAffinity.empty())
+        {
+            return -1;
+        }
+        return m_cpuAffinity[index % m_cpuAffinity.size()];
+    }
+
     Scheduler *Scheduler::GetThis()
     {
         return t_scheduler;
@@ -81,6 +281,76 @@ namespace dbspider
         DBSPIDER_LOG_INFO(g_logger) << "notify";
     }
 
+    void Scheduler::notifyThread(size_t index)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        unpark(index);
+        notify();
+    }
+
+    void Scheduler::unpark(size_t index)
+    {
+        // 只有把停放标记从true改成false的一方发信号，信号量的计数与停放次数一一对应
+        if (index < m_parkings.size() && m_parkings[index]->parked.exchange(false))
+        {
+            m_parkings[index]->sem.notify();
+        }
+    }
+
+    bool Scheduler::park(size_t index)
+    {
+        Parking *parking = m_parkings[index].get();
+        parking->parked = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // 置停放标记之后再检查一次，与 setThreadCount 、提交专属任务和 stop 修改条件后的 unpark 配对，不会漏掉唤醒
+        if (m_stop || index < getThreadCount() || hasPinnedTasks() || !canRetire(index))
+        {
+            if (parking->parked.exchange(false))
+            {
+                return false;
+            }
+            // 已经有人唤醒并发出了信号，取走信号后回到调度循环
+        }
+        parking->sem.wait();
+        return true;
+    }
+
+    Scheduler::Stats Scheduler::getStats() const
+    {
+        Stats stats;
+        stats.tickles = m_tickles.load(std::memory_order_relaxed);
+        stats.tickleWrites = m_tickleWrites.load(std::memory_order_relaxed);
+        stats.tickleSaved = stats.tickles > stats.tickleWrites ? stats.tickles - stats.tickleWrites : 0;
+        stats.maxRunUs = m_maxRunUs.load(std::memory_order_relaxed);
+        stats.preemptRequests = m_preemptRequests.load(std::memory_order_relaxed);
+        stats.longRuns = m_longRuns.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    int Scheduler::getCurrentIndex() const
+    {
+        return t_scheduler == this ? t_scheduler_index : -1;
+    }
+
+    bool Scheduler::hasPinnedTasks()
+    {
+        int index = getCurrentIndex();
+        if (index < 0 || index >= (int)m_pinnedQueues.size())
+        {
+            return false;
+        }
+        for (auto *queues : {&m_pinnedQueues, &m_pinnedHighQueues})
+        {
+            LocalQueue *pinned = (*queues)[index].get();
+            LocalQueue::MutexType::Lock lock(pinned->mutex);
+            if (!pinned->tasks.empty())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
     // 协程调度函数
     void Scheduler::run()
     {
@@ -93,47 +363,41 @@ namespace dbspider
         Fiber::ptr idle_fiber(new Fiber(std::bind(&Scheduler::wait, this)));
         ScheduleTask task;
 
+        size_t index = t_scheduler_index;
+        LocalQueue *local = getLocalQueue();
+        LocalQueue *pinned = m_pinnedQueues[index].get();
+        LocalQueue *pinned_high = m_pinnedHighQueues[index].get();
+        uint32_t high_streak = 0; // 连续执行的高优先级任务数
+        uint32_t tick = 0;        // 调度轮数，用于定期检查全局队列
+        Slice *slice = m_slices[index].get();
+        Fiber::SetPreemptFlag(&slice->preempt);
+
         while (true)
         {
             task.reset();
+            poll();
             bool tickle = false; // 是否tickle其他线程进行任务调度
-            // 线程取出任务
+            bool ignore = false; // 专属队列的剩余任务只能由本线程执行，不需要tickle其他线程
+            // 下标超出运行线程数的线程已经退役，只执行专属队列和本地队列中剩下的任务
+            bool retiring = index >= getThreadCount();
+            // 连续执行了 m_highBurst 个高优先级任务后先尝试普通任务，避免普通任务饿死
+            bool high_first = !m_highBurst || high_streak < m_highBurst;
+            bool high = high_first && popHigh(pinned_high, task, tickle, retiring);
+            bool global_first = local && !retiring && ++tick % GLOBAL_POLL_INTERVAL == 0;
+            // 线程取出任务：先取专属队列，再取本地队列，然后是全局注入队列，最后从其他线程窃取
+            // 本地队列模式下定期先取一次全局队列
+            if (!high && !popLocal(pinned, task, ignore) &&
+                !(global_first && popInject(task, tickle)) &&
+                !(local && popLocal(local, task, tickle)) &&
+                !retiring && !popInject(task, tickle) && local)
             {
-                MutexType::Lock lock(m_mutex);
-                auto it = m_tasks.begin();
-                // 遍历所有调度任务
-                while (it != m_tasks.end())
-                {
-                    // 指定了调度线程，但不是在当前线程上调度，标记一下需要通知其他线程进行调度，然后跳过这个任务，继续下一个
-                    if (it->thread != -1 && GetThreadId() != it->thread)
-                    {
-                        ++it;
-                        tickle = true;
-                        continue;
-                    }
-                    // 找到一个未指定线程，或是指定了当前线程的任务
-                    DBSPIDER_ASSERT(*it);
-
-                    // [BUG FIX]: hook IO相关的系统调用时，在检测到IO未就绪的情况下，会先添加对应的读写事件，再yield当前协程，等IO就绪后再resume当前协程
-                    // 多线程高并发情境下，有可能发生刚添加事件就被触发的情况，如果此时当前协程还未来得及yield，则这里就有可能出现协程状态仍为EXEC的情况
-                    // 这里简单地跳过这种情况，以损失一点性能为代价。
-                    if (it->fiber && it->fiber->getState() == Fiber::EXEC)
-                    {
-                        ++it;
-                        continue;
-                    }
-
-                    // 当前调度线程找到一个任务，准备开始调度，将其从任务队列中剔除，活动线程数加1
-                    task = *it;
-                    m_tasks.erase(it++);
-                    break;
-                }
-                // 当前线程拿完一个任务后，发现任务队列还有剩余，那么tickle一下其他线程
-                if (it != m_tasks.end())
-                {
-                    tickle = true;
-                }
+                steal(index, task, tickle);
+            }
+            if (!high && !high_first && !task)
+            {
+                high = popHigh(pinned_high, task, tickle, retiring);
             }
+            high_streak = high ? high_streak + 1 : 0;
             if (tickle)
             {
                 notify();
@@ -142,7 +406,9 @@ namespace dbspider
             if (task.fiber && (task.fiber->getState() != Fiber::TERM && task.fiber->getState() != Fiber::EXCEPT))
             {
                 ++m_activeThreads;
+                beginSlice(slice, task.fiber->getId());
                 task.fiber->resume();
+                endSlice(slice);
                 --m_activeThreads;
                 if (task.fiber->getState() == Fiber::READY)
                 {
@@ -154,15 +420,19 @@ namespace dbspider
             {
                 if (cb_fiber)
                 {
-                    cb_fiber->reset(task.cb);
+                    cb_fiber->reset(std::move(task.cb));
                 }
                 else
                 {
-                    cb_fiber.reset(new Fiber(task.cb));
+                    cb_fiber.reset(new Fiber(std::move(task.cb)));
                 }
+                // 回调挂起后被唤醒时仍按提交时的优先级调度
+                cb_fiber->setPriority(task.priority);
                 task.reset();
                 ++m_activeThreads;
+                beginSlice(slice, cb_fiber->getId());
                 cb_fiber->resume();
+                endSlice(slice);
                 --m_activeThreads;
                 if (cb_fiber->getState() == Fiber::READY)
                 {
@@ -187,18 +457,400 @@ namespace dbspider
                     // 不会结束，如果idle协程结束了，那一定是调度器停止了
                     break;
                 }
+                if (retiring)
+                {
+                    // 退役线程可能刚刚消耗掉一次唤醒，把它转交给其他空闲线程
+                    if (hasPendingTasks())
+                    {
+                        notify();
+                    }
+                    if (park(index))
+                    {
+                        continue;
+                    }
+                }
                 ++m_idleThreads;
                 idle_fiber->resume();
                 --m_idleThreads;
             }
         }
+        Fiber::SetPreemptFlag(nullptr);
+    }
+
+    void Scheduler::beginSlice(Slice *slice, uint64_t fiber_id)
+    {
+        slice->preempt.store(false, std::memory_order_relaxed);
+        slice->fiber.store(fiber_id, std::memory_order_relaxed);
+        slice->start.store(GetCurrentUS(), std::memory_order_relaxed);
+    }
+
+    void Scheduler::endSlice(Slice *slice)
+    {
+        uint64_t run_us = GetCurrentUS() - slice->start.load(std::memory_order_relaxed);
+        slice->start.store(0, std::memory_order_relaxed);
+        uint64_t max_us = m_maxRunUs.load(std::memory_order_relaxed);
+        while (run_us > max_us && !m_maxRunUs.compare_exchange_weak(max_us, run_us, std::memory_order_relaxed))
+            ;
+    }
+
+    Scheduler::LocalQueue *Scheduler::getLocalQueue()
+    {
+        if (!m_workStealing || t_scheduler != this || t_scheduler_index < 0 ||
+            t_scheduler_index >= (int)m_localQueues.size())
+        {
+            return nullptr;
+        }
+        return m_localQueues[t_scheduler_index].get();
+    }
+
+    int Scheduler::getThreadIndex(int thread) const
+    {
+        // 线性探测，遇到空位说明线程ID不在表中；线程ID通常是连续的，很少冲突
+        size_t mask = m_threadIndex.size() - 1;
+        size_t i = thread & mask;
+        for (size_t n = 0; n <= mask; ++n, i = (i + 1) & mask)
+        {
+            const ThreadIndexEntry &entry = m_threadIndex[i];
+            int key = entry.thread.load(std::memory_order_acquire);
+            if (key == 0)
+            {
+                return -1;
+            }
+            if (key == thread)
+            {
+                // 表只在启动时清空，再确认一次这个下标上还是这个线程
+                int index = entry.index.load(std::memory_order_relaxed);
+                return m_threadIds[index].load(std::memory_order_relaxed) == thread ? index : -1;
+            }
+        }
+        return -1;
+    }
+
+    bool Scheduler::popLocal(LocalQueue *local, ScheduleTask &task, bool &tickle)
+    {
+        LocalQueue::MutexType::Lock lock(local->mutex);
+        for (size_t i = 0; i < local->tasks.size(); ++i)
+        {
+            ScheduleTask &t = local->tasks[i];
+            // 同全局队列，跳过刚加入事件还未来得及yield的协程
+            if (t.fiber && t.fiber->getState() == Fiber::EXEC)
+            {
+                continue;
+            }
+            task = std::move(t);
+            local->tasks.erase(i);
+            // 本地队列还有剩余，通知空闲线程来窃取
+            tickle = !local->tasks.empty() && hasIdleThreads();
+            return true;
+        }
+        return false;
+    }
+
+    bool Scheduler::popHigh(LocalQueue *pinned, ScheduleTask &task, bool &tickle, bool retiring)
+    {
+        bool ignore = false;
+        if (popLocal(pinned, task, ignore))
+        {
+            return true;
+        }
+        return !retiring && m_highTaskCount.load(std::memory_order_relaxed) && popGlobal(m_highTasks, task, tickle);
+    }
+
+    bool Scheduler::submitNoLock(ScheduleTask &&task, Fiber::Priority priority)
+    {
+        bool high = priority == Fiber::HIGH;
+        TaskQueue &tasks = high ? m_highTasks : m_tasks;
+        bool need_notify = tasks.empty();
+        if (task)
+        {
+            task.priority = priority;
+            tasks.push_back(std::move(task));
+            (high ? m_highTaskCount : m_taskCount).fetch_add(1, std::memory_order_relaxed);
+        }
+        return need_notify;
+    }
+
+    bool Scheduler::submitGlobal(ScheduleTask &&task, Fiber::Priority priority)
+    {
+        // 溢出队列里还有任务时新任务排在它们后面，溢出队列清空后再回到无锁队列
+        if (m_inject && task && task.thread == -1 && priority != Fiber::HIGH &&
+            !m_taskCount.load(std::memory_order_acquire))
+        {
+            task.priority = priority;
+            if (m_inject->push(std::move(task)))
+            {
+                // 无法在无锁入队的同时判断队列原来是否为空，每次都通知，由 notify 合并多余的唤醒
+                return true;
+            }
+        }
+        MutexType::Lock lock(m_mutex);
+        return submitNoLock(std::move(task), priority);
+    }
+
+    bool Scheduler::popInject(ScheduleTask &task, bool &tickle)
+    {
+        if (m_inject)
+        {
+            while (m_inject->pop(task))
+            {
+                if (!task.fiber || task.fiber->getState() != Fiber::EXEC)
+                {
+                    // 注入队列还有剩余，通知其他线程
+                    tickle = tickle || !m_inject->empty();
+                    return true;
+                }
+                // 刚加入事件还未来得及yield的协程移入溢出队列，由 popGlobal 原地跳过，等它yield之后再取，
+                // 不放回无锁队列的队尾，否则它会被反复取出、放回，还会排到后来的任务后面
+                tickle = true;
+                {
+                    MutexType::Lock lock(m_mutex);
+                    submitNoLock(std::move(task), task.priority);
+                }
+                task.reset();
+            }
+        }
+        return m_taskCount.load(std::memory_order_relaxed) && popGlobal(m_tasks, task, tickle);
+    }
+
+    bool Scheduler::popGlobal(TaskQueue &tasks, ScheduleTask &task, bool &tickle)
+    {
+        MutexType::Lock lock(m_mutex);
+        size_t i = 0;
+        // 遍历所有调度任务
+        while (i < tasks.size())
+        {
+            ScheduleTask &t = tasks[i];
+            // 指定了调度线程，但不是在当前线程上调度，标记一下需要通知其他线程进行调度，然后跳过这个任务，继续下一个
+            if (t.thread != -1 && GetThreadId() != t.thread)
+            {
+                ++i;
+                tickle = true;
+                continue;
+            }
+            // 找到一个未指定线程，或是指定了当前线程的任务
+            DBSPIDER_ASSERT(t);
+
+            // [BUG FIX]: hook IO相关的系统调用时，在检测到IO未就绪的情况下，会先添加对应的读写事件，再yield当前协程，等IO就绪后再resume当前协程
+            // 多线程高并发情境下，有可能发生刚添加事件就被触发的情况，如果此时当前协程还未来得及yield，则这里就有可能出现协程状态仍为EXEC的情况
+            // 这里简单地跳过这种情况，以损失一点性能为代价。
+            if (t.fiber && t.fiber->getState() == Fiber::EXEC)
+            {
+                ++i;
+                continue;
+            }
+
+            // 当前调度线程找到一个任务，准备开始调度，将其从任务队列中剔除
+            task = std::move(t);
+            tasks.erase(i);
+            (&tasks == &m_highTasks ? m_highTaskCount : m_taskCount).fetch_sub(1, std::memory_order_relaxed);
+            break;
+        }
+        // 当前线程拿完一个任务后，发现任务队列还有剩余，那么tickle一下其他线程
+        if (i < tasks.size())
+        {
+            tickle = true;
+        }
+        return task;
+    }
+
+    bool Scheduler::steal(size_t index, ScheduleTask &task, bool &tickle)
+    {
+        size_t n = m_localQueues.size();
+        LocalQueue *local = m_localQueues[index].get();
+        // 窃取到的任务先放在这里，不能持有 victim 的锁去拿本地队列的锁；复用同一个队列，窃取不分配内存
+        static thread_local TaskQueue t_stolen;
+        TaskQueue &stolen = t_stolen;
+        for (size_t i = 1; i < n; ++i)
+        {
+            LocalQueue *victim = m_localQueues[(index + i) % n].get();
+            // 窃取时只尝试加锁，避免与队列所有者和其他窃取者互相等待
+            if (!victim->mutex.tryLock())
+            {
+                continue;
+            }
+            {
+                // 从队尾开始窃取，保持原来的先后顺序放入 stolen
+                size_t count = (victim->tasks.size() + 1) / 2;
+                size_t from = victim->tasks.size();
+                while (count && from > 0)
+                {
+                    --from;
+                    ScheduleTask &t = victim->tasks[from];
+                    if (t.fiber && t.fiber->getState() == Fiber::EXEC)
+                    {
+                        continue;
+                    }
+                    --count;
+                }
+                // 一遍扫描完成：窃取的任务移入 stolen，跳过的协程向前紧凑，最后截掉队尾，不逐个 erase
+                size_t keep = from;
+                for (size_t j = from; j < victim->tasks.size(); ++j)
+                {
+                    ScheduleTask &t = victim->tasks[j];
+                    if (t.fiber && t.fiber->getState() == Fiber::EXEC)
+                    {
+                        if (keep != j)
+                        {
+                            victim->tasks[keep] = std::move(t);
+                        }
+                        ++keep;
+                        continue;
+                    }
+                    stolen.push_back(std::move(t));
+                }
+                while (victim->tasks.size() > keep)
+                {
+                    victim->tasks.pop_back();
+                }
+                if (!victim->tasks.empty())
+                {
+                    tickle = hasIdleThreads();
+                }
+            }
+            victim->mutex.unlock();
+            if (stolen.empty())
+            {
+                continue;
+            }
+            task = std::move(stolen.front());
+            stolen.pop_front();
+            if (!stolen.empty())
+            {
+                LocalQueue::MutexType::Lock lock(local->mutex);
+                while (!stolen.empty())
+                {
+                    local->tasks.push_back(std::move(stolen.front()));
+                    stolen.pop_front();
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool Scheduler::hasPendingTasks()
+    {
+        {
+            MutexType::Lock lock(m_mutex);
+            if (!m_tasks.empty() || !m_highTasks.empty() || (m_inject && !m_inject->empty()))
+            {
+                return true;
+            }
+        }
+        for (auto &q : m_localQueues)
+        {
+            LocalQueue::MutexType::Lock lock(q->mutex);
+            if (!q->tasks.empty())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Scheduler::monitor()
+    {
+        // 检查间隔取增加线程延迟的一半，持续忙碌的判断误差不超过半个间隔
+        uint64_t interval = std::max<uint64_t>(m_growDelayMs / 2, 1);
+        uint64_t busy_since = 0;
+        uint64_t idle_since = 0;
+        while (!m_stop)
+        {
+            usleep(interval * 1000);
+            uint64_t now = GetCurrentMS();
+            size_t threads = getThreadCount();
+
+            // 所有运行的线程都在执行任务，并且还有任务在排队
+            if (threads < m_maxThreads && m_idleThreads == 0 && m_activeThreads >= threads && hasPendingTasks())
+            {
+                busy_since = busy_since ? busy_since : now;
+                if (now - busy_since >= m_growDelayMs)
+                {
+                    setThreadCount(threads + 1);
+                    busy_since = 0;
+                }
+            }
+            else
+            {
+                busy_since = 0;
+            }
+
+            // 一直有线程空闲，每个空闲周期退役一个线程
+            if (threads > m_minThreads && m_idleThreads > 0)
+            {
+                idle_since = idle_since ? idle_since : now;
+                if (now - idle_since >= m_retireIdleMs)
+                {
+                    setThreadCount(threads - 1);
+                    idle_since = 0;
+                }
+            }
+            else
+            {
+                idle_since = 0;
+            }
+        }
+    }
+
+    void Scheduler::watchdog()
+    {
+        // 检查间隔取时间片和报告阈值中较小的一个的一半，抢占请求最多比时间片晚半个间隔
+        uint64_t limit = std::min(m_preemptSliceUs ? m_preemptSliceUs : ~0ull, m_longRunUs ? m_longRunUs : ~0ull);
+        uint64_t interval = std::max<uint64_t>(limit / 2, 100);
+        while (!m_stop)
+        {
+            usleep(interval);
+            uint64_t now = GetCurrentUS();
+            for (size_t i = 0; i < m_slices.size(); ++i)
+            {
+                Slice *slice = m_slices[i].get();
+                uint64_t start = slice->start.load(std::memory_order_relaxed);
+                if (!start || now < start)
+                {
+                    continue;
+                }
+                uint64_t run_us = now - start;
+                if (m_preemptSliceUs && run_us >= m_preemptSliceUs &&
+                    !slice->preempt.exchange(true, std::memory_order_relaxed))
+                {
+                    m_preemptRequests.fetch_add(1, std::memory_order_relaxed);
+                }
+                // 每个运行片只报告一次
+                if (m_longRunUs && run_us >= m_longRunUs && slice->reported != start)
+                {
+                    slice->reported = start;
+                    m_longRuns.fetch_add(1, std::memory_order_relaxed);
+                    DBSPIDER_LOG_WARN(g_logger) << "fiber id=" << slice->fiber.load(std::memory_order_relaxed)
+                                                << " has held thread " << m_name << "_" << i << " for "
+                                                << run_us / 1000 << " ms without yielding";
+                }
+            }
+        }
     }
 
     // 返回是否可以停止
     bool Scheduler::stopping()
     {
-        MutexType::Lock lock(m_mutex);
-        return m_stop && m_tasks.empty() && m_activeThreads == 0;
+        {
+            MutexType::Lock lock(m_mutex);
+            if (!m_stop || !m_tasks.empty() || !m_highTasks.empty() || (m_inject && !m_inject->empty()) ||
+                m_activeThreads != 0)
+            {
+                return false;
+            }
+        }
+        for (auto *queues : {&m_localQueues, &m_pinnedQueues, &m_pinnedHighQueues})
+        {
+            for (auto &q : *queues)
+            {
+                LocalQueue::MutexType::Lock lock(q->mutex);
+                if (!q->tasks.empty())
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
     }
 
     // 协程无任务可调度时执行wait协程
@@ -1,6 +1,8 @@
 #include "thread.h"
 #include "util.h"
 #include "log.h"
+
+#include <sched.h>
 // #include "fiber.h"
 
 namespace dbspider
@@ -12,6 +14,12 @@ namespace dbspider
 
     // 构造函数  线程名字和回调函数
     Thread::Thread(const std::string &name, callback cb)
+        : Thread(name, std::move(cb), {})
+    {
+    }
+
+    Thread::Thread(const std::string &name, callback cb, const std::vector<int> &cpus)
+        : m_cpus(cpus)
     {
         m_name = name.empty() ? "UNKNOWN" : name;
         m_cb = std::move(cb);
@@ -54,6 +62,11 @@ namespace dbspider
         t_thread_name = thread->m_name;
         thread->m_id = dbspider::GetThreadId();
         pthread_setname_np(thread->m_thread, thread->m_name.substr(0, 15).c_str());
+        // 在通知创建者之前绑定，构造函数返回时线程已经运行在指定的 CPU 上
+        if (!thread->m_cpus.empty() && !SetAffinity(thread->m_cpus))
+        {
+            DBSPIDER_LOG_WARN(g_logger) << "thread " << thread->m_name << " set affinity fail";
+        }
         callback cb;
         cb.swap(thread->m_cb);
         thread->m_sem.notify();
@@ -84,4 +97,49 @@ namespace dbspider
         }
         t_thread_name = name;
     }
-}
\ No newline at end of file
+
+    bool Thread::SetAffinity(const std::vector<int> &cpus)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        int count = 0;
+        for (int cpu : cpus)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &set);
+                ++count;
+            }
+        }
+        if (!count)
+        {
+            return false;
+        }
+        int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (res)
+        {
+            DBSPIDER_LOG_ERROR(g_logger) << "pthread_setaffinity_np fail with code=" << res;
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<int> Thread::GetAffinity()
+    {
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set))
+        {
+            return cpus;
+        }
+        for (int i = 0; i < CPU_SETSIZE; ++i)
+        {
+            if (CPU_ISSET(i, &set))
+            {
+                cpus.push_back(i);
+            }
+        }
+        return cpus;
+    }
+}
@@ -4,129 +4,154 @@
 namespace dbspider
 {
 
-    Timer::Timer(uint64_t next)
-        : m_next(next)
+    // ms 转换为 us，溢出时取最大值
+    static uint64_t ms_to_us(uint64_t ms)
     {
+        return ms > ~0ull / 1000 ? ~0ull : ms * 1000;
     }
 
-    Timer::Timer(uint64_t ms,
+    // 当前时间加上间隔，溢出时取最大值
+    static uint64_t deadline(uint64_t start, uint64_t us)
+    {
+        return us > ~0ull - start ? ~0ull : start + us;
+    }
+
+    Timer::Timer(uint64_t us,
                  std::function<void()> cb,
                  bool recurring,
-                 TimeManager *timeManager)
-        : m_ms(ms),
+                 TimeManager *timeManager,
+                 TimerShard *shard)
+        : m_us(us),
           m_cb(cb),
           m_recurring(recurring),
-          m_manager(timeManager)
+          m_manager(timeManager),
+          m_shard(shard)
     {
-        m_next = GetCurrentMS() + m_ms;
+        m_next = deadline(GetCurrentUS(), m_us);
     }
 
     // 取消定时器
     bool Timer::cancel()
     {
-        TimeManager::MutexType::Lock lock(m_manager->m_mutex);
+        Timer::ptr self;
+        TimerShard::MutexType::Lock lock(m_shard->mutex);
         if (m_cb)
         {
-            auto it = m_manager->m_timers.find(shared_from_this());
-            m_manager->m_timers.erase(it);
+            m_cb = nullptr;
+            self = m_manager->unlink(this);
             return true;
         }
         return false;
     }
 
+    void Timer::setPriority(Fiber::Priority priority)
+    {
+        TimerShard::MutexType::Lock lock(m_shard->mutex);
+        m_priority = priority;
+    }
+
     // 刷新设置定时器的执行时间
     bool Timer::refresh()
     {
-        TimeManager::MutexType::Lock lock(m_manager->m_mutex);
-        if (!m_cb)
-        {
-            return false;
-        }
-        auto it = m_manager->m_timers.find(shared_from_this());
-        if (it == m_manager->m_timers.end())
+        TimerShard::MutexType::Lock lock(m_shard->mutex);
+        if (!m_cb || !m_slot)
         {
             return false;
         }
-        m_manager->m_timers.erase(it);
-        m_next = GetCurrentMS() + m_ms;
-        m_manager->m_timers.insert(shared_from_this());
+        m_shard->wheel.remove(this);
+        m_next = deadline(GetCurrentUS(), m_us);
+        m_shard->wheel.add(this);
+        uint64_t next = m_next;
+        lock.unlock();
 
-        return false;
+        m_manager->checkFront(next);
+        return true;
     }
 
     // 重置定时器时间
     bool Timer::reset(uint64_t ms, bool now_time)
     {
-        if (ms == m_ms && now_time == false)
+        return resetUS(ms_to_us(ms), now_time);
+    }
+
+    bool Timer::resetUS(uint64_t us, bool now_time)
+    {
+        if (us == m_us && now_time == false)
         {
             return true;
         }
-        TimeManager::MutexType::Lock lock(m_manager->m_mutex);
+        TimerShard::MutexType::Lock lock(m_shard->mutex);
         if (!m_cb)
         {
             return false;
         }
 
-        auto it = m_manager->m_timers.find(shared_from_this());
-        if (it != m_manager->m_timers.end())
-        {
-            m_manager->m_timers.erase(it);
-        }
+        Timer::ptr self = m_manager->unlink(this);
         uint64_t start = 0;
         if (now_time)
         {
-            start = dbspider::GetCurrentMS();
+            start = dbspider::GetCurrentUS();
         }
         else
         {
-            start = m_next - m_ms;
+            start = m_next - m_us;
         }
-        m_ms = ms;
-        m_next = start + m_ms;
-        m_manager->addTimer(shared_from_this(), lock);
+        m_us = us;
+        m_next = deadline(start, m_us);
+        m_self = std::move(self);
+        m_manager->link(this);
+        uint64_t next = m_next;
+        lock.unlock();
 
+        m_manager->checkFront(next);
         return true;
     }
 
-    bool Timer::Compare::operator()(const Timer::ptr &lhs, const Timer::ptr &rhs) const
+    TimeManager::TimeManager(size_t shards)
     {
-        if (!lhs && !rhs)
-        {
-            return false;
-        }
-        if (!lhs)
-        {
-            return true;
-        }
-        if (!rhs)
+        uint64_t now = GetCurrentUS();
+        for (size_t i = 0; i < std::max<size_t>(shards, 1); ++i)
         {
-            return false;
-        }
-        if (lhs->m_next < rhs->m_next)
-        {
-            return true;
+            m_shards.emplace_back(new TimerShard(now));
         }
-        if (rhs->m_next < lhs->m_next)
+    }
+
+    TimeManager::~TimeManager()
+    {
+        // 打断定时器对自己的引用
+        for (auto &shard : m_shards)
         {
-            return false;
+            std::vector<Timer *> timers;
+            shard->wheel.clear(timers);
+            for (Timer *timer : timers)
+            {
+                timer->m_cb = nullptr;
+                timer->m_self.reset();
+            }
         }
-        return lhs.get() < rhs.get();
     }
 
-    TimeManager::TimeManager()
+    // 添加定时器
+    Timer::ptr TimeManager::addTimer(uint64_t ms, std::function<void()> cb, bool recurring)
     {
+        return addTimerUS(ms_to_us(ms), std::move(cb), recurring);
     }
 
-    TimeManager::~TimeManager()
+    Timer::ptr TimeManager::addTimerNS(uint64_t ns, std::function<void()> cb, bool recurring)
     {
+        return addTimerUS(ns / 1000 + (ns % 1000 != 0), std::move(cb), recurring);
     }
 
-    // 添加定时器
-    Timer::ptr TimeManager::addTimer(uint64_t ms, std::function<void()> cb, bool recurring)
+    Timer::ptr TimeManager::addTimerUS(uint64_t us, std::function<void()> cb, bool recurring)
     {
-        Timer::ptr timer(new Timer(ms, cb, recurring, this));
-        MutexType::Lock lock(m_mutex);
-        addTimer(timer, lock);
+        TimerShard *shard = m_shards[getTimerShard() % m_shards.size()].get();
+        Timer::ptr timer(new Timer(us, cb, recurring, this, shard));
+        {
+            TimerShard::MutexType::Lock lock(shard->mutex);
+            timer->m_self = timer;
+            link(timer.get());
+        }
+        checkFront(timer->m_next);
         return timer;
     }
 
@@ -136,8 +161,16 @@ namespace dbspider
                                               std::weak_ptr<void> cond,
                                               bool recurring)
     {
-        return addTimer(
-            ms,
+        return addConditionTimerUS(ms_to_us(ms), std::move(cb), std::move(cond), recurring);
+    }
+
+    Timer::ptr TimeManager::addConditionTimerUS(uint64_t us,
+                                                std::function<void()> cb,
+                                                std::weak_ptr<void> cond,
+                                                bool recurring)
+    {
+        return addTimerUS(
+            us,
             [cb, cond]()
             {
                 std::shared_ptr<void> tmp = cond.lock();
@@ -152,77 +185,128 @@ namespace dbspider
     // 到最近一个定时器执行的时间间隔(ms)
     uint64_t TimeManager::getNextTimer()
     {
-        MutexType::Lock lock(m_mutex);
-        if (m_timers.empty())
+        uint64_t us = getNextTimerUS();
+        return us == ~0ull ? ~0ull : (us + 999) / 1000;
+    }
+
+    uint64_t TimeManager::getNextTimerUS()
+    {
+        if (m_count == 0)
         {
+            m_wakeup = ~0ull;
             return ~0ull;
         }
-        m_tickled = false;
-        Timer::ptr timer = *m_timers.begin();
-        uint64_t now = GetCurrentMS();
-        if (now >= timer->m_next)
+        // 扫描之前先清空醒来时间，扫描期间加入的定时器一定能在 checkFront 中 CAS 成功并唤醒，不会漏掉
+        m_wakeup = ~0ull;
+        uint64_t next = ~0ull;
+        for (auto &shard : m_shards)
         {
-            return 0;
+            TimerShard::MutexType::Lock lock(shard->mutex);
+            next = std::min(next, shard->wheel.nextExpire());
         }
-        else
+        // 扫描期间加入的更早的定时器已经写入了 m_wakeup ，只能往早改
+        uint64_t wakeup = m_wakeup;
+        while (next < wakeup && !m_wakeup.compare_exchange_weak(wakeup, next))
         {
-            return timer->m_next - now;
         }
+        if (next == ~0ull)
+        {
+            return ~0ull;
+        }
+        uint64_t now = GetCurrentUS();
+        return now >= next ? 0 : next - now;
     }
 
     // 获取需要执行的定时器的回调函数列表
     void TimeManager::getExpiredCallbacks(std::vector<std::function<void()>> &cbs)
     {
-        uint64_t now = GetCurrentMS();
-        std::vector<Timer::ptr> expired;
+        getExpiredCallbacks(cbs, cbs);
+    }
 
-        MutexType::Lock lock(m_mutex);
-        if (m_timers.empty())
+    void TimeManager::getExpiredCallbacks(std::vector<std::function<void()>> &cbs,
+                                          std::vector<std::function<void()>> &high_cbs)
+    {
+        if (m_count == 0)
         {
             return;
         }
-        Timer::ptr timer(new Timer(now));
-
-        auto it = m_timers.lower_bound(timer);
-        while (it != m_timers.end() && (*it)->m_next == now)
+        uint64_t now = GetCurrentUS();
+        // 记录的醒来时间已经过去，清空它，之后加入的定时器不论多晚都会唤醒空闲线程重新计算
+        uint64_t wakeup = m_wakeup;
+        if (wakeup <= now)
         {
-            ++it;
+            m_wakeup.compare_exchange_strong(wakeup, ~0ull);
         }
-        expired.insert(expired.begin(), m_timers.begin(), it);
-        m_timers.erase(m_timers.begin(), it);
-
-        cbs.reserve(expired.size());
-
-        for (auto &i : expired)
+        size_t own = getTimerShard() % m_shards.size();
+        std::vector<Timer *> expired;
+        std::vector<Timer::ptr> released;
+        for (size_t i = 0; i < m_shards.size(); ++i)
         {
-            cbs.push_back(i->m_cb);
-            if (i->m_recurring)
+            // 先处理自己的分片，别的分片正被占用时跳过，留给下一轮或它所在的线程处理
+            TimerShard *shard = m_shards[(own + i) % m_shards.size()].get();
+            if (i == 0)
             {
-                i->m_next = now + i->m_ms;
-                m_timers.insert(i);
+                shard->mutex.lock();
+            }
+            else if (!shard->mutex.tryLock())
+            {
+                continue;
+            }
+            expired.clear();
+            shard->wheel.advance(now, expired);
+            for (Timer *timer : expired)
+            {
+                (timer->m_priority == Fiber::HIGH ? high_cbs : cbs).push_back(timer->m_cb);
+                if (timer->m_recurring)
+                {
+                    timer->m_next = deadline(now, timer->m_us);
+                    shard->wheel.add(timer);
+                }
+                else
+                {
+                    // 已经触发的定时器不再持有回调，之后的 cancel/refresh/reset 直接返回
+                    timer->m_cb = nullptr;
+                    released.push_back(std::move(timer->m_self));
+                    --m_count;
+                }
             }
+            shard->mutex.unlock();
         }
     }
 
     // 是否有定时器
     bool TimeManager::hasTimer()
     {
-        MutexType::Lock lock(m_mutex);
-        return m_timers.size();
+        return m_count != 0;
     }
 
-    // 将定时器添加到管理器中
-    void TimeManager::addTimer(Timer::ptr timer, MutexType::Lock &lock)
+    void TimeManager::link(Timer *timer)
     {
-        auto it = m_timers.insert(timer).first;
-        bool at_front = (it == m_timers.begin()) && !m_tickled;
-        if (at_front)
+        timer->m_shard->wheel.add(timer);
+        ++m_count;
+    }
+
+    Timer::ptr TimeManager::unlink(Timer *timer)
+    {
+        if (!timer->m_slot)
         {
-            m_tickled = true;
+            return nullptr;
         }
-        if (at_front)
+        timer->m_shard->wheel.remove(timer);
+        --m_count;
+        return std::move(timer->m_self);
+    }
+
+    void TimeManager::checkFront(uint64_t next)
+    {
+        uint64_t wakeup = m_wakeup;
+        while (next < wakeup)
         {
-            onInsertAtFront();
+            if (m_wakeup.compare_exchange_weak(wakeup, next))
+            {
+                onInsertAtFront();
+                return;
+            }
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include "timing_wheel.h"
+#include "timer.h"
+
+namespace dbspider
+{
+    // 在 words 个字组成的环形位图中，从 start 开始查找第一个置位的位，返回与 start 的距离，没有返回 -1
+    static int64_t find_next_bit(const uint64_t *bits, size_t words, size_t start)
+    {
+        size_t size = words * 64;
+        size_t pos = start;
+        size_t scanned = 0;
+        while (scanned < size)
+        {
+            uint64_t word = bits[pos / 64] >> (pos % 64);
+            if (word)
+            {
+                size_t offset = scanned + __builtin_ctzll(word);
+                return offset < size ? (int64_t)offset : -1;
+            }
+            size_t step = 64 - pos % 64;
+            scanned += step;
+            pos = (pos + step) % size;
+        }
+        return -1;
+    }
+
+    TimingWheel::TimingWheel(uint64_t now)
+        : m_current(now)
+    {
+    }
+
+    void TimingWheel::add(Timer *timer)
+    {
+        ++m_size;
+        place(timer, false);
+    }
+
+    void TimingWheel::remove(Timer *timer)
+    {
+        Slot *slot = timer->m_slot;
+        if (!slot)
+        {
+            return;
+        }
+        if (timer->m_prevNode)
+        {
+            timer->m_prevNode->m_nextNode = timer->m_nextNode;
+        }
+        else
+        {
+            slot->head = timer->m_nextNode;
+        }
+        if (timer->m_nextNode)
+        {
+            timer->m_nextNode->m_prevNode = timer->m_prevNode;
+        }
+        timer->m_prevNode = nullptr;
+        timer->m_nextNode = nullptr;
+        timer->m_slot = nullptr;
+        --m_size;
+        uint64_t mask = 0;
+        uint64_t *bits = bitmap(slot, mask);
+        if (bits && !slot->head)
+        {
+            *bits &= ~mask;
+        }
+    }
+
+    void TimingWheel::advance(uint64_t now, std::vector<Timer *> &expired)
+    {
+        collect(&m_ready, expired);
+        while (m_current < now && m_size)
+        {
+            // 直接跳到下一个有定时器到期或者需要级联的时间，中间的空槽不用逐个扫描
+            uint64_t next = nextExpire();
+            if (next > now)
+            {
+                break;
+            }
+            m_current = next;
+            size_t index = m_current & (ROOT_SIZE - 1);
+            if (index == 0)
+            {
+                // 第 0 层转完一圈，从第 1 层开始逐层级联，上一层的下标不为 0 时停止
+                for (int level = 1; level < LEVELS; ++level)
+                {
+                    int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+                    size_t level_index = (m_current >> shift) & (LEVEL_SIZE - 1);
+                    cascade(level, level_index);
+                    if (level_index != 0)
+                    {
+                        break;
+                    }
+                }
+            }
+            collect(&m_root[index], expired);
+            collect(&m_ready, expired);
+        }
+        if (m_current < now)
+        {
+            m_current = now;
+        }
+    }
+
+    void TimingWheel::clear(std::vector<Timer *> &timers)
+    {
+        auto drain = [&timers](Slot &slot)
+        {
+            for (Timer *timer = slot.head; timer;)
+            {
+                Timer *next = timer->m_nextNode;
+                timer->m_prevNode = nullptr;
+                timer->m_nextNode = nullptr;
+                timer->m_slot = nullptr;
+                timers.push_back(timer);
+                timer = next;
+            }
+            slot.head = nullptr;
+        };
+        drain(m_ready);
+        for (Slot &slot : m_root)
+        {
+            drain(slot);
+        }
+        for (auto &level : m_levels)
+        {
+            for (Slot &slot : level)
+            {
+                drain(slot);
+            }
+        }
+        std::fill(std::begin(m_rootBits), std::end(m_rootBits), 0);
+        std::fill(std::begin(m_levelBits), std::end(m_levelBits), 0);
+        m_size = 0;
+    }
+
+    uint64_t TimingWheel::nextExpire() const
+    {
+        if (m_size == 0)
+        {
+            return ~0ull;
+        }
+        if (m_ready.head)
+        {
+            return m_current;
+        }
+        // 上层的定时器在所在槽级联之前不会到期
+        return std::min(nextRoot(), nextCascade());
+    }
+
+    uint64_t TimingWheel::nextRoot() const
+    {
+        // 第 0 层的定时器都在 (m_current, m_current + ROOT_SIZE) 内，槽对应的就是精确的执行时间
+        int64_t offset = find_next_bit(m_rootBits, ROOT_SIZE / 64, (m_current + 1) & (ROOT_SIZE - 1));
+        if (offset < 0 || offset >= (int64_t)ROOT_SIZE - 1)
+        {
+            return ~0ull;
+        }
+        return m_current + 1 + offset;
+    }
+
+    uint64_t TimingWheel::nextCascade() const
+    {
+        uint64_t next = ~0ull;
+        for (int level = 1; level < LEVELS; ++level)
+        {
+            if (!m_levelBits[level - 1])
+            {
+                continue;
+            }
+            // 第 level 层的槽 (base + k) 在时间 (base + k) << shift 级联，当前槽要等转完一整圈
+            int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+            uint64_t base = m_current >> shift;
+            int64_t offset = find_next_bit(&m_levelBits[level - 1], 1, (base + 1) & (LEVEL_SIZE - 1));
+            next = std::min(next, (base + 1 + offset) << shift);
+        }
+        return next;
+    }
+
+    void TimingWheel::place(Timer *timer, bool cascading)
+    {
+        uint64_t expire = timer->m_next;
+        // 已经处理过的时刻不会再被扫描，直接放进就绪链表；级联时当前时刻的槽还没有扫描
+        if (expire < m_current || (!cascading && expire == m_current))
+        {
+            link(&m_ready, timer);
+            return;
+        }
+        uint64_t delta = expire - m_current;
+        if (delta < ROOT_SIZE)
+        {
+            link(&m_root[expire & (ROOT_SIZE - 1)], timer);
+            return;
+        }
+        // 超出时间轮范围的定时器先放在最远的位置，级联时按真实的执行时间重新放置
+        const uint64_t max_delta = (1ull << (ROOT_BITS + (LEVELS - 1) * LEVEL_BITS)) - 1;
+        if (delta > max_delta)
+        {
+            delta = max_delta;
+            expire = m_current + max_delta;
+        }
+        for (int level = 1; level < LEVELS; ++level)
+        {
+            int shift = ROOT_BITS + level * LEVEL_BITS;
+            if (delta < (1ull << shift) || level == LEVELS - 1)
+            {
+                size_t index = (expire >> (shift - LEVEL_BITS)) & (LEVEL_SIZE - 1);
+                link(&m_levels[level - 1][index], timer);
+                return;
+            }
+        }
+    }
+
+    void TimingWheel::cascade(int level, size_t index)
+    {
+        Timer *timer = take(&m_levels[level - 1][index]);
+        while (timer)
+        {
+            Timer *next = timer->m_nextNode;
+            timer->m_prevNode = nullptr;
+            timer->m_nextNode = nullptr;
+            timer->m_slot = nullptr;
+            place(timer, true);
+            timer = next;
+        }
+    }
+
+    void TimingWheel::collect(Slot *slot, std::vector<Timer *> &expired)
+    {
+        Timer *timer = take(slot);
+        while (timer)
+        {
+            Timer *next = timer->m_nextNode;
+            timer->m_prevNode = nullptr;
+            timer->m_nextNode = nullptr;
+            timer->m_slot = nullptr;
+            expired.push_back(timer);
+            --m_size;
+            timer = next;
+        }
+    }
+
+    void TimingWheel::link(Slot *slot, Timer *timer)
+    {
+        timer->m_slot = slot;
+        timer->m_prevNode = nullptr;
+        timer->m_nextNode = slot->head;
+        if (slot->head)
+        {
+            slot->head->m_prevNode = timer;
+        }
+        slot->head = timer;
+        uint64_t mask = 0;
+        uint64_t *bits = bitmap(slot, mask);
+        if (bits)
+        {
+            *bits |= mask;
+        }
+    }
+
+    Timer *TimingWheel::take(Slot *slot)
+    {
+        Timer *head = slot->head;
+        slot->head = nullptr;
+        uint64_t mask = 0;
+        uint64_t *bits = bitmap(slot, mask);
+        if (bits)
+        {
+            *bits &= ~mask;
+        }
+        return head;
+    }
+
+    uint64_t *TimingWheel::bitmap(Slot *slot, uint64_t &mask)
+    {
+        if (slot >= m_root && slot < m_root + ROOT_SIZE)
+        {
+            size_t index = slot - m_root;
+            mask = 1ull << (index % 64);
+            return &m_rootBits[index / 64];
+        }
+        if (slot >= &m_levels[0][0] && slot < &m_levels[0][0] + (LEVELS - 1) * LEVEL_SIZE)
+        {
+            size_t index = slot - &m_levels[0][0];
+            mask = 1ull << (index % LEVEL_SIZE);
+            return &m_levelBits[index / LEVEL_SIZE];
+        }
+        return nullptr;
+    }
+}
@@ -2,8 +2,10 @@
 // Created by zavier on 2021/12/6.
 //
 #include <netinet/tcp.h>
+#include "config.h"
 #include "fd_manager.h"
 #include "hook.h"
+#include "io_awaitable.h"
 #include "log.h"
 #include "macro.h"
 #include "socket.h"
@@ -12,6 +14,10 @@ namespace dbspider
 {
     static Logger::ptr g_logger = DBSPIDER_LOG_NAME("system");
 
+    static ConfigVar<uint32_t>::ptr g_tcp_busy_poll_us =
+        Config::Lookup<uint32_t>("tcp.busy_poll_us", 0,
+                                 "SO_BUSY_POLL microseconds for tcp sockets, 0 disables busy polling");
+
     Socket::Socket(int family, int type, int protocol)
         : m_sock(-1),
           m_family(family),
@@ -33,7 +39,7 @@ namespace dbspider
 
     uint64_t Socket::getSendTimeout()
     {
-        FdCtx::ptr ctx = FdMgr::GetInstance()->get(m_sock);
+        FdCtx *ctx = FdMgr::GetInstance()->get(m_sock);
         if (ctx)
         {
             return ctx->getSendTimeout();
@@ -49,7 +55,7 @@ namespace dbspider
 
     uint64_t Socket::getRecvTimeout()
     {
-        FdCtx::ptr ctx = FdMgr::GetInstance()->get(m_sock);
+        FdCtx *ctx = FdMgr::GetInstance()->get(m_sock);
         if (ctx)
         {
             return ctx->getRecvTimeout();
@@ -85,7 +91,7 @@ namespace dbspider
 
     bool Socket::init(int sock)
     {
-        FdCtx::ptr ctx = FdMgr::GetInstance()->get(sock);
+        FdCtx *ctx = FdMgr::GetInstance()->get(sock);
         if (ctx && ctx->isSocket() && !ctx->isClose())
         {
             m_sock = sock;
@@ -105,6 +111,17 @@ namespace dbspider
         if (m_type == SOCK_STREAM)
         {
             setOption(IPPROTO_TCP, TCP_NODELAY, &val);
+            int busy_poll = g_tcp_busy_poll_us->getValue();
+            if (busy_poll > 0 && setsockopt(m_sock, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll)))
+            {
+                // 调大 SO_BUSY_POLL 需要 CAP_NET_ADMIN，失败时只提示一次
+                static std::atomic<bool> s_warned{false};
+                if (!s_warned.exchange(true))
+                {
+                    DBSPIDER_LOG_WARN(g_logger) << "setsockopt SO_BUSY_POLL=" << busy_poll << " errno=" << errno
+                                                << " errstr=" << strerror(errno);
+                }
+            }
         }
     }
 
@@ -138,7 +155,7 @@ namespace dbspider
         return nullptr;
     }
 
-    bool Socket::bind(const Address::ptr address)
+    bool Socket::bind(const Address::ptr address, bool reuse_port)
     {
         if (DBSPIDER_UNLIKELY(!isValid()))
         {
@@ -149,6 +166,15 @@ namespace dbspider
             }
         }
 
+        if (reuse_port)
+        {
+            int val = 1;
+            if (!setOption(SOL_SOCKET, SO_REUSEPORT, &val))
+            {
+                return false;
+            }
+        }
+
         if (DBSPIDER_UNLIKELY(m_family != address->getFamily()))
         {
             DBSPIDER_LOG_ERROR(g_logger) << "bind sock.family(" << m_family << ") address.family(" << address->getFamily() << ")"
@@ -295,6 +321,24 @@ namespace dbspider
         return -1;
     }
 
+    Task<ssize_t> Socket::asyncSend(const void *buffer, size_t length, int flags)
+    {
+        if (!isConnected())
+        {
+            co_return -1;
+        }
+        co_return co_await AsyncSend(m_sock, buffer, length, flags);
+    }
+
+    Task<ssize_t> Socket::asyncRecv(void *buffer, size_t length, int flags)
+    {
+        if (!isConnected())
+        {
+            co_return -1;
+        }
+        co_return co_await AsyncRecv(m_sock, buffer, length, flags);
+    }
+
     ssize_t Socket::recv(iovec *buffers, size_t length, int flags)
     {
         if (isConnected())
@@ -514,4 +558,4 @@ namespace dbspider
         return res;
     }
 
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -1,4 +1,7 @@
+#include <sys/socket.h>
+
 #include "config.h"
+#include "fd_manager.h"
 #include "log.h"
 #include "tcp_server.h"
 
@@ -10,12 +13,22 @@ namespace dbspider
         Config::Lookup<uint64_t>("tcp_server.recv_timeout",
                                  (uint64_t)(60 * 1000 * 2), "tcp server recv timeout");
 
+    static ConfigVar<std::string>::ptr g_tcp_server_balance =
+        Config::Lookup<std::string>("tcp_server.balance", "round_robin",
+                                    "tcp server connection balance in multi reactor mode, round_robin or least_loaded");
+
+    static ConfigVar<bool>::ptr g_tcp_server_reuse_port =
+        Config::Lookup<bool>("tcp_server.reuse_port", false,
+                             "tcp server open one SO_REUSEPORT listener per accept thread");
+
     TcpServer::TcpServer(IOManager *worker, IOManager *accept_worker)
         : m_worker(worker),
           m_acceptWorker(accept_worker),
           m_recvTimeout(g_tcp_server_recv_timeout->getValue()),
           m_name("dbspider/1.0.0"),
-          m_isStop(true)
+          m_isStop(true),
+          m_leastLoaded(g_tcp_server_balance->getValue() == "least_loaded"),
+          m_reusePort(g_tcp_server_reuse_port->getValue())
     {
     }
 
@@ -37,26 +50,34 @@ namespace dbspider
 
     bool TcpServer::bind(const std::vector<Address::ptr> &addrs, std::vector<Address::ptr> &fail)
     {
+        // SO_REUSEPORT 模式下每个地址为每个accept线程各开一个监听socket
+        size_t acceptors = m_reusePort ? m_acceptWorker->getThreadCount() : 1;
         for (Address::ptr addr : addrs)
         {
-            Socket::ptr sock = Socket::CreateTCP(addr);
-            if (!sock->bind(addr))
-            {
-                DBSPIDER_LOG_ERROR(g_logger) << "bind fail errno="
-                                             << errno << " errstr=" << strerror(errno)
-                                             << " addr=[" << addr->toString() << "]";
-                fail.push_back(addr);
-                continue;
-            }
-            if (!sock->listen())
+            Address::ptr bind_addr = addr;
+            for (size_t i = 0; i < acceptors; ++i)
             {
-                DBSPIDER_LOG_ERROR(g_logger) << "listen fail errno="
-                                             << errno << " errstr=" << strerror(errno)
-                                             << " addr=[" << addr->toString() << "]";
-                fail.push_back(addr);
-                continue;
+                Socket::ptr sock = Socket::CreateTCP(addr);
+                if (!sock->bind(bind_addr, m_reusePort))
+                {
+                    DBSPIDER_LOG_ERROR(g_logger) << "bind fail errno="
+                                                 << errno << " errstr=" << strerror(errno)
+                                                 << " addr=[" << bind_addr->toString() << "]";
+                    fail.push_back(addr);
+                    break;
+                }
+                if (!sock->listen())
+                {
+                    DBSPIDER_LOG_ERROR(g_logger) << "listen fail errno="
+                                                 << errno << " errstr=" << strerror(errno)
+                                                 << " addr=[" << bind_addr->toString() << "]";
+                    fail.push_back(addr);
+                    break;
+                }
+                m_listens.push_back(sock);
+                // 端口为0时由内核分配，其余监听socket绑定到同一个端口
+                bind_addr = sock->getLocalAddress();
             }
-            m_listens.push_back(sock);
         }
         if (!fail.empty())
         {
@@ -79,14 +100,20 @@ namespace dbspider
         }
         m_isStop = false;
         TcpServer::ptr self = shared_from_this();
-        for (auto &sock : m_listens)
+        size_t threads = m_acceptWorker->getThreadCount();
+        m_acceptLoops.add(m_listens.size());
+        for (size_t i = 0; i < m_listens.size(); ++i)
         {
+            Socket::ptr sock = m_listens[i];
+            // SO_REUSEPORT 模式下每个监听socket的accept循环固定在一个线程上
             m_acceptWorker->submit(
                 [self, sock]
                 {
                     DBSPIDER_LOG_DEBUG(g_logger) << "acceptWorker->submit";
                     self->startAccept(sock);
-                });
+                    self->m_acceptLoops.done();
+                },
+                m_reusePort ? m_acceptWorker->getThreadId(i % threads) : -1);
         }
         DBSPIDER_LOG_DEBUG(g_logger) << "TcpServer::start()";
 
@@ -106,9 +133,16 @@ namespace dbspider
         m_acceptWorker->submit(
             [self, this]
             {
+                // shutdown 之后监听socket一直是就绪的，accept 立即返回 EINVAL，
+                // 不管accept协程已经挂起还是正要挂起都能醒来；fd 号不释放，不会和正在进行的 accept 冲突
+                for (auto &sock : m_listens)
+                {
+                    ::shutdown(sock->getSocket(), SHUT_RDWR);
+                }
+                // 所有accept循环退出之后才关闭，不会有协程还挂在已经关闭、甚至被复用的fd上
+                m_acceptLoops.wait();
                 for (auto &sock : m_listens)
                 {
-                    sock->cancelAll();
                     sock->close();
                 }
             });
@@ -117,17 +151,52 @@ namespace dbspider
     void TcpServer::startAccept(Socket::ptr sock)
     {
         TcpServer::ptr self = shared_from_this();
+        // 监听socket可能是在未开启hook的线程上创建的，这里登记到FdManager中设为非阻塞，
+        // 否则accept会阻塞住整个调度线程，多 reactor 模式下该线程负责的连接都得不到处理
+        FdMgr::GetInstance()->get(sock->getSocket(), true);
         while (!isStop())
         {
             Socket::ptr client = sock->accept();
             if (client)
             {
                 client->setRecvTimeout(m_recvTimeout);
-                m_worker->submit(
-                    [self, client]
+                int index = -1;
+                if (m_reusePort && m_worker == m_acceptWorker)
+                {
+                    // 每个线程有自己的监听socket，连接就在接受它的线程上处理
+                    index = m_worker->getCurrentIndex();
+                }
+                else if (m_worker->isMultiReactor())
+                {
+                    index = selectWorkerThread();
+                }
+                if (index >= 0)
+                {
+                    // 连接在整个生命周期内属于一个调度线程，多 reactor 模式下事件只在该线程的epoll上等待，处理协程也在该线程执行
+                    if (m_worker->isMultiReactor())
                     {
-                        self->handleClient(client);
-                    });
+                        m_worker->setFdOwner(client->getSocket(), index);
+                    }
+                    m_worker->submit(
+                        [self, client]
+                        {
+                            self->handleClient(client);
+                        },
+                        m_worker->getThreadId(index));
+                }
+                else
+                {
+                    m_worker->submit(
+                        [self, client]
+                        {
+                            self->handleClient(client);
+                        });
+                }
+            }
+            else if (isStop())
+            {
+                // 停止时监听socket已经 shutdown ，accept 失败是正常退出
+                DBSPIDER_LOG_DEBUG(g_logger) << "accept loop exit, errno=" << errno << " errstr=" << strerror(errno);
             }
             else
             {
@@ -141,4 +210,22 @@ namespace dbspider
         DBSPIDER_LOG_INFO(g_logger) << "handleClient: " << client->toString();
     }
 
+    size_t TcpServer::selectWorkerThread()
+    {
+        size_t threads = m_worker->getThreadCount();
+        if (!m_leastLoaded)
+        {
+            return m_nextWorker.fetch_add(1, std::memory_order_relaxed) % threads;
+        }
+        size_t best = 0;
+        for (size_t i = 1; i < threads; ++i)
+        {
+            if (m_worker->getOwnedFdCount(i) < m_worker->getOwnedFdCount(best))
+            {
+                best = i;
+            }
+        }
+        return best;
+    }
+
 }
\ No newline at end of file
@@ -114,6 +114,7 @@ namespace dbspider::rpc
                     m_chan << proto;
                     m_isHeartClose = true; },
                 true);
+            m_heartTimer->setPriority(Fiber::HIGH);
         }
 
         return true;
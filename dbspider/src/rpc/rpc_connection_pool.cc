@@ -84,15 +84,18 @@ namespace dbspider::rpc
 
         DBSPIDER_LOG_DEBUG(g_logger) << "connect to registry: " << m_registry->getSocket()->toString();
 
+        // 与注册中心的收发（心跳、服务发现和订阅通知）属于控制面，按高优先级调度
         go[this]
         {
             // 开启 recv 协程
+            Fiber::GetThis()->setPriority(Fiber::HIGH);
             handleRecv();
         };
 
         go[this]
         {
             // 开启 send 协程
+            Fiber::GetThis()->setPriority(Fiber::HIGH);
             handleSend();
         };
 
@@ -114,6 +117,7 @@ namespace dbspider::rpc
                 m_chan << proto;
                 m_isHeartClose = true; },
             true);
+        m_heartTimer->setPriority(Fiber::HIGH);
 
         return true;
     }
@@ -109,6 +109,7 @@ namespace dbspider::rpc
                         server->m_heartTimer->cancel();
                     } },
                 true);
+            m_heartTimer->setPriority(Fiber::HIGH);
         }
 
         // 开启协程定时清理订阅列表
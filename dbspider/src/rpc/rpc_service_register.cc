@@ -88,6 +88,8 @@ namespace dbspider::rpc
     void RpcServiceRegistry::handleClient(Socket::ptr client)
     {
         DBSPIDER_LOG_DEBUG(g_logger) << "handleClient: " << client->toString();
+        // 注册中心只处理心跳、注册和订阅这些控制面请求，节点繁忙时也不能延迟，否则会误删健康的服务提供者
+        Fiber::GetThis()->setPriority(Fiber::HIGH);
         RpcSession::ptr session = std::make_shared<RpcSession>(client);
         Timer::ptr heartTimer;
         // 开启心跳定时器
@@ -1,12 +1,15 @@
 #include "fiber.h"
 #include "io_manager.h"
 #include "co_condvar.h"
+#include "cancel.h"
+#include "macro.h"
 
 namespace dbspider
 {
     void CoCondVar::notify()
     {
         Fiber::ptr fiber;
+        CoWaiter waiter;
         {
             // 获取一个等待的协程
             MutexType::Lock lock(m_mutex);
@@ -19,6 +22,12 @@ namespace dbspider
                     break;
                 }
             }
+            // 没有等待的有栈协程时唤醒一个无栈协程
+            if (!fiber && !m_coWaitQueue.empty())
+            {
+                waiter = m_coWaitQueue.front();
+                m_coWaitQueue.pop_front();
+            }
             if (m_timer)
             {
                 // 删除定时器
@@ -31,6 +40,7 @@ namespace dbspider
         {
             go fiber;
         }
+        waiter.wake();
     }
 
     void CoCondVar::notifyAll()
@@ -46,6 +56,11 @@ namespace dbspider
                 go fiber;
             }
         }
+        while (m_coWaitQueue.size())
+        {
+            m_coWaitQueue.front().wake();
+            m_coWaitQueue.pop_front();
+        }
         // 删除定时器
         if (m_timer)
         {
@@ -54,7 +69,7 @@ namespace dbspider
         }
     }
 
-    void CoCondVar::wait()
+    bool CoCondVar::wait()
     {
         Fiber::ptr self = Fiber::GetThis();
         {
@@ -69,11 +84,11 @@ namespace dbspider
             }
         }
         // 让出协程
-        Fiber::YieldToHold();
+        return park(self);
     }
 
     // 注意：协程锁解锁了才能加入到等待队列，否则别的协程无法获取锁，被唤醒后要重新获取锁
-    void CoCondVar::wait(CoMutex::Lock &lock)
+    bool CoCondVar::wait(CoMutex::Lock &lock)
     {
         Fiber::ptr self = Fiber::GetThis();
         {
@@ -91,17 +106,17 @@ namespace dbspider
         }
 
         // 让出协程
-        Fiber::YieldToHold();
+        bool woken = park(self);
         // 重新获取锁
         lock.lock();
+        return woken;
     }
 
     bool CoCondVar::waitFor(CoMutex::Lock &lock, uint64_t timeout_ms)
     {
         if (timeout_ms == (uint64_t)-1)
         {
-            wait(lock);
-            return true;
+            return wait(lock);
         }
         Fiber::ptr self = Fiber::GetThis();
         IOManager *ioManager = dbspider::IOManager::GetThis();
@@ -120,32 +135,108 @@ namespace dbspider
                 {
                     MutexType::Lock lock(m_mutex);
                     auto t = weakPtr.lock();
-                    if (!t)
+                    // 已经被 notify 或取消回调取出等待队列时不再重复调度
+                    if (!t || !m_waitQueue.erase(self))
                     {
                         return;
                     }
                     *t = true;
-                    m_waitQueue.erase(self);
                     ioManager->submit(self);
                 },
                 weakPtr);
         }
         // 让出协程
-        Fiber::YieldToHold();
+        bool woken = park(self);
         {
             MutexType::Lock lock1(m_mutex);
             if (timer && !(*timeCondition))
             {
                 timer->cancel();
             }
-            // 重新获取锁
-            lock.lock();
-            if (*timeCondition)
+        }
+        // 重新获取锁
+        lock.lock();
+        if (!woken)
+        {
+            return false;
+        }
+        if (*timeCondition)
+        {
+            // 超时
+            errno = ETIMEDOUT;
+            return false;
+        }
+        return true;
+    }
+
+    bool CoCondVar::park(const Fiber::ptr &self)
+    {
+        IOManager *ioManager = IOManager::GetThis();
+        std::shared_ptr<int> cancelled(new int{0});
+        // 回调在持有令牌锁时执行，Listener 析构后不会再执行，可以直接引用 this
+        CancelToken::Listener listener([this, fiber = self, ioManager, cancelled](int err) mutable
+                                       {
+                                           MutexType::Lock lock(m_mutex);
+                                           // 已经被 notify 或超时取出等待队列时不再重复调度
+                                           if (!m_waitQueue.erase(fiber))
+                                           {
+                                               return;
+                                           }
+                                           clearTimer();
+                                           *cancelled = err;
+                                           ioManager->submit(fiber); });
+        if (listener.cancelled())
+        {
+            int err = errno;
+            MutexType::Lock lock(m_mutex);
+            if (m_waitQueue.erase(self))
             {
-                // 超时
+                // 还没有被唤醒，不需要挂起
+                clearTimer();
+                errno = err;
                 return false;
             }
-            return true;
         }
+        Fiber::YieldToHold();
+        if (*cancelled)
+        {
+            errno = *cancelled;
+            return false;
+        }
+        return true;
+    }
+
+    void CoCondVar::clearTimer()
+    {
+        if (m_timer && m_waitQueue.empty() && m_coWaitQueue.empty())
+        {
+            m_timer->cancel();
+            m_timer = nullptr;
+        }
+    }
+
+    Task<void> CoCondVar::asyncWait(CoMutex &mutex)
+    {
+        co_await WaitAwaiter(*this, mutex);
+        // 被唤醒后重新获取锁
+        co_await mutex.asyncLock();
+    }
+
+    bool CoCondVar::WaitAwaiter::await_suspend(std::coroutine_handle<> handle)
+    {
+        Scheduler *scheduler = Scheduler::GetThis();
+        DBSPIDER_ASSERT2(scheduler, "co_await CoCondVar outside scheduler");
+        MutexType::Lock lock(m_cv.m_mutex);
+        // 将自己加入等待队列
+        m_cv.m_coWaitQueue.push_back(CoWaiter{nullptr, handle, scheduler});
+        if (!m_cv.m_timer)
+        {
+            // 加入一个空任务定时器，不让调度器退出
+            m_cv.m_timer = IOManager::GetThis()->addTimer(
+                UINT32_MAX, [] {}, true);
+        }
+        // 先解锁，唤醒需要先拿到 m_cv.m_mutex，所以在这个函数返回前协程不会被恢复
+        m_lock.unlock();
+        return true;
     }
 }
\ No newline at end of file
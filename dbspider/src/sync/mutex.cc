@@ -1,5 +1,9 @@
+#include <algorithm>
+
+#include "cancel.h"
 #include "fiber.h"
 #include "io_manager.h"
+#include "macro.h"
 #include "mutex.h"
 
 namespace dbspider
@@ -10,12 +14,24 @@ namespace dbspider
     }
 
     void CoMutex::lock()
+    {
+        doLock(false);
+    }
+
+    bool CoMutex::lockCancellable()
+    {
+        return doLock(true);
+    }
+
+    bool CoMutex::doLock(bool cancellable)
     {
         // 如果本协程已经持有锁就退出
         if (Fiber::GetFiberId() == m_fiberId)
         {
-            return;
+            return true;
         }
+        // 加锁前是抢占的安全点，Channel 的收发也经过这里
+        Fiber::MaybeYield();
         // 第一次尝试获取锁
         while (!tryLock())
         {
@@ -26,18 +42,62 @@ namespace dbspider
             {
                 m_gaurd.unlock();
                 m_fiberId = Fiber::GetFiberId();
-                return;
+                return true;
             }
             // 获取所在的协程
             Fiber::ptr self = Fiber::GetThis();
             // 将自己加入协程等待队列
-            m_waitQueue.push(self);
+            m_waitQueue.push_back(CoWaiter{self});
             m_gaurd.unlock();
-            // 让出协程
+            if (!cancellable)
+            {
+                // 让出协程
+                Fiber::YieldToHold();
+                continue;
+            }
+            // 从等待队列中移除自己，返回 false 表示已经被 unlock 取出并唤醒
+            auto remove = [this, self]
+            {
+                m_gaurd.lock();
+                auto it = std::find_if(m_waitQueue.begin(), m_waitQueue.end(),
+                                       [&self](const CoWaiter &waiter)
+                                       { return waiter.fiber == self; });
+                bool found = it != m_waitQueue.end();
+                if (found)
+                {
+                    m_waitQueue.erase(it);
+                }
+                m_gaurd.unlock();
+                return found;
+            };
+            Scheduler *scheduler = Scheduler::GetThis();
+            std::shared_ptr<int> cancelled(new int{0});
+            CancelToken::Listener listener([remove, self, scheduler, cancelled](int err) mutable
+                                           {
+                                               if (remove())
+                                               {
+                                                   *cancelled = err;
+                                                   scheduler->submit(self);
+                                               } });
+            if (listener.cancelled())
+            {
+                int err = errno;
+                if (remove())
+                {
+                    errno = err;
+                    return false;
+                }
+            }
             Fiber::YieldToHold();
+            if (*cancelled)
+            {
+                errno = *cancelled;
+                return false;
+            }
         }
         // 成功获取锁将m_fiberId改成自己的id
         m_fiberId = GetFiberId();
+        return true;
     }
 
     void CoMutex::unlock()
@@ -45,20 +105,59 @@ namespace dbspider
         m_gaurd.lock();
         m_fiberId = 0;
 
-        Fiber::ptr fiber;
+        CoWaiter waiter;
         if (!m_waitQueue.empty())
         {
             // 获取一个等待的协程
-            fiber = m_waitQueue.front();
-            m_waitQueue.pop();
+            waiter = m_waitQueue.front();
+            m_waitQueue.pop_front();
+        }
+
+        if (waiter.handle)
+        {
+            // 无栈协程恢复后不会重新抢锁，所以不释放 m_mutex，直接把锁交给它
+            m_gaurd.unlock();
+            waiter.wake();
+            return;
         }
 
         m_mutex.unlock();
         m_gaurd.unlock();
-        if (fiber)
+        if (waiter.fiber)
         {
             // 将等待的协程重新加入调度
-            go fiber;
+            waiter.wake();
+        }
+    }
+
+    bool CoMutex::LockAwaiter::await_suspend(std::coroutine_handle<> handle)
+    {
+        m_mutex.m_gaurd.lock();
+        // 与 lock() 一样，入队前再尝试一次
+        if (m_mutex.tryLock())
+        {
+            m_mutex.m_gaurd.unlock();
+            return false;
+        }
+        Scheduler *scheduler = Scheduler::GetThis();
+        DBSPIDER_ASSERT2(scheduler, "co_await CoMutex outside scheduler");
+        m_mutex.m_waitQueue.push_back(CoWaiter{nullptr, handle, scheduler});
+        m_mutex.m_gaurd.unlock();
+        return true;
+    }
+
+    void CoWaiter::wake() const
+    {
+        if (handle)
+        {
+            std::coroutine_handle<> h = handle;
+            scheduler->submit([h]
+                              { h.resume(); });
+        }
+        else if (fiber)
+        {
+            Fiber::ptr f = fiber;
+            go f;
         }
     }
 }
\ No newline at end of file
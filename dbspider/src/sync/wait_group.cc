@@ -0,0 +1,144 @@
+#include <exception>
+
+#include "cancel.h"
+#include "fiber.h"
+#include "io_manager.h"
+#include "wait_group.h"
+#include "macro.h"
+
+namespace dbspider
+{
+    void WaitGroup::add(size_t n)
+    {
+        m_pending += n;
+    }
+
+    void WaitGroup::done()
+    {
+        // 先增加完成数再减少未完成数，等待者看到未完成数为 0 时完成数已经是最终值
+        size_t finished = ++m_finished;
+        size_t pending = m_pending--;
+        DBSPIDER_ASSERT2(pending > 0, "WaitGroup::done without add");
+        // 只在等待者的条件满足时加锁唤醒，扇出 N 个任务只唤醒等待者一次
+        if (pending == 1 || finished >= m_minTarget)
+        {
+            CoMutex::Lock lock(m_mutex);
+            m_condvar.notifyAll();
+        }
+    }
+
+    void WaitGroup::wait()
+    {
+        waitFor(-1);
+    }
+
+    bool WaitGroup::waitFor(uint64_t timeout_ms)
+    {
+        waitAny(0, timeout_ms);
+        return m_pending == 0;
+    }
+
+    size_t WaitGroup::waitAny(size_t n, uint64_t timeout_ms)
+    {
+        uint64_t deadline = timeout_ms == (uint64_t)-1 ? (uint64_t)-1 : GetCurrentMS() + timeout_ms;
+        CoMutex::Lock lock(m_mutex);
+        auto it = m_targets.end();
+        if (n)
+        {
+            // 有多个等待者时按最小的目标唤醒，被唤醒的等待者各自重新检查条件
+            it = m_targets.insert(n);
+            m_minTarget = *m_targets.begin();
+        }
+        // 在持有锁的情况下检查条件，done 唤醒前要先拿到锁，所以不会错过唤醒
+        while (m_pending && (!n || m_finished < n))
+        {
+            uint64_t wait_ms = (uint64_t)-1;
+            if (deadline != (uint64_t)-1)
+            {
+                uint64_t now = GetCurrentMS();
+                if (now >= deadline)
+                {
+                    break;
+                }
+                wait_ms = deadline - now;
+            }
+            // 当前协程被取消时不再等待
+            if (!m_condvar.waitFor(lock, wait_ms) && CancelToken::Check())
+            {
+                break;
+            }
+        }
+        if (n)
+        {
+            m_targets.erase(it);
+            m_minTarget = m_targets.empty() ? SIZE_MAX : *m_targets.begin();
+        }
+        return m_finished;
+    }
+
+    FiberGroup::FiberGroup(IOManager *iom)
+        : m_iom(iom ? iom : IOManager::GetThis()),
+          m_wg(std::make_shared<WaitGroup>()),
+          m_token(CancelToken::CreateChild())
+    {
+        DBSPIDER_ASSERT2(m_iom, "FiberGroup outside IOManager");
+    }
+
+    FiberGroup::~FiberGroup()
+    {
+        cancel();
+        // 任务可能引用父协程栈上的变量，父协程被取消时也要等到任务全部结束
+        CancelToken::Scope scope(nullptr);
+        wait();
+    }
+
+    void FiberGroup::submit(SmallTask task)
+    {
+        m_iom->submit(std::move(task));
+    }
+
+    bool FiberGroup::Begin(const CancelToken::ptr &token)
+    {
+        if (token->isCancelled())
+        {
+            return false;
+        }
+        // 组内任务使用组的令牌，取消组时挂起的 IO 和等待立即返回
+        CancelToken::SetThis(token);
+        return true;
+    }
+
+    void FiberGroup::Finish(const WaitGroup::ptr &wg, std::exception_ptr ex)
+    {
+        wg->done();
+        if (ex)
+        {
+            std::rethrow_exception(ex);
+        }
+    }
+
+    void FiberGroup::wait()
+    {
+        m_wg->wait();
+    }
+
+    bool FiberGroup::waitFor(uint64_t timeout_ms)
+    {
+        return m_wg->waitFor(timeout_ms);
+    }
+
+    size_t FiberGroup::waitAny(size_t n, uint64_t timeout_ms)
+    {
+        return m_wg->waitAny(n, timeout_ms);
+    }
+
+    bool FiberGroup::isCancelled() const
+    {
+        return m_token->isCancelled();
+    }
+
+    void FiberGroup::cancel()
+    {
+        m_token->cancel();
+    }
+}
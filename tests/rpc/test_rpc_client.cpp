@@ -28,6 +28,10 @@ void test1()
     }
     auto rt = client->call<int>("add", 0, n);
     DBSPIDER_LOG_DEBUG(g_logger) << rt.toString();
+    auto art = client->call<int>("asyncAdd", 0, n);
+    DBSPIDER_LOG_DEBUG(g_logger) << art.toString();
+    auto frt = client->call<uint64_t>("fib", 90);
+    DBSPIDER_LOG_DEBUG(g_logger) << frt.toString();
     // sleep(3);
     // client->close();
     client->setTimeout(1000);
@@ -40,6 +40,27 @@ int main(int argc, char **argv)
                            {
                                sleep(2);
                            });
+    // 计算密集的处理函数放到阻塞线程池执行，不占用调度线程
+    server->registerMethod(
+        "fib",
+        [](int n)
+        {
+            uint64_t a = 0, b = 1;
+            for (int i = 0; i < n; ++i)
+            {
+                b = a + b;
+                a = b - a;
+            }
+            return a;
+        },
+        true);
+    // 无栈协程处理函数
+    server->registerMethod("asyncAdd",
+                           [](int a, int b) -> dbspider::Task<int>
+                           {
+                               co_await dbspider::CoSleep(10);
+                               co_return a + b;
+                           });
 
     while (!server->bind(address))
     {
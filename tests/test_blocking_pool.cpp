@@ -0,0 +1,146 @@
+#include "dbspider.h"
+
+#include <fcntl.h>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const uint64_t BLOCK_MS = 200;
+static const size_t FILE_SIZE = 4 * 1024 * 1024;
+
+// 一个调度线程上，一个协程执行阻塞调用，统计同一线程上另一个协程在这期间执行了多少次
+static int ticks_while_blocking(bool offload)
+{
+    dbspider::IOManager iom(1, offload ? "offload" : "inline");
+    std::atomic<bool> done{false};
+    std::atomic<int> ticks{0};
+    iom.submit([&done, offload]
+               {
+                   auto block = []
+                   {
+                       // 不经过 hook 的阻塞调用
+                       usleep_f(BLOCK_MS * 1000);
+                       return BLOCK_MS;
+                   };
+                   uint64_t rt = offload ? dbspider::BlockingPool::GetInstance()->run(block) : block();
+                   DBSPIDER_ASSERT(rt == BLOCK_MS);
+                   done = true; });
+    iom.submit([&done, &ticks]
+               {
+                   while (!done)
+                   {
+                       ++ticks;
+                       usleep(1000);
+                   } });
+    while (!done)
+    {
+        usleep(1000);
+    }
+    iom.stop();
+    DBSPIDER_LOG_INFO(g_logger) << (offload ? "offload" : "inline") << ": " << ticks << " ticks while blocking "
+                                << BLOCK_MS << " ms";
+    return ticks;
+}
+
+// 返回值、异常和恢复到原来的调度线程
+static void test_run()
+{
+    dbspider::BlockingPool pool(2, "test_pool");
+    DBSPIDER_ASSERT(pool.getThreadCount() == 2);
+    // 不在调度线程上直接执行
+    DBSPIDER_ASSERT(pool.run([]
+                             { return dbspider::GetThreadId(); }) == dbspider::GetThreadId());
+
+    dbspider::IOManager iom(2, "run");
+    std::atomic<bool> done{false};
+    iom.submit([&pool, &iom, &done]
+               {
+                   int index = iom.getCurrentIndex();
+                   int caller = dbspider::GetThreadId();
+                   int worker = pool.run([]
+                                         { return dbspider::GetThreadId(); });
+                   DBSPIDER_ASSERT(worker != caller);
+                   DBSPIDER_ASSERT(iom.getCurrentIndex() >= 0);
+                   DBSPIDER_LOG_INFO(g_logger) << "ran on thread " << worker << ", resumed on scheduler thread "
+                                               << iom.getCurrentIndex() << " (submitted from " << index << ")";
+
+                   bool caught = false;
+                   try
+                   {
+                       pool.run([]
+                                { throw std::runtime_error("offload error"); });
+                   }
+                   catch (std::runtime_error &e)
+                   {
+                       caught = std::string(e.what()) == "offload error";
+                   }
+                   DBSPIDER_ASSERT(caught);
+
+                   std::string s = pool.run([]
+                                            { return std::string(1000, 'x'); });
+                   DBSPIDER_ASSERT(s.size() == 1000);
+                   done = true; });
+    while (!done)
+    {
+        usleep(1000);
+    }
+    iom.stop();
+    DBSPIDER_ASSERT(pool.getExecutedCount() == 3);
+}
+
+// 调度线程上打开的普通文件，读写自动交给默认阻塞线程池
+static void test_file_io()
+{
+    dbspider::IOManager iom(1, "file");
+    std::atomic<bool> done{false};
+    iom.submit([&done]
+               {
+                   char path[] = "/tmp/dbspider_blocking_XXXXXX";
+                   int tmp = mkstemp(path);
+                   DBSPIDER_ASSERT(tmp >= 0);
+                   close(tmp);
+
+                   int fd = open(path, O_RDWR | O_TRUNC);
+                   DBSPIDER_ASSERT(fd >= 0);
+                   dbspider::FdCtx *ctx = dbspider::FdMgr::GetInstance()->get(fd);
+                   DBSPIDER_ASSERT(ctx && ctx->isFile() && !ctx->isSocket());
+
+                   std::string data(FILE_SIZE, 0);
+                   for (size_t i = 0; i < data.size(); ++i)
+                   {
+                       data[i] = 'a' + i % 26;
+                   }
+                   uint64_t before = dbspider::BlockingPool::GetInstance()->getExecutedCount();
+                   DBSPIDER_ASSERT(write(fd, data.data(), data.size()) == (ssize_t)data.size());
+                   DBSPIDER_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+                   std::string buf(FILE_SIZE, 0);
+                   DBSPIDER_ASSERT(read(fd, &buf[0], buf.size()) == (ssize_t)buf.size());
+                   DBSPIDER_ASSERT(buf == data);
+                   uint64_t offloaded = dbspider::BlockingPool::GetInstance()->getExecutedCount() - before;
+                   DBSPIDER_LOG_INFO(g_logger) << "file read/write offloaded " << offloaded << " times";
+                   DBSPIDER_ASSERT(offloaded == 2);
+
+                   close(fd);
+                   unlink(path);
+                   done = true; });
+    while (!done)
+    {
+        usleep(1000);
+    }
+    iom.stop();
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    test_run();
+    test_file_io();
+    int inline_ticks = ticks_while_blocking(false);
+    int offload_ticks = ticks_while_blocking(true);
+    // 阻塞调用在调度线程上执行时，同一线程上的其他协程完全停顿
+    DBSPIDER_ASSERT(inline_ticks <= 1);
+    DBSPIDER_ASSERT(offload_ticks > 10);
+
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
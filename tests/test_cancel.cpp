@@ -0,0 +1,212 @@
+#include "dbspider.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+// 在 IOManager 中运行 cb，等它执行完再返回
+template <typename Func>
+static void run_in_iom(int threads, Func cb)
+{
+    dbspider::IOManager iom(threads);
+    std::atomic<bool> finished{false};
+    go [&]
+    {
+        cb();
+        finished = true;
+    };
+    while (!finished)
+    {
+        usleep(1000);
+    }
+    iom.stop();
+}
+
+// 在 delay_ms 后取消 token
+static void cancel_later(dbspider::CancelToken::ptr token, uint64_t delay_ms)
+{
+    go [token, delay_ms]
+    {
+        usleep(delay_ms * 1000);
+        token->cancel();
+    };
+}
+
+// sleep 被取消和到达截止时间时提前返回
+static void test_sleep()
+{
+    run_in_iom(2, []
+               {
+                   auto token = dbspider::CancelToken::Create();
+                   dbspider::CancelToken::Scope scope(token);
+                   cancel_later(token, 10);
+                   uint64_t start = dbspider::GetCurrentMS();
+                   int rt = usleep(2000 * 1000);
+                   uint64_t elapsed = dbspider::GetCurrentMS() - start;
+                   DBSPIDER_ASSERT(rt == -1 && errno == ECANCELED);
+                   DBSPIDER_ASSERT(elapsed < 500);
+
+                   // 已经取消的令牌不再挂起
+                   DBSPIDER_ASSERT(sleep(1) == 1 && errno == ECANCELED);
+
+                   auto deadline = dbspider::CancelToken::Create(30);
+                   dbspider::CancelToken::Scope scope2(deadline);
+                   start = dbspider::GetCurrentMS();
+                   timespec req{2, 0}, rem{0, 0};
+                   DBSPIDER_ASSERT(nanosleep(&req, &rem) == -1 && errno == ETIMEDOUT);
+                   elapsed = dbspider::GetCurrentMS() - start;
+                   DBSPIDER_ASSERT(elapsed >= 25 && elapsed < 500);
+                   DBSPIDER_ASSERT(rem.tv_sec >= 1); });
+}
+
+// 挂起在 recv 上的协程被取消
+static void test_recv()
+{
+    run_in_iom(2, []
+               {
+                   int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+                   sockaddr_in addr{};
+                   addr.sin_family = AF_INET;
+                   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                   DBSPIDER_ASSERT(bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) == 0);
+                   DBSPIDER_ASSERT(listen(listen_fd, 8) == 0);
+                   socklen_t len = sizeof(addr);
+                   getsockname(listen_fd, (sockaddr *)&addr, &len);
+
+                   int client = socket(AF_INET, SOCK_STREAM, 0);
+                   DBSPIDER_ASSERT(connect(client, (sockaddr *)&addr, sizeof(addr)) == 0);
+                   int server = accept(listen_fd, nullptr, nullptr);
+                   DBSPIDER_ASSERT(server >= 0);
+
+                   char buf[16];
+                   {
+                       auto token = dbspider::CancelToken::Create();
+                       dbspider::CancelToken::Scope scope(token);
+                       cancel_later(token, 10);
+                       uint64_t start = dbspider::GetCurrentMS();
+                       DBSPIDER_ASSERT(recv(client, buf, sizeof(buf), 0) == -1 && errno == ECANCELED);
+                       DBSPIDER_ASSERT(dbspider::GetCurrentMS() - start < 500);
+                   }
+                   {
+                       dbspider::CancelToken::Scope scope(dbspider::CancelToken::Create(20));
+                       DBSPIDER_ASSERT(recv(client, buf, sizeof(buf), 0) == -1 && errno == ETIMEDOUT);
+                   }
+                   // 取消之后 fd 仍然可以正常使用
+                   DBSPIDER_ASSERT(send(server, "ok", 2, 0) == 2);
+                   DBSPIDER_ASSERT(recv(client, buf, sizeof(buf), 0) == 2);
+                   close(client);
+                   close(server);
+                   close(listen_fd); });
+}
+
+// Channel、CoMutex 和 CoCondVar 上的等待被取消
+static void test_sync()
+{
+    run_in_iom(2, []
+               {
+                   dbspider::Channel<int> chan(1);
+                   {
+                       auto token = dbspider::CancelToken::Create();
+                       dbspider::CancelToken::Scope scope(token);
+                       cancel_later(token, 10);
+                       int v = 0;
+                       DBSPIDER_ASSERT(!chan.pop(v) && errno == ECANCELED);
+                   }
+                   // 被取消的协程已经离开等待队列，Channel 仍然可以正常收发
+                   go [chan]() mutable
+                   { chan << 1; };
+                   int v = 0;
+                   DBSPIDER_ASSERT(chan.pop(v) && v == 1);
+
+                   dbspider::CoMutex mutex;
+                   std::atomic<bool> locked{false};
+                   go [&mutex, &locked]
+                   {
+                       dbspider::CoMutex::Lock lock(mutex);
+                       locked = true;
+                       usleep(100 * 1000);
+                   };
+                   while (!locked)
+                   {
+                       usleep(1000);
+                   }
+                   {
+                       dbspider::CancelToken::Scope scope(dbspider::CancelToken::Create(10));
+                       uint64_t start = dbspider::GetCurrentMS();
+                       DBSPIDER_ASSERT(!mutex.lockCancellable() && errno == ETIMEDOUT);
+                       DBSPIDER_ASSERT(dbspider::GetCurrentMS() - start < 80);
+                   }
+                   // 持有者解锁后可以正常获取
+                   mutex.lock();
+                   mutex.unlock();
+
+                   dbspider::CoMutex cv_mutex;
+                   dbspider::CoCondVar cv;
+                   dbspider::CoMutex::Lock lock(cv_mutex);
+                   {
+                       dbspider::CancelToken::Scope scope(dbspider::CancelToken::Create(10));
+                       DBSPIDER_ASSERT(!cv.waitFor(lock, 1000) && errno == ETIMEDOUT);
+                   }
+                   DBSPIDER_ASSERT(!cv.waitFor(lock, 10) && errno == ETIMEDOUT); });
+}
+
+// 子令牌随 parent 取消，截止时间不晚于 parent；FiberGroup 取消时打断组内挂起的任务
+static void test_propagation()
+{
+    run_in_iom(2, []
+               {
+                   auto parent = dbspider::CancelToken::Create(1000);
+                   auto child = dbspider::CancelToken::Create(5000, parent);
+                   DBSPIDER_ASSERT(child->getDeadline() == parent->getDeadline());
+                   parent->cancel();
+                   DBSPIDER_ASSERT(child->isCancelled() && child->getError() == ECANCELED);
+
+                   std::atomic<int> interrupted{0};
+                   uint64_t start = dbspider::GetCurrentMS();
+                   {
+                       dbspider::FiberGroup group;
+                       for (int i = 0; i < 4; ++i)
+                       {
+                           group.spawn([&interrupted]
+                                       {
+                                           if (usleep(2000 * 1000) == -1 && errno == ECANCELED)
+                                           {
+                                               ++interrupted;
+                                           } });
+                       }
+                       usleep(10 * 1000);
+                       group.cancel();
+                   }
+                   DBSPIDER_ASSERT(interrupted == 4);
+                   DBSPIDER_ASSERT(dbspider::GetCurrentMS() - start < 500);
+
+                   // 父协程的截止时间传给组内任务
+                   dbspider::CancelToken::Scope scope(dbspider::CancelToken::Create(20));
+                   std::atomic<int> timedout{0};
+                   dbspider::FiberGroup group;
+                   group.spawn([&timedout]
+                               {
+                                   if (usleep(2000 * 1000) == -1 && errno == ETIMEDOUT)
+                                   {
+                                       ++timedout;
+                                   } });
+                   // 父协程自己的等待也在截止时间返回
+                   DBSPIDER_ASSERT(group.waitFor(1000) || errno == ETIMEDOUT);
+                   dbspider::CancelToken::SetThis(nullptr);
+                   group.wait();
+                   DBSPIDER_ASSERT(timedout == 1); });
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    test_sleep();
+    test_recv();
+    test_sync();
+    test_propagation();
+
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
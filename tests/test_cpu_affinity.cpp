@@ -0,0 +1,105 @@
+#include "dbspider.h"
+
+#include <sched.h>
+#include <set>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int THREADS = 3;
+static const int TASKS = 30;
+
+// Thread 按指定的 CPU 绑定，构造函数返回时已经生效
+static void test_thread(int cpu)
+{
+    std::atomic<int> ran_on{-1};
+    std::vector<int> affinity;
+    dbspider::Thread thread("pinned", [&ran_on, &affinity]
+                            {
+                                affinity = dbspider::Thread::GetAffinity();
+                                ran_on = sched_getcpu(); },
+                            {cpu});
+    thread.join();
+    DBSPIDER_ASSERT(thread.getCpus() == std::vector<int>{cpu});
+    DBSPIDER_ASSERT(affinity == std::vector<int>{cpu});
+    DBSPIDER_ASSERT(ran_on == cpu);
+
+    // 不存在的 CPU 绑定失败，线程照常运行
+    DBSPIDER_ASSERT(!dbspider::Thread::SetAffinity({}));
+    DBSPIDER_ASSERT(!dbspider::Thread::SetAffinity({-1}));
+}
+
+// 调度线程 i 绑定到 cpus[i % size]，协程栈在绑定后的线程上分配
+static void test_scheduler(const std::vector<int> &cpus)
+{
+    dbspider::Config::Lookup<std::vector<int>>("scheduler.cpu_affinity")->setValue(cpus);
+    dbspider::IOManager iom(THREADS, "affinity");
+    for (int i = 0; i < THREADS; ++i)
+    {
+        DBSPIDER_ASSERT(iom.getCpu(i) == cpus[i % cpus.size()]);
+    }
+
+    std::atomic<int> done{0};
+    std::atomic<int> mismatch{0};
+    for (int i = 0; i < TASKS; ++i)
+    {
+        int index = i % THREADS;
+        iom.submit([&iom, &done, &mismatch]
+                   {
+                       int index = iom.getCurrentIndex();
+                       std::vector<int> affinity = dbspider::Thread::GetAffinity();
+                       if (affinity != std::vector<int>{iom.getCpu(index)} || sched_getcpu() != iom.getCpu(index))
+                       {
+                           ++mismatch;
+                       }
+                       ++done; },
+                   iom.getThreadId(index));
+    }
+    while (done < TASKS)
+    {
+        usleep(1000);
+    }
+    iom.stop();
+    DBSPIDER_LOG_INFO(g_logger) << TASKS << " tasks on " << THREADS << " pinned threads, " << mismatch << " mismatch";
+    DBSPIDER_ASSERT(mismatch == 0);
+    dbspider::Config::Lookup<std::vector<int>>("scheduler.cpu_affinity")->setValue({});
+}
+
+// 协程栈在第一次切入时分配，没有运行过的协程不占用栈
+static void test_lazy_stack()
+{
+    dbspider::Fiber::EnableFiber();
+    for (int i = 0; i < 3; ++i)
+    {
+        dbspider::Fiber::ptr never(new dbspider::Fiber([] {}));
+    }
+    int count = 0;
+    dbspider::Fiber::ptr fiber(new dbspider::Fiber([&count]
+                                                   {
+                                                       ++count;
+                                                       dbspider::Fiber::YieldToHold();
+                                                       ++count; }));
+    fiber->resume();
+    DBSPIDER_ASSERT(count == 1);
+    fiber->resume();
+    DBSPIDER_ASSERT(count == 2 && fiber->getState() == dbspider::Fiber::TERM);
+    fiber->reset([&count]
+                 { ++count; });
+    fiber->resume();
+    DBSPIDER_ASSERT(count == 3);
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    std::vector<int> cpus = dbspider::Thread::GetAffinity();
+    DBSPIDER_ASSERT(!cpus.empty());
+    DBSPIDER_LOG_INFO(g_logger) << "process can run on " << cpus.size() << " cpus";
+
+    test_thread(cpus.back());
+    test_scheduler(cpus);
+    test_lazy_stack();
+
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "dbspider.h"
+
+#include <set>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const size_t MIN_THREADS = 2;
+static const size_t MAX_THREADS = 6;
+static const int TASKS = 24;
+static const uint64_t TASK_MS = 30;
+
+static void set_bounds(uint64_t min_threads, uint64_t max_threads)
+{
+    dbspider::Config::Lookup<uint64_t>("scheduler.min_threads")->setValue(min_threads);
+    dbspider::Config::Lookup<uint64_t>("scheduler.max_threads")->setValue(max_threads);
+}
+
+// 等待 pred 成立，最多等 ms 毫秒
+template <typename Pred>
+static bool wait_for(Pred pred, uint64_t ms)
+{
+    uint64_t deadline = dbspider::GetCurrentMS() + ms;
+    while (!pred())
+    {
+        if (dbspider::GetCurrentMS() > deadline)
+        {
+            return false;
+        }
+        usleep(1000);
+    }
+    return true;
+}
+
+// 忙等 ms 毫秒，模拟不让出的计算任务
+static void busy(uint64_t ms)
+{
+    uint64_t end = dbspider::GetCurrentMS() + ms;
+    while (dbspider::GetCurrentMS() < end)
+        ;
+}
+
+// 任务持续排队时增加线程，空闲之后退回下限，退役的线程仍然执行提交给它的专属任务
+static void test_grow_and_retire()
+{
+    set_bounds(MIN_THREADS, MAX_THREADS);
+    dbspider::Config::Lookup<uint64_t>("scheduler.grow_delay_ms")->setValue(10);
+    dbspider::Config::Lookup<uint64_t>("scheduler.retire_idle_ms")->setValue(100);
+
+    dbspider::IOManager iom(MIN_THREADS, "elastic");
+    DBSPIDER_ASSERT(iom.getThreadCount() == MIN_THREADS);
+    DBSPIDER_ASSERT(iom.getMaxThreads() == MAX_THREADS);
+
+    dbspider::Mutex mutex;
+    std::set<int> threads;
+    std::atomic<int> done{0};
+    size_t peak = 0;
+    uint64_t begin = dbspider::GetCurrentMS();
+    for (int i = 0; i < TASKS; ++i)
+    {
+        iom.submit([&]
+                   {
+                       busy(TASK_MS);
+                       {
+                           dbspider::Mutex::Lock lock(mutex);
+                           threads.insert(dbspider::GetThreadId());
+                       }
+                       ++done; });
+    }
+    while (done < TASKS)
+    {
+        peak = std::max(peak, iom.getThreadCount());
+        usleep(1000);
+    }
+    DBSPIDER_LOG_INFO(g_logger) << TASKS << " tasks cost " << dbspider::GetCurrentMS() - begin << " ms, peak threads "
+                                << peak << ", " << threads.size() << " threads ran tasks";
+    DBSPIDER_ASSERT(peak == MAX_THREADS);
+    DBSPIDER_ASSERT(threads.size() > MIN_THREADS);
+
+    // 每个空闲周期退役一个线程
+    begin = dbspider::GetCurrentMS();
+    DBSPIDER_ASSERT(wait_for([&iom]
+                             { return iom.getThreadCount() == MIN_THREADS; },
+                             5000));
+    DBSPIDER_LOG_INFO(g_logger) << "retired to " << iom.getThreadCount() << " threads in "
+                                << dbspider::GetCurrentMS() - begin << " ms";
+
+    // 停放的线程被专属任务唤醒，执行完之后重新停放
+    int last = iom.getThreadId(MAX_THREADS - 1);
+    std::atomic<int> ran_on{0};
+    iom.submit([&ran_on]
+               { ran_on = dbspider::GetThreadId(); },
+               last);
+    DBSPIDER_ASSERT(wait_for([&ran_on]
+                             { return ran_on != 0; },
+                             1000));
+    DBSPIDER_ASSERT(ran_on == last);
+    DBSPIDER_ASSERT(iom.getThreadCount() == MIN_THREADS);
+
+    // 手动调整，超出容量时取容量
+    iom.setThreadCount(MAX_THREADS + 10);
+    DBSPIDER_ASSERT(iom.getThreadCount() == MAX_THREADS);
+    iom.setThreadCount(0);
+    DBSPIDER_ASSERT(iom.getThreadCount() == 1);
+    done = 0;
+    for (int i = 0; i < TASKS; ++i)
+    {
+        iom.submit([&done]
+                   { ++done; });
+    }
+    DBSPIDER_ASSERT(wait_for([&done]
+                             { return done == TASKS; },
+                             1000));
+    iom.stop();
+}
+
+// 修改 scheduler.threads 直接作用于正在运行的默认调度器
+static void test_config_listener()
+{
+    set_bounds(0, MAX_THREADS);
+    // 只验证手动调整，不让监控线程在检查之前退役线程
+    dbspider::Config::Lookup<uint64_t>("scheduler.retire_idle_ms")->setValue(60000);
+    dbspider::Config::Lookup<uint64_t>("scheduler.threads")->setValue(MIN_THREADS);
+    dbspider::IOManager *iom = dbspider::IOManager::GetThis();
+    DBSPIDER_ASSERT(iom->getThreadCount() == MIN_THREADS);
+    DBSPIDER_ASSERT(iom->getMaxThreads() == MAX_THREADS);
+
+    std::atomic<int> done{0};
+    for (uint64_t threads : {MAX_THREADS, (size_t)1, MIN_THREADS + 1})
+    {
+        dbspider::Config::Lookup<uint64_t>("scheduler.threads")->setValue(threads);
+        DBSPIDER_ASSERT(iom->getThreadCount() == threads);
+        for (size_t i = 0; i < threads; ++i)
+        {
+            iom->submit([&done]
+                        { ++done; },
+                        iom->getThreadId(i));
+        }
+    }
+    DBSPIDER_ASSERT(wait_for([&done]
+                             { return done == (int)(MAX_THREADS + 1 + MIN_THREADS + 1); },
+                             1000));
+    DBSPIDER_LOG_INFO(g_logger) << "default scheduler resized to " << iom->getThreadCount() << " threads";
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    test_grow_and_retire();
+    test_config_listener();
+
+    set_bounds(0, 0);
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
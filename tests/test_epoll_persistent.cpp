@@ -0,0 +1,230 @@
+#include "dbspider.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int THREADS = 2;
+static const int CONNS = 16;
+static const int ROUNDS = 2000;
+static const size_t MSG_SIZE = 64;
+
+static void set_persistent(bool persistent)
+{
+    dbspider::Config::Lookup<bool>("iomanager.epoll_persistent")->setValue(persistent);
+}
+
+// 在 127.0.0.1 的随机端口上监听，返回监听的 fd 和地址
+static int listen_any(sockaddr_in &addr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    DBSPIDER_ASSERT(fd >= 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    DBSPIDER_ASSERT(bind(fd, (sockaddr *)&addr, sizeof(addr)) == 0);
+    DBSPIDER_ASSERT(listen(fd, 1024) == 0);
+    socklen_t len = sizeof(addr);
+    DBSPIDER_ASSERT(getsockname(fd, (sockaddr *)&addr, &len) == 0);
+    return fd;
+}
+
+static void echo(int fd)
+{
+    char buf[MSG_SIZE];
+    while (true)
+    {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+        {
+            break;
+        }
+        if (send(fd, buf, n, 0) != n)
+        {
+            break;
+        }
+    }
+    close(fd);
+}
+
+// CONNS 个连接各做 ROUNDS 次一问一答，连接全部关闭后返回，下一轮会复用同样的 fd 号
+static void echo_round(dbspider::IOManager &iom)
+{
+    std::atomic<int> done{0};
+    sockaddr_in addr;
+    int listen_fd = listen_any(addr);
+    iom.submit([listen_fd, &done]
+               {
+                   for (int i = 0; i < CONNS; ++i)
+                   {
+                       int fd = accept(listen_fd, nullptr, nullptr);
+                       DBSPIDER_ASSERT(fd >= 0);
+                       dbspider::IOManager::GetThis()->submit([fd, &done]
+                                                              {
+                                                                  echo(fd);
+                                                                  ++done; });
+                   }
+                   close(listen_fd); });
+    for (int i = 0; i < CONNS; ++i)
+    {
+        iom.submit([addr, &done]
+                   {
+                       int fd = socket(AF_INET, SOCK_STREAM, 0);
+                       DBSPIDER_ASSERT(connect(fd, (const sockaddr *)&addr, sizeof(addr)) == 0);
+                       char buf[MSG_SIZE];
+                       memset(buf, 'x', sizeof(buf));
+                       for (int j = 0; j < ROUNDS; ++j)
+                       {
+                           DBSPIDER_ASSERT(send(fd, buf, sizeof(buf), 0) == (ssize_t)sizeof(buf));
+                           size_t got = 0;
+                           while (got < sizeof(buf))
+                           {
+                               ssize_t n = recv(fd, buf + got, sizeof(buf) - got, 0);
+                               DBSPIDER_ASSERT(n > 0);
+                               got += n;
+                           }
+                       }
+                       close(fd);
+                       ++done; });
+    }
+    while (done < CONNS * 2)
+    {
+        usleep(1000);
+    }
+}
+
+// 返回每次往返调用 epoll_ctl 的次数
+static double bench(bool persistent)
+{
+    set_persistent(persistent);
+    const char *name = persistent ? "persistent" : "oneshot";
+    dbspider::IOManager iom(THREADS, name);
+    DBSPIDER_ASSERT(iom.isPersistent() == persistent);
+
+    uint64_t begin = dbspider::GetCurrentUS();
+    uint64_t ctls = iom.getEpollCtlCount();
+    // 跑两轮，第二轮的 fd 号与第一轮关闭的相同，检查常驻注册在 close 之后会重新注册
+    echo_round(iom);
+    echo_round(iom);
+    ctls = iom.getEpollCtlCount() - ctls;
+    uint64_t cost = dbspider::GetCurrentUS() - begin;
+
+    double round_trips = 2.0 * CONNS * ROUNDS;
+    double per_rt = ctls / round_trips;
+    DBSPIDER_LOG_INFO(g_logger) << name << ": " << (uint64_t)round_trips << " round trips cost " << cost
+                                << " us, " << (uint64_t)(round_trips * 1000000 / cost) << " round trips/s, "
+                                << ctls << " epoll_ctl, " << per_rt << " per round trip";
+    iom.stop();
+    return per_rt;
+}
+
+// 常驻注册之后，没有协程等待期间到达的数据和对端关闭都能正确读到，不会阻塞到超时
+static void test_ready_before_wait()
+{
+    set_persistent(true);
+    std::atomic<int> done{0};
+    dbspider::IOManager iom(THREADS, "ready");
+    sockaddr_in addr;
+    int listen_fd = listen_any(addr);
+    iom.submit([listen_fd, addr, &done]
+               {
+                   int client = socket(AF_INET, SOCK_STREAM, 0);
+                   DBSPIDER_ASSERT(connect(client, (const sockaddr *)&addr, sizeof(addr)) == 0);
+                   int server = accept(listen_fd, nullptr, nullptr);
+                   DBSPIDER_ASSERT(server >= 0);
+
+                   // 先让 server 在 epoll 中注册：读一次没有数据，超时返回
+                   timeval tv{0, 20 * 1000};
+                   setsockopt(server, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                   char buf[16];
+                   DBSPIDER_ASSERT(recv(server, buf, sizeof(buf), 0) == -1 && errno == ETIMEDOUT);
+
+                   // 没有等待者时写入两次，就绪事件被缓存，之后的 recv 不会丢数据
+                   DBSPIDER_ASSERT(send(client, "hello", 5, 0) == 5);
+                   usleep(10 * 1000);
+                   DBSPIDER_ASSERT(send(client, "world", 5, 0) == 5);
+                   usleep(10 * 1000);
+                   DBSPIDER_ASSERT(recv(server, buf, 5, 0) == 5);
+                   DBSPIDER_ASSERT(recv(server, buf, 5, 0) == 5);
+                   DBSPIDER_ASSERT(memcmp(buf, "world", 5) == 0);
+
+                   // 等待中对端关闭，EPOLLRDHUP 唤醒读事件，读到 EOF 而不是超时
+                   dbspider::IOManager::GetThis()->addTimer(5, [client]
+                                                            { close(client); });
+                   DBSPIDER_ASSERT(recv(server, buf, sizeof(buf), 0) == 0);
+
+                   close(server);
+                   close(listen_fd);
+                   ++done; });
+    iom.stop();
+    DBSPIDER_ASSERT(done == 1);
+}
+
+// 常驻注册的fd没有经过 cancelAllEvent 就关闭(这里关闭 hook 模拟在未hook的线程上关闭)，fd 号被新连接复用后要重新注册
+static void test_close_without_cancel()
+{
+    set_persistent(true);
+    std::atomic<int> done{0};
+    dbspider::IOManager iom(THREADS, "reuse");
+    sockaddr_in addr;
+    int listen_fd = listen_any(addr);
+    iom.submit([listen_fd, addr, &done]
+               {
+                   int client = socket(AF_INET, SOCK_STREAM, 0);
+                   DBSPIDER_ASSERT(connect(client, (const sockaddr *)&addr, sizeof(addr)) == 0);
+                   int server = accept(listen_fd, nullptr, nullptr);
+                   DBSPIDER_ASSERT(server >= 0);
+                   timeval tv{0, 20 * 1000};
+                   setsockopt(server, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                   char buf[16];
+                   DBSPIDER_ASSERT(recv(server, buf, sizeof(buf), 0) == -1 && errno == ETIMEDOUT);
+                   // 没有等待者时就绪，留下 ready 标记
+                   DBSPIDER_ASSERT(send(client, "x", 1, 0) == 1);
+                   usleep(10 * 1000);
+
+                   // 先建好新的客户端socket，server 关闭后空出的 fd 号留给 accept
+                   int client2 = socket(AF_INET, SOCK_STREAM, 0);
+                   dbspider::set_hook_enable(false);
+                   close(server);
+                   dbspider::set_hook_enable(true);
+
+                   DBSPIDER_ASSERT(connect(client2, (const sockaddr *)&addr, sizeof(addr)) == 0);
+                   int server2 = accept(listen_fd, nullptr, nullptr);
+                   DBSPIDER_ASSERT(server2 == server);
+                   tv.tv_usec = 500 * 1000;
+                   setsockopt(server2, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                   // 旧连接的 ready 标记不能让等待提前结束，新连接的数据要能唤醒等待
+                   dbspider::IOManager::GetThis()->addTimer(20, [client2]
+                                                            { DBSPIDER_ASSERT(send(client2, "y", 1, 0) == 1); });
+                   uint64_t begin = dbspider::GetCurrentMS();
+                   DBSPIDER_ASSERT(recv(server2, buf, sizeof(buf), 0) == 1 && buf[0] == 'y');
+                   DBSPIDER_ASSERT(dbspider::GetCurrentMS() - begin >= 10);
+
+                   close(server2);
+                   close(client2);
+                   close(client);
+                   close(listen_fd);
+                   ++done; });
+    iom.stop();
+    DBSPIDER_ASSERT(done == 1);
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    test_ready_before_wait();
+    test_close_without_cancel();
+
+    double oneshot = bench(false);
+    double persistent = bench(true);
+    DBSPIDER_ASSERT(persistent < oneshot);
+    // 每个连接只在第一次等待和关闭时各调用一次 epoll_ctl
+    DBSPIDER_ASSERT(persistent < 0.01);
+    set_persistent(false);
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include "dbspider.h"
+#include "fd_manager.h"
+#include "segmented_array.h"
+
+#include <sys/socket.h>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int THREADS = 64;
+static const int LOOKUPS = 200000;
+static const int PAIRS = THREADS / 2;
+static const int ROUNDS = 2000;
+
+// 多个线程并发扩容，每个元素只初始化一次，扩容之后已有元素的地址不变
+static void test_segmented_array()
+{
+    static const size_t SIZE = 100000;
+    dbspider::SegmentedArray<std::atomic<size_t>> array;
+    std::atomic<size_t> *first = array.getOrCreate(0, [](std::atomic<size_t> &v, size_t i)
+                                                   { v = i; });
+    DBSPIDER_ASSERT(array.get(SIZE) == nullptr);
+
+    std::vector<dbspider::Thread::ptr> threads;
+    for (int t = 0; t < 8; ++t)
+    {
+        threads.emplace_back(new dbspider::Thread("grow_" + std::to_string(t), [&array, t]
+                                                  {
+                                                      for (size_t i = t; i < SIZE; i += 3)
+                                                      {
+                                                          std::atomic<size_t> *v = array.getOrCreate(i, [](std::atomic<size_t> &v, size_t i)
+                                                                                                      { v = i; });
+                                                          DBSPIDER_ASSERT(v && *v == i);
+                                                      } }));
+    }
+    for (auto &thread : threads)
+    {
+        thread->join();
+    }
+    DBSPIDER_ASSERT(array.get(0) == first);
+    size_t count = 0;
+    array.forEach([&count](std::atomic<size_t> &v)
+                  {
+                      DBSPIDER_ASSERT(v == count);
+                      ++count; });
+    DBSPIDER_ASSERT(count >= SIZE);
+    DBSPIDER_ASSERT(array.get(-1) == nullptr);
+}
+
+// 原来的实现：读写锁保护的 vector
+class RWLockTable
+{
+public:
+    RWLockTable() { m_fds.resize(64); }
+
+    dbspider::FdCtx::ptr get(int fd)
+    {
+        dbspider::RWMutex::ReadLock lock(m_mutex);
+        if ((int)m_fds.size() <= fd)
+        {
+            return nullptr;
+        }
+        return m_fds[fd];
+    }
+
+    void set(int fd, dbspider::FdCtx *ctx)
+    {
+        dbspider::RWMutex::WriteLock lock(m_mutex);
+        if ((int)m_fds.size() <= fd)
+        {
+            m_fds.resize(fd * 1.5);
+        }
+        // 不持有所有权，FdCtx 由 FdManager 管理
+        m_fds[fd] = dbspider::FdCtx::ptr(dbspider::FdCtx::ptr(), ctx);
+    }
+
+private:
+    dbspider::RWMutex m_mutex;
+    std::vector<dbspider::FdCtx::ptr> m_fds;
+};
+
+// THREADS 个线程同时查找 fd 表，返回每次查找的平均耗时(ns)
+// 所有线程就绪后一起开始，每个线程只统计自己的查找循环，不包括创建和回收线程
+template <typename Get>
+static double bench_lookup(const std::string &name, Get get, const std::vector<int> &fds)
+{
+    std::atomic<int> ready{0};
+    std::atomic<bool> start{false};
+    std::atomic<uint64_t> cost{0};
+    std::vector<dbspider::Thread::ptr> threads;
+    for (int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back(new dbspider::Thread(name + "_" + std::to_string(t), [&get, &fds, &ready, &start, &cost, t]
+                                                  {
+                                                      int fd = fds[t];
+                                                      ++ready;
+                                                      while (!start.load(std::memory_order_acquire))
+                                                      {
+                                                      }
+                                                      uint64_t begin = dbspider::GetCurrentUS();
+                                                      for (int i = 0; i < LOOKUPS; ++i)
+                                                      {
+                                                          DBSPIDER_ASSERT(get(fd));
+                                                      }
+                                                      cost += dbspider::GetCurrentUS() - begin; }));
+    }
+    while (ready < THREADS)
+    {
+        usleep(100);
+    }
+    start.store(true, std::memory_order_release);
+    for (auto &thread : threads)
+    {
+        thread->join();
+    }
+    double ns = cost * 1000.0 / ((double)THREADS * LOOKUPS);
+    DBSPIDER_LOG_INFO(g_logger) << name << ": " << THREADS << " threads x " << LOOKUPS << " lookups, "
+                                << ns << " ns per lookup";
+    return ns;
+}
+
+// THREADS 个调度线程上的 PAIRS 对协程通过 socketpair 一问一答，每次 recv 都经过 hook 查找两张 fd 表
+static void bench_hooked_recv()
+{
+    std::atomic<int> done{0};
+    dbspider::IOManager iom(THREADS, "recv");
+    uint64_t begin = dbspider::GetCurrentUS();
+    for (int i = 0; i < PAIRS; ++i)
+    {
+        iom.submit([&iom, &done]
+                   {
+                       int fds[2];
+                       DBSPIDER_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+                       // socketpair 没有被 hook，登记到 FdManager 后读写才会走 hook
+                       dbspider::FdMgr::GetInstance()->get(fds[0], true);
+                       dbspider::FdMgr::GetInstance()->get(fds[1], true);
+                       int peer = fds[1];
+                       iom.submit([peer, &done]
+                                  {
+                                      char c;
+                                      for (int j = 0; j < ROUNDS; ++j)
+                                      {
+                                          DBSPIDER_ASSERT(recv(peer, &c, 1, 0) == 1);
+                                          DBSPIDER_ASSERT(send(peer, &c, 1, 0) == 1);
+                                      }
+                                      close(peer);
+                                      ++done; });
+                       char c = 'x';
+                       for (int j = 0; j < ROUNDS; ++j)
+                       {
+                           DBSPIDER_ASSERT(send(fds[0], &c, 1, 0) == 1);
+                           DBSPIDER_ASSERT(recv(fds[0], &c, 1, 0) == 1);
+                       }
+                       close(fds[0]);
+                       ++done; });
+    }
+    while (done < PAIRS * 2)
+    {
+        usleep(1000);
+    }
+    uint64_t cost = dbspider::GetCurrentUS() - begin;
+    DBSPIDER_LOG_INFO(g_logger) << "hooked recv: " << THREADS << " threads, " << PAIRS * ROUNDS << " round trips cost "
+                                << cost << " us, " << (uint64_t)PAIRS * ROUNDS * 1000000 / cost << " round trips/s";
+    iom.stop();
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    test_segmented_array();
+
+    std::vector<int> fds;
+    RWLockTable table;
+    for (int t = 0; t < THREADS; ++t)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        fds.push_back(fd);
+        table.set(fd, dbspider::FdMgr::GetInstance()->get(fd, true));
+    }
+    double rwlock = bench_lookup("rwlock", [&table](int fd)
+                                 { return table.get(fd); },
+                                 fds);
+    double segmented = bench_lookup("segmented", [](int fd)
+                                    { return dbspider::FdMgr::GetInstance()->get(fd); },
+                                    fds);
+    // 耗时只输出不断言，受机器负载影响太大
+    DBSPIDER_LOG_INFO(g_logger) << "segmented / rwlock = " << segmented / rwlock;
+    for (int fd : fds)
+    {
+        DBSPIDER_ASSERT(dbspider::FdMgr::GetInstance()->get(fd) == table.get(fd).get());
+    }
+    for (int fd : fds)
+    {
+        dbspider::FdMgr::GetInstance()->del(fd);
+        DBSPIDER_ASSERT(!dbspider::FdMgr::GetInstance()->get(fd));
+        close(fd);
+    }
+
+    // fd 号复用后 FdCtx 地址不变，代数增加
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        dbspider::FdCtx *ctx = dbspider::FdMgr::GetInstance()->get(fd, true);
+        uint64_t generation = ctx->getGeneration();
+        DBSPIDER_ASSERT(dbspider::FdMgr::GetInstance()->get(fd, true) == ctx);
+        DBSPIDER_ASSERT(ctx->getGeneration() == generation);
+        // 没有经过 del 直接重新打开，比如在未hook的线程上关闭
+        DBSPIDER_ASSERT(dbspider::FdMgr::GetInstance()->open(fd) == ctx);
+        DBSPIDER_ASSERT(ctx->getGeneration() == generation + 1);
+        dbspider::FdMgr::GetInstance()->del(fd);
+        DBSPIDER_ASSERT(dbspider::FdMgr::GetInstance()->get(fd, true) == ctx);
+        DBSPIDER_ASSERT(ctx->getGeneration() == generation + 2);
+        dbspider::FdMgr::GetInstance()->del(fd);
+        close(fd);
+    }
+
+    bench_hooked_recv();
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
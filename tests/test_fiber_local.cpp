@@ -0,0 +1,185 @@
+#include "dbspider.h"
+
+#include <set>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static dbspider::FiberLocal<std::string> s_trace_id;
+static dbspider::FiberLocal<uint64_t> s_deadline;
+
+// 等待 pred 成立，最多等 1 秒
+template <typename Pred>
+static bool wait_for(Pred pred)
+{
+    uint64_t deadline = dbspider::GetCurrentMS() + 1000;
+    while (!pred())
+    {
+        if (dbspider::GetCurrentMS() > deadline)
+        {
+            return false;
+        }
+        usleep(1000);
+    }
+    return true;
+}
+
+// 同一线程上交替运行的协程各自看到自己的值，超出内联槽位的键同样可用
+static void test_isolation()
+{
+    dbspider::Fiber::EnableFiber();
+    DBSPIDER_ASSERT(!s_trace_id.get());
+    s_trace_id.set("main");
+
+    std::vector<std::unique_ptr<dbspider::FiberLocal<int>>> keys;
+    for (size_t i = 0; i < dbspider::Fiber::INLINE_LOCALS * 2; ++i)
+    {
+        keys.emplace_back(new dbspider::FiberLocal<int>);
+    }
+    DBSPIDER_ASSERT(keys.back()->getIndex() >= dbspider::Fiber::INLINE_LOCALS);
+
+    std::vector<dbspider::Fiber::ptr> fibers;
+    int ok = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        fibers.emplace_back(new dbspider::Fiber([i, &keys, &ok]
+                                                {
+                                                    DBSPIDER_ASSERT(!s_trace_id.get());
+                                                    s_trace_id.set("fiber" + std::to_string(i));
+                                                    for (auto &key : keys)
+                                                    {
+                                                        key->set(i);
+                                                    }
+                                                    dbspider::Fiber::YieldToHold();
+                                                    bool same = *s_trace_id.get() == "fiber" + std::to_string(i);
+                                                    for (auto &key : keys)
+                                                    {
+                                                        same = same && *key->get() == i;
+                                                    }
+                                                    ok += same; }));
+    }
+    for (int round = 0; round < 2; ++round)
+    {
+        for (auto &f : fibers)
+        {
+            f->resume();
+        }
+    }
+    DBSPIDER_ASSERT(ok == 3);
+    DBSPIDER_ASSERT(*s_trace_id.get() == "main");
+    s_trace_id.reset();
+    DBSPIDER_ASSERT(!s_trace_id.get());
+
+    // 重置之后不再带着上一次的值
+    fibers[0]->reset([]
+                     { DBSPIDER_ASSERT(!s_trace_id.get()); });
+    fibers[0]->resume();
+}
+
+// 协程在调度线程之间迁移时值跟着协程走
+static void test_migration()
+{
+    dbspider::IOManager iom(3, "local");
+    std::atomic<int> done{0};
+    std::atomic<int> wrong{0};
+    std::atomic<int> migrated{0};
+    for (int i = 0; i < 30; ++i)
+    {
+        iom.submit([i, &iom, &done, &wrong, &migrated]
+                   {
+                       s_deadline.set(i);
+                       std::set<int> threads;
+                       for (int j = 0; j < 20; ++j)
+                       {
+                           threads.insert(dbspider::GetThreadId());
+                           // 依次换到下一个调度线程上继续运行
+                           iom.submit(dbspider::Fiber::GetThis(), iom.getThreadId((iom.getCurrentIndex() + 1) % 3));
+                           dbspider::Fiber::YieldToHold();
+                           if (!s_deadline.get() || *s_deadline.get() != (uint64_t)i)
+                           {
+                               ++wrong;
+                           }
+                       }
+                       migrated += threads.size() > 1;
+                       ++done; });
+    }
+    DBSPIDER_ASSERT(wait_for([&done]
+                             { return done == 30; }));
+    // 复用的回调协程不会把值带给下一个任务
+    std::atomic<int> leaked{-1};
+    iom.submit([&leaked]
+               { leaked = s_deadline.get() != nullptr; });
+    DBSPIDER_ASSERT(wait_for([&leaked]
+                             { return leaked != -1; }));
+    iom.stop();
+    DBSPIDER_LOG_INFO(g_logger) << migrated << " of 30 fibers ran on more than one thread, " << wrong << " wrong values";
+    DBSPIDER_ASSERT(migrated == 30 && wrong == 0);
+    DBSPIDER_ASSERT(leaked == 0);
+}
+
+// Fiber::Inherit 只比 cb 多一个智能指针，小的回调包装后仍然放在 SmallTask 的内联缓冲区里
+static void test_inherit_inline()
+{
+    int *a = nullptr, *b = nullptr;
+    auto wrapped = dbspider::Fiber::Inherit([a, b]
+                                            { (void)a, (void)b; });
+    static_assert(dbspider::SmallTask::IsInline<decltype(wrapped)>);
+    wrapped();
+}
+
+// go Fiber::Inherit 继承父协程的值，子协程修改不影响父协程；普通的 go 不继承
+static void test_inherit()
+{
+    dbspider::IOManager iom(2, "inherit");
+    std::atomic<int> result{0};
+    iom.submit([&result]
+               {
+                   s_trace_id.set("parent");
+                   s_deadline.set(100);
+                   std::atomic<int> finished{0};
+                   std::atomic<bool> inherited{false};
+                   std::atomic<bool> plain{false};
+                   go dbspider::Fiber::Inherit([&]
+                                               {
+                                                   inherited = s_trace_id.get() && *s_trace_id.get() == "parent" &&
+                                                               *s_deadline.get() == 100;
+                                                   s_trace_id.set("child");
+                                                   ++finished; });
+                   go [&]
+                   {
+                       plain = !s_trace_id.get() && !s_deadline.get();
+                       ++finished;
+                   };
+                   while (finished < 2)
+                   {
+                       usleep(1000);
+                   }
+                   // 父协程修改之后再派生的子协程拿到新的值
+                   s_trace_id.set("parent2");
+                   std::atomic<bool> updated{false};
+                   go dbspider::Fiber::Inherit([&]
+                                               {
+                                                   updated = *s_trace_id.get() == "parent2";
+                                                   ++finished; });
+                   while (finished < 3)
+                   {
+                       usleep(1000);
+                   }
+                   result = inherited && plain && updated && *s_trace_id.get() == "parent2" ? 1 : 2; });
+    DBSPIDER_ASSERT(wait_for([&result]
+                             { return result != 0; }));
+    iom.stop();
+    DBSPIDER_ASSERT(result == 1);
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    test_isolation();
+    test_migration();
+    test_inherit();
+    test_inherit_inline();
+
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
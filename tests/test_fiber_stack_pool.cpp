@@ -0,0 +1,114 @@
+#include "dbspider.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int FIBERS = 100000;
+
+// 创建并跑完大量短生命周期协程，返回每个协程的平均耗时(ns)
+static double bench(uint32_t pool_max)
+{
+    dbspider::Config::Lookup<uint32_t>("fiber.stack_pool_max")->setValue(pool_max);
+    uint64_t hits = dbspider::Fiber::StackPoolHits();
+    uint64_t misses = dbspider::Fiber::StackPoolMisses();
+
+    int count = 0;
+    uint64_t begin = dbspider::GetCurrentUS();
+    for (int i = 0; i < FIBERS; ++i)
+    {
+        dbspider::Fiber::ptr fiber(new dbspider::Fiber([&count]
+                                                       { ++count; }));
+        fiber->resume();
+    }
+    uint64_t cost = dbspider::GetCurrentUS() - begin;
+    DBSPIDER_ASSERT(count == FIBERS);
+
+    hits = dbspider::Fiber::StackPoolHits() - hits;
+    misses = dbspider::Fiber::StackPoolMisses() - misses;
+    DBSPIDER_LOG_INFO(g_logger) << "stack_pool_max=" << pool_max << " fibers=" << FIBERS
+                                << " hits=" << hits << " misses=" << misses
+                                << " cost=" << cost << "us";
+    if (pool_max)
+    {
+        // 同一线程上依次创建销毁协程，除了第一次之外都应该命中栈池
+        DBSPIDER_ASSERT(misses <= 1);
+    }
+    return cost * 1000.0 / FIBERS;
+}
+
+// 缓存中的栈超过 warm 个之后反复创建销毁协程，取还的仍是保留物理内存的栈，不会每次重新缺页
+static void test_warm_end()
+{
+    dbspider::Config::Lookup<uint32_t>("fiber.stack_pool_max")->setValue(256);
+    uint32_t warm = dbspider::Config::Lookup<uint32_t>("fiber.stack_pool_warm")->getValue();
+    {
+        std::vector<dbspider::Fiber::ptr> fibers;
+        for (uint32_t i = 0; i < warm * 4; ++i)
+        {
+            fibers.emplace_back(new dbspider::Fiber([] {}));
+            fibers.back()->resume();
+        }
+    }
+
+    rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    uint64_t begin = dbspider::GetCurrentUS();
+    for (int i = 0; i < FIBERS; ++i)
+    {
+        dbspider::Fiber::ptr fiber(new dbspider::Fiber([] {}));
+        fiber->resume();
+    }
+    uint64_t cost = dbspider::GetCurrentUS() - begin;
+    getrusage(RUSAGE_SELF, &after);
+    long faults = after.ru_minflt - before.ru_minflt;
+    DBSPIDER_LOG_INFO(g_logger) << "pool above warm: fibers=" << FIBERS << " minor faults=" << faults
+                                << " cost=" << cost << "us";
+    DBSPIDER_ASSERT(faults < FIBERS / 10);
+}
+
+// 递归直到栈溢出，limit远大于协程栈能容纳的深度
+static int overflow(int depth, int limit)
+{
+    volatile char buf[1024];
+    buf[0] = (char)depth;
+    if (depth >= limit)
+    {
+        return buf[0];
+    }
+    return overflow(depth + 1, limit) + buf[0];
+}
+
+// 栈底保护页：协程栈溢出时应该直接触发SIGSEGV，而不是写坏相邻的内存
+static void test_guard_page()
+{
+    pid_t pid = fork();
+    DBSPIDER_ASSERT(pid >= 0);
+    if (pid == 0)
+    {
+        dbspider::Fiber::ptr fiber(new dbspider::Fiber([]
+                                                       { overflow(0, 1 << 20); }));
+        fiber->resume();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    DBSPIDER_LOG_INFO(g_logger) << "stack overflow child killed by signal "
+                                << (WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+    DBSPIDER_ASSERT(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+    dbspider::Fiber::EnableFiber();
+
+    double no_pool = bench(0);
+    double pool = bench(256);
+    DBSPIDER_LOG_INFO(g_logger) << "create+run+destroy a fiber: mmap every time " << no_pool
+                                << " ns, pooled " << pool << " ns";
+
+    test_warm_end();
+    test_guard_page();
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "dbspider.h"
+#include <ucontext.h>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const uint64_t SWITCHES = 2000000;
+static const size_t STACK_SIZE = 128 * 1024;
+
+// 每轮是一次切入加一次切出，共两次切换
+static double per_second(uint64_t rounds, uint64_t cost_us)
+{
+    return rounds * 2 * 1000000.0 / (cost_us ? cost_us : 1);
+}
+
+static ucontext_t s_main_uctx, s_uctx;
+
+static void ucontext_func()
+{
+    while (true)
+    {
+        swapcontext(&s_uctx, &s_main_uctx);
+    }
+}
+
+// ucontext 切换，swapcontext 每次都会调用 rt_sigprocmask
+static double bench_ucontext()
+{
+    std::unique_ptr<char[]> stack(new char[STACK_SIZE]);
+    getcontext(&s_uctx);
+    s_uctx.uc_stack.ss_sp = stack.get();
+    s_uctx.uc_stack.ss_size = STACK_SIZE;
+    s_uctx.uc_link = nullptr;
+    makecontext(&s_uctx, ucontext_func, 0);
+
+    uint64_t begin = dbspider::GetCurrentUS();
+    for (uint64_t i = 0; i < SWITCHES; ++i)
+    {
+        swapcontext(&s_main_uctx, &s_uctx);
+    }
+    return per_second(SWITCHES, dbspider::GetCurrentUS() - begin);
+}
+
+#ifndef DBSPIDER_FIBER_UCONTEXT
+static dbspider::fcontext_t s_main_fctx, s_fctx;
+
+static void fcontext_func()
+{
+    while (true)
+    {
+        dbspider::JumpFContext(&s_fctx, s_main_fctx);
+    }
+}
+
+// 汇编实现的切换，只保存被调用者保存寄存器
+static double bench_fcontext()
+{
+    std::unique_ptr<char[]> stack(new char[STACK_SIZE]);
+    s_fctx = dbspider::MakeFContext(stack.get(), STACK_SIZE, fcontext_func);
+
+    uint64_t begin = dbspider::GetCurrentUS();
+    for (uint64_t i = 0; i < SWITCHES; ++i)
+    {
+        dbspider::JumpFContext(&s_main_fctx, s_fctx);
+    }
+    return per_second(SWITCHES, dbspider::GetCurrentUS() - begin);
+}
+#endif
+
+// 完整的 Fiber::resume/yield，使用编译时选择的实现
+static double bench_fiber()
+{
+    dbspider::Fiber::ptr fiber(new dbspider::Fiber([]
+                                                   {
+                                                       for (uint64_t i = 0; i < SWITCHES; ++i)
+                                                       {
+                                                           dbspider::Fiber::YieldToHold();
+                                                       } }));
+    uint64_t begin = dbspider::GetCurrentUS();
+    for (uint64_t i = 0; i < SWITCHES; ++i)
+    {
+        fiber->resume();
+    }
+    uint64_t cost = dbspider::GetCurrentUS() - begin;
+    // 让协程执行完，析构时协程必须处于结束状态
+    fiber->resume();
+    return per_second(SWITCHES, cost);
+}
+
+int main(int argc, char **argv)
+{
+    dbspider::Fiber::EnableFiber();
+
+    DBSPIDER_LOG_INFO(g_logger) << "ucontext: " << (uint64_t)bench_ucontext() << " switches/s";
+#ifndef DBSPIDER_FIBER_UCONTEXT
+    DBSPIDER_LOG_INFO(g_logger) << "asm: " << (uint64_t)bench_fcontext() << " switches/s";
+#endif
+    DBSPIDER_LOG_INFO(g_logger) << "Fiber(" << dbspider::FiberContextBackend() << "): "
+                                << (uint64_t)bench_fiber() << " switches/s";
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include "dbspider.h"
+#include "fd_manager.h"
+
+#include <sys/socket.h>
+
+#include <algorithm>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int THREADS = 1;
+static const int SUBMITS = 2000;
+static const int ROUNDS = 5000;
+static const uint64_t SPIN_US = 200;
+
+static void set_spin(uint64_t us)
+{
+    dbspider::Config::Lookup<uint64_t>("scheduler.idle_spin_us")->setValue(us);
+}
+
+static std::string percentiles(std::vector<uint64_t> &samples)
+{
+    std::sort(samples.begin(), samples.end());
+    std::stringstream ss;
+    ss << "p50=" << samples[samples.size() / 2] << "us p99=" << samples[samples.size() * 99 / 100]
+       << "us max=" << samples.back() << "us";
+    return ss.str();
+}
+
+// 外部线程每隔一段时间提交一个任务，统计任务从提交到开始执行的延迟
+// 提交间隔小于自旋时间，开启自旋后任务在自旋中被取到，绝大多数提交不写 eventfd
+static void bench_submit(uint64_t spin)
+{
+    set_spin(spin);
+    dbspider::IOManager iom(THREADS, "submit");
+    DBSPIDER_ASSERT(iom.getIdleSpinUs() == spin);
+    std::vector<uint64_t> samples(SUBMITS);
+    std::atomic<int> done{0};
+    for (int i = 0; i < SUBMITS; ++i)
+    {
+        // 等调度线程进入空闲状态再提交
+        usleep(100);
+        uint64_t begin = dbspider::GetCurrentUS();
+        iom.submit([begin, i, &samples, &done]
+                   {
+                       samples[i] = dbspider::GetCurrentUS() - begin;
+                       ++done; });
+    }
+    while (done < SUBMITS)
+    {
+        usleep(1000);
+    }
+    dbspider::Scheduler::Stats stats = iom.getStats();
+    DBSPIDER_LOG_INFO(g_logger) << "submit spin=" << spin << "us: " << percentiles(samples)
+                                << " spin hits=" << iom.getIdleSpinHits() << " eventfd writes=" << stats.tickleWrites;
+    if (spin)
+    {
+        DBSPIDER_ASSERT(stats.tickleWrites < SUBMITS / 2);
+    }
+    iom.stop();
+}
+
+// 客户端和服务端各用一个调度器，通过 socketpair 一问一答，统计往返时间
+static void bench_echo(uint64_t spin)
+{
+    set_spin(spin);
+    std::vector<uint64_t> samples(ROUNDS);
+    std::atomic<int> done{0};
+    uint64_t hits = 0;
+    {
+        dbspider::IOManager server(THREADS, "server");
+        dbspider::IOManager client(THREADS, "client");
+        int fds[2];
+        DBSPIDER_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        // socketpair 没有被 hook，登记到 FdManager 后读写才会走 hook
+        dbspider::FdMgr::GetInstance()->get(fds[0], true);
+        dbspider::FdMgr::GetInstance()->get(fds[1], true);
+        int client_fd = fds[0], server_fd = fds[1];
+        server.submit([server_fd, &done]
+                      {
+                          char c;
+                          while (recv(server_fd, &c, 1, 0) == 1)
+                          {
+                              DBSPIDER_ASSERT(send(server_fd, &c, 1, 0) == 1);
+                          }
+                          close(server_fd);
+                          ++done; });
+        client.submit([client_fd, &samples, &done]
+                      {
+                          char c = 'x';
+                          for (int i = 0; i < ROUNDS; ++i)
+                          {
+                              uint64_t begin = dbspider::GetCurrentUS();
+                              DBSPIDER_ASSERT(send(client_fd, &c, 1, 0) == 1);
+                              DBSPIDER_ASSERT(recv(client_fd, &c, 1, 0) == 1);
+                              samples[i] = dbspider::GetCurrentUS() - begin;
+                          }
+                          close(client_fd);
+                          ++done; });
+        while (done < 2)
+        {
+            usleep(1000);
+        }
+        hits = server.getIdleSpinHits() + client.getIdleSpinHits();
+        client.stop();
+        server.stop();
+    }
+    DBSPIDER_LOG_INFO(g_logger) << "echo spin=" << spin << "us: " << percentiles(samples) << " spin hits=" << hits;
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    bench_submit(0);
+    bench_submit(SPIN_US);
+    bench_echo(0);
+    bench_echo(SPIN_US);
+
+    set_spin(0);
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
@@ -0,0 +1,214 @@
+#include "dbspider.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int THREADS = 2;
+static const int CONNS = 32;
+static const int ROUNDS = 2000;
+static const size_t MSG_SIZE = 64;
+
+static void set_backend(const std::string &backend)
+{
+    dbspider::Config::Lookup<std::string>("iomanager.io_backend")->setValue(backend);
+}
+
+// 在 127.0.0.1 的随机端口上监听，返回监听的 fd 和地址
+static int listen_any(sockaddr_in &addr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    DBSPIDER_ASSERT(fd >= 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    DBSPIDER_ASSERT(bind(fd, (sockaddr *)&addr, sizeof(addr)) == 0);
+    DBSPIDER_ASSERT(listen(fd, 1024) == 0);
+    socklen_t len = sizeof(addr);
+    DBSPIDER_ASSERT(getsockname(fd, (sockaddr *)&addr, &len) == 0);
+    return fd;
+}
+
+static void echo(int fd)
+{
+    char buf[MSG_SIZE];
+    while (true)
+    {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+        {
+            break;
+        }
+        if (send(fd, buf, n, 0) != n)
+        {
+            break;
+        }
+    }
+    close(fd);
+}
+
+// CONNS 个连接各做 ROUNDS 次一问一答，返回每秒完成的往返次数
+static double bench_echo(const std::string &backend)
+{
+    set_backend(backend);
+    std::atomic<int> done{0};
+    double qps = 0;
+    {
+        dbspider::IOManager iom(THREADS, backend);
+        DBSPIDER_LOG_INFO(g_logger) << backend << ": io_uring=" << iom.isIoUring();
+
+        sockaddr_in addr;
+        int listen_fd = listen_any(addr);
+        iom.submit([listen_fd]
+                   {
+                       for (int i = 0; i < CONNS; ++i)
+                       {
+                           int fd = accept(listen_fd, nullptr, nullptr);
+                           DBSPIDER_ASSERT(fd >= 0);
+                           dbspider::IOManager::GetThis()->submit([fd]
+                                                                  { echo(fd); });
+                       }
+                       close(listen_fd); });
+
+        uint64_t begin = dbspider::GetCurrentUS();
+        for (int i = 0; i < CONNS; ++i)
+        {
+            iom.submit([addr, &done]
+                       {
+                           int fd = socket(AF_INET, SOCK_STREAM, 0);
+                           DBSPIDER_ASSERT(connect(fd, (const sockaddr *)&addr, sizeof(addr)) == 0);
+                           char buf[MSG_SIZE];
+                           memset(buf, 'x', sizeof(buf));
+                           for (int j = 0; j < ROUNDS; ++j)
+                           {
+                               DBSPIDER_ASSERT(send(fd, buf, sizeof(buf), 0) == (ssize_t)sizeof(buf));
+                               size_t got = 0;
+                               while (got < sizeof(buf))
+                               {
+                                   ssize_t n = recv(fd, buf + got, sizeof(buf) - got, 0);
+                                   DBSPIDER_ASSERT(n > 0);
+                                   got += n;
+                               }
+                           }
+                           close(fd);
+                           ++done; });
+        }
+        while (done < CONNS)
+        {
+            usleep(1000);
+        }
+        uint64_t cost = dbspider::GetCurrentUS() - begin;
+        qps = (double)CONNS * ROUNDS * 1000000 / cost;
+        DBSPIDER_LOG_INFO(g_logger) << backend << ": " << CONNS * ROUNDS << " round trips cost "
+                                    << cost << " us, " << (uint64_t)qps << " round trips/s";
+        iom.stop();
+    }
+    return qps;
+}
+
+// 设置了接收超时的 recv 超时返回 ETIMEDOUT，阻塞在 recv 上的连接被 close 后返回 EBADF
+static void test_timeout_and_close(const std::string &backend)
+{
+    set_backend(backend);
+    std::atomic<int> done{0};
+    dbspider::IOManager iom(THREADS, backend);
+    sockaddr_in addr;
+    int listen_fd = listen_any(addr);
+    iom.submit([listen_fd, addr, &done]
+               {
+                   int client = socket(AF_INET, SOCK_STREAM, 0);
+                   DBSPIDER_ASSERT(connect(client, (const sockaddr *)&addr, sizeof(addr)) == 0);
+                   int server = accept(listen_fd, nullptr, nullptr);
+                   DBSPIDER_ASSERT(server >= 0);
+
+                   timeval tv{0, 50 * 1000};
+                   setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                   char buf[16];
+                   uint64_t begin = dbspider::GetCurrentMS();
+                   ssize_t n = recv(client, buf, sizeof(buf), 0);
+                   uint64_t cost = dbspider::GetCurrentMS() - begin;
+                   DBSPIDER_ASSERT(n == -1 && errno == ETIMEDOUT);
+                   DBSPIDER_ASSERT(cost >= 45 && cost < 1000);
+
+                   dbspider::IOManager::GetThis()->addTimer(50, [server]
+                                                            { close(server); });
+                   n = recv(server, buf, sizeof(buf), 0);
+                   DBSPIDER_ASSERT(n == -1 && errno == EBADF);
+
+                   close(client);
+                   close(listen_fd);
+                   ++done; });
+    iom.stop();
+    DBSPIDER_ASSERT(done == 1);
+    DBSPIDER_LOG_INFO(g_logger) << backend << ": timeout and close passed";
+}
+
+// 阻塞在 recv/connect 上的协程，令牌取消后返回 ECANCELED，到达令牌截止时间后返回 ETIMEDOUT，连接本身仍然可用
+static void test_cancel(const std::string &backend)
+{
+    set_backend(backend);
+    std::atomic<int> done{0};
+    dbspider::IOManager iom(THREADS, backend);
+    sockaddr_in addr;
+    int listen_fd = listen_any(addr);
+    iom.submit([listen_fd, addr, &done]
+               {
+                   int client = socket(AF_INET, SOCK_STREAM, 0);
+                   DBSPIDER_ASSERT(connect(client, (const sockaddr *)&addr, sizeof(addr)) == 0);
+                   int server = accept(listen_fd, nullptr, nullptr);
+                   DBSPIDER_ASSERT(server >= 0);
+                   char buf[16];
+
+                   dbspider::CancelToken::ptr token = dbspider::CancelToken::Create();
+                   dbspider::IOManager::GetThis()->addTimer(50, [token]
+                                                            { token->cancel(); });
+                   uint64_t begin = dbspider::GetCurrentMS();
+                   {
+                       dbspider::CancelToken::Scope scope(token);
+                       ssize_t n = recv(client, buf, sizeof(buf), 0);
+                       DBSPIDER_ASSERT(n == -1 && errno == ECANCELED);
+                   }
+                   uint64_t cost = dbspider::GetCurrentMS() - begin;
+                   DBSPIDER_ASSERT(cost >= 45 && cost < 1000);
+
+                   begin = dbspider::GetCurrentMS();
+                   {
+                       dbspider::CancelToken::Scope scope(dbspider::CancelToken::Create(50));
+                       ssize_t n = recv(client, buf, sizeof(buf), 0);
+                       DBSPIDER_ASSERT(n == -1 && errno == ETIMEDOUT);
+                   }
+                   cost = dbspider::GetCurrentMS() - begin;
+                   DBSPIDER_ASSERT(cost >= 45 && cost < 1000);
+
+                   // 取消的 recv 没有读走数据
+                   DBSPIDER_ASSERT(send(server, "ping", 4, 0) == 4);
+                   DBSPIDER_ASSERT(recv(client, buf, sizeof(buf), 0) == 4);
+
+                   close(server);
+                   close(client);
+                   close(listen_fd);
+                   ++done; });
+    iom.stop();
+    DBSPIDER_ASSERT(done == 1);
+    DBSPIDER_LOG_INFO(g_logger) << backend << ": cancel passed";
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    test_timeout_and_close("epoll");
+    test_timeout_and_close("io_uring");
+    test_cancel("epoll");
+    test_cancel("io_uring");
+
+    double epoll_qps = bench_echo("epoll");
+    double uring_qps = bench_echo("io_uring");
+    DBSPIDER_LOG_INFO(g_logger) << "io_uring / epoll = " << uring_qps / epoll_qps;
+    set_backend("epoll");
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
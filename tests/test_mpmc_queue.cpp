@@ -0,0 +1,211 @@
+#include "dbspider.h"
+
+#include <algorithm>
+#include <list>
+#include <thread>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int PRODUCERS = 4;
+static const int CONSUMERS = 4;
+static const int ITEMS = 200000; // 每个生产者的元素数
+
+// 元素只能移动，高 16 位是生产者编号，低位是生产者内的序号
+using Item = std::unique_ptr<uint64_t>;
+
+// 容量很小的队列上多生产者多消费者并发收发，每个元素恰好取出一次，同一生产者的元素保持先后顺序
+static void test_stress()
+{
+    dbspider::MpmcQueue<Item> queue(64);
+    DBSPIDER_ASSERT(queue.capacity() == 64);
+    std::atomic<int> consumed{0};
+    std::vector<std::vector<uint8_t>> seen(PRODUCERS, std::vector<uint8_t>(ITEMS));
+    std::vector<std::thread> threads;
+    for (int p = 0; p < PRODUCERS; ++p)
+    {
+        threads.emplace_back([&queue, p]
+                             {
+                                 for (int i = 0; i < ITEMS; ++i)
+                                 {
+                                     Item item(new uint64_t(((uint64_t)p << 48) | i));
+                                     // 满了之后 item 保持不变，重试
+                                     while (!queue.push(std::move(item)))
+                                     {
+                                         DBSPIDER_ASSERT(item);
+                                         std::this_thread::yield();
+                                     }
+                                 } });
+    }
+    for (int c = 0; c < CONSUMERS; ++c)
+    {
+        threads.emplace_back([&queue, &consumed, &seen]
+                             {
+                                 std::vector<int64_t> last(PRODUCERS, -1);
+                                 Item item;
+                                 while (consumed < PRODUCERS * ITEMS)
+                                 {
+                                     if (!queue.pop(item))
+                                     {
+                                         std::this_thread::yield();
+                                         continue;
+                                     }
+                                     int p = *item >> 48;
+                                     int64_t i = *item & 0xffffffffffff;
+                                     DBSPIDER_ASSERT(i > last[p]);
+                                     last[p] = i;
+                                     DBSPIDER_ASSERT(!seen[p][i]);
+                                     seen[p][i] = 1;
+                                     ++consumed;
+                                 } });
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    DBSPIDER_ASSERT(queue.empty());
+    for (auto &v : seen)
+    {
+        DBSPIDER_ASSERT(std::find(v.begin(), v.end(), 0) == v.end());
+    }
+}
+
+// 互斥锁保护的 std::list ，原来的全局任务队列
+template <typename T>
+class LockedList
+{
+public:
+    bool push(T &&v)
+    {
+        dbspider::Mutex::Lock lock(m_mutex);
+        m_list.push_back(std::move(v));
+        return true;
+    }
+
+    bool pop(T &v)
+    {
+        dbspider::Mutex::Lock lock(m_mutex);
+        if (m_list.empty())
+        {
+            return false;
+        }
+        v = std::move(m_list.front());
+        m_list.pop_front();
+        return true;
+    }
+
+private:
+    dbspider::Mutex m_mutex;
+    std::list<T> m_list;
+};
+
+// producers 个线程入队、同样多的线程出队，返回每秒收发的元素数
+template <typename Queue>
+static double run_bench(Queue &queue, int producers)
+{
+    const int items = ITEMS / 2;
+    std::atomic<int> consumed{0};
+    std::vector<std::thread> threads;
+    uint64_t start = dbspider::GetCurrentUS();
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&queue]
+                             {
+                                 for (int i = 0; i < items; ++i)
+                                 {
+                                     while (!queue.push(uint64_t(i)))
+                                     {
+                                         std::this_thread::yield();
+                                     }
+                                 } });
+        threads.emplace_back([&queue, &consumed, producers]
+                             {
+                                 uint64_t v;
+                                 while (consumed < producers * items)
+                                 {
+                                     if (queue.pop(v))
+                                     {
+                                         ++consumed;
+                                     }
+                                     else
+                                     {
+                                         std::this_thread::yield();
+                                     }
+                                 } });
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    uint64_t us = std::max<uint64_t>(dbspider::GetCurrentUS() - start, 1);
+    return (double)producers * items * 1000000 / us;
+}
+
+static void bench_queue()
+{
+    for (int producers : {1, 2, 4})
+    {
+        dbspider::MpmcQueue<uint64_t> mpmc(1024);
+        LockedList<uint64_t> locked;
+        double mpmc_ops = run_bench(mpmc, producers);
+        double locked_ops = run_bench(locked, producers);
+        DBSPIDER_LOG_INFO(g_logger) << producers << " producers x " << producers << " consumers: mpmc "
+                                    << (uint64_t)mpmc_ops << " ops/s, mutex + std::list "
+                                    << (uint64_t)locked_ops << " ops/s";
+    }
+}
+
+// 多个外部线程向 IOManager 提交任务，返回全部执行完的耗时(us)
+static uint64_t submit_from_threads(uint64_t inject_capacity, int tasks)
+{
+    dbspider::Config::Lookup<uint64_t>("scheduler.inject_capacity")->setValue(inject_capacity);
+    std::atomic<int> done{0};
+    dbspider::IOManager iom(2, "inject");
+    uint64_t start = dbspider::GetCurrentUS();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < PRODUCERS; ++p)
+    {
+        threads.emplace_back([&iom, &done, tasks]
+                             {
+                                 for (int i = 0; i < tasks; ++i)
+                                 {
+                                     iom.submit([&done]
+                                                { ++done; });
+                                 } });
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    while (done < PRODUCERS * tasks)
+    {
+        usleep(100);
+    }
+    uint64_t us = dbspider::GetCurrentUS() - start;
+    iom.stop();
+    DBSPIDER_ASSERT(done == PRODUCERS * tasks);
+    return us;
+}
+
+// 注入队列容量很小时大部分任务进入溢出队列，全部任务仍然执行完；与只用加锁队列比较吞吐
+static void test_scheduler_inject()
+{
+    const int tasks = 50000;
+    submit_from_threads(4, tasks);
+    uint64_t lock_free = submit_from_threads(1024, tasks);
+    uint64_t locked = submit_from_threads(0, tasks);
+    DBSPIDER_LOG_INFO(g_logger) << PRODUCERS << " threads submit " << PRODUCERS * tasks << " tasks: lock-free injection "
+                                << lock_free << "us, mutex only " << locked << "us";
+    dbspider::Config::Lookup<uint64_t>("scheduler.inject_capacity")->setValue(0);
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    test_stress();
+    bench_queue();
+    test_scheduler_inject();
+
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include "dbspider.h"
+#include "tcp_server.h"
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int SERVER_THREADS = 4;
+static const int CLIENT_THREADS = 2;
+static const int CONNS = 32;
+static const int ROUNDS = 1000;
+static const size_t MSG_SIZE = 64;
+
+static std::atomic<int> g_served{0};
+static std::atomic<int> g_migrations{0};
+static std::atomic<int> g_connections[SERVER_THREADS];
+
+// 回显服务器，记录处理协程是否一直在连接所属的线程上执行
+class EchoServer : public dbspider::TcpServer
+{
+public:
+    using ptr = std::shared_ptr<EchoServer>;
+
+    EchoServer(dbspider::IOManager *worker)
+        : TcpServer(worker, worker)
+    {
+    }
+
+    dbspider::Address::ptr getAddress() { return m_listens[0]->getLocalAddress(); }
+
+protected:
+    void handleClient(dbspider::Socket::ptr client) override
+    {
+        int owner = m_worker->getFdOwner(client->getSocket());
+        int expect = owner >= 0 ? m_worker->getThreadId(owner) : -1;
+        if (owner >= 0)
+        {
+            ++g_connections[owner];
+        }
+        char buf[MSG_SIZE];
+        while (true)
+        {
+            if (expect != -1 && dbspider::GetThreadId() != expect)
+            {
+                ++g_migrations;
+            }
+            ssize_t n = client->recv(buf, sizeof(buf));
+            if (n <= 0)
+            {
+                break;
+            }
+            if (client->send(buf, n) != n)
+            {
+                break;
+            }
+        }
+        client->close();
+        ++g_served;
+    }
+};
+
+static void run(dbspider::IOManager &clients, bool multi_reactor, const std::string &balance)
+{
+    dbspider::Config::Lookup<bool>("iomanager.multi_reactor")->setValue(multi_reactor);
+    dbspider::Config::Lookup<std::string>("tcp_server.balance")->setValue(balance);
+    g_served = 0;
+    g_migrations = 0;
+    for (auto &count : g_connections)
+    {
+        count = 0;
+    }
+
+    std::string name = multi_reactor ? "multi_reactor/" + balance : "shared_epoll";
+    {
+        dbspider::IOManager server(SERVER_THREADS, name);
+        DBSPIDER_ASSERT(server.isMultiReactor() == multi_reactor);
+        EchoServer::ptr echo(new EchoServer(&server));
+        DBSPIDER_ASSERT(echo->bind(dbspider::IPv4Address::Create("127.0.0.1", 0)));
+        dbspider::Address::ptr addr = echo->getAddress();
+        echo->start();
+
+        std::atomic<int> done{0};
+        uint64_t begin = dbspider::GetCurrentUS();
+        for (int i = 0; i < CONNS; ++i)
+        {
+            clients.submit([addr, &done]
+                           {
+                               dbspider::Socket::ptr sock = dbspider::Socket::CreateTCP(addr);
+                               DBSPIDER_ASSERT(sock->connect(addr));
+                               char buf[MSG_SIZE];
+                               memset(buf, 'x', sizeof(buf));
+                               for (int j = 0; j < ROUNDS; ++j)
+                               {
+                                   DBSPIDER_ASSERT(sock->send(buf, sizeof(buf)) == (ssize_t)sizeof(buf));
+                                   size_t got = 0;
+                                   while (got < sizeof(buf))
+                                   {
+                                       ssize_t n = sock->recv(buf + got, sizeof(buf) - got);
+                                       DBSPIDER_ASSERT(n > 0);
+                                       got += n;
+                                   }
+                               }
+                               sock->close();
+                               ++done; });
+        }
+        while (done < CONNS || g_served < CONNS)
+        {
+            usleep(1000);
+        }
+        uint64_t cost = dbspider::GetCurrentUS() - begin;
+        echo->stop();
+
+        std::stringstream ss;
+        for (auto &count : g_connections)
+        {
+            ss << count << " ";
+        }
+        DBSPIDER_LOG_INFO(g_logger) << name << ": " << CONNS * ROUNDS << " round trips cost " << cost << " us, "
+                                    << (uint64_t)CONNS * ROUNDS * 1000000 / cost << " round trips/s, "
+                                    << "migrations=" << g_migrations << " connections per thread: " << ss.str();
+        server.stop();
+    }
+
+    if (multi_reactor)
+    {
+        // 处理协程始终在连接所属的线程上执行
+        DBSPIDER_ASSERT(g_migrations == 0);
+        int total = 0;
+        for (auto &count : g_connections)
+        {
+            DBSPIDER_ASSERT(count > 0);
+            if (balance == "round_robin")
+            {
+                DBSPIDER_ASSERT(count == CONNS / SERVER_THREADS);
+            }
+            total += count;
+        }
+        DBSPIDER_ASSERT(total == CONNS);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    dbspider::IOManager clients(CLIENT_THREADS, "clients");
+    run(clients, false, "round_robin");
+    run(clients, true, "round_robin");
+    run(clients, true, "least_loaded");
+
+    dbspider::Config::Lookup<bool>("iomanager.multi_reactor")->setValue(false);
+    dbspider::Config::Lookup<std::string>("tcp_server.balance")->setValue("round_robin");
+    clients.stop();
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "dbspider.h"
+
+#include <signal.h>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int PINNED_TASKS = 10000;
+static const int PROBE_TASKS = 1000;
+
+static std::atomic<bool> s_release{false};
+static std::atomic<int> s_pinned_done{0};
+static std::atomic<int> s_probe_done{0};
+static std::atomic<uint64_t> s_probe_latency{0};
+static std::atomic<int> s_app_signals{0};
+
+// 应用自己在唤醒信号上安装的处理函数
+static void on_app_signal(int)
+{
+    ++s_app_signals;
+}
+
+// 占住目标线程，让专属任务在它的队列里堆积
+static void busy_task()
+{
+    while (!s_release)
+        ;
+}
+
+// 在积压了 PINNED_TASKS 个其他线程专属任务的情况下，测量其他任务从提交到开始执行的延迟
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+    signal(SIGRTMIN, on_app_signal);
+
+    dbspider::IOManager iom(2, "pinned");
+    std::atomic<int> busy_thread{0};
+    iom.submit([&busy_thread]
+               { busy_thread = dbspider::GetThreadId(); });
+    while (!busy_thread)
+    {
+        usleep(1000);
+    }
+
+    iom.submit(&busy_task, busy_thread);
+    for (int i = 0; i < PINNED_TASKS; ++i)
+    {
+        iom.submit([]
+                   { ++s_pinned_done; },
+                   busy_thread);
+    }
+
+    for (int i = 0; i < PROBE_TASKS; ++i)
+    {
+        uint64_t begin = dbspider::GetCurrentUS();
+        iom.submit([begin]
+                   {
+                       s_probe_latency += dbspider::GetCurrentUS() - begin;
+                       ++s_probe_done; });
+        while (s_probe_done <= i)
+            ;
+    }
+    DBSPIDER_LOG_INFO(g_logger) << PINNED_TASKS << " pinned tasks queued, avg dequeue latency of other tasks: "
+                                << s_probe_latency / PROBE_TASKS << " us";
+
+    // 放开目标线程，测量专属队列的出队速度
+    uint64_t begin = dbspider::GetCurrentUS();
+    s_release = true;
+    while (s_pinned_done < PINNED_TASKS)
+    {
+        usleep(100);
+    }
+    uint64_t cost = dbspider::GetCurrentUS() - begin;
+    DBSPIDER_LOG_INFO(g_logger) << "drain " << PINNED_TASKS << " pinned tasks cost " << cost
+                                << " us, avg " << (double)cost / PINNED_TASKS << " us/task";
+
+    // 空闲线程的专属任务应被定向唤醒立即执行，而不是等到 epoll_wait 超时
+    usleep(100 * 1000);
+    std::atomic<uint64_t> wake_latency{0};
+    begin = dbspider::GetCurrentUS();
+    iom.submit([&wake_latency, begin]
+               { wake_latency = dbspider::GetCurrentUS() - begin; },
+               busy_thread);
+    while (!wake_latency)
+    {
+        usleep(100);
+    }
+    DBSPIDER_LOG_INFO(g_logger) << "wake idle owner thread latency: " << wake_latency << " us";
+    DBSPIDER_ASSERT(wake_latency < 1000 * 1000);
+
+    // 定向唤醒不会打扰应用原来的处理函数，应用自己的信号仍然交给它
+    DBSPIDER_ASSERT(s_app_signals == 0);
+    raise(SIGRTMIN);
+    DBSPIDER_ASSERT(s_app_signals == 1);
+    return 0;
+}
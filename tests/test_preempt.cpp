@@ -0,0 +1,94 @@
+#include "dbspider.h"
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const uint64_t HOG_MS = 200;
+
+struct Result
+{
+    uint64_t waitUs = 0; // 计算任务开始之后提交的任务等了多久才执行
+    uint64_t preempts = 0;
+    dbspider::Scheduler::Stats stats;
+};
+
+// 单线程上一个协程连续计算 HOG_MS 毫秒，在循环中经过检查点；返回之后提交的任务等待的时间
+static Result run_hog(uint64_t slice_us, uint64_t warn_ms, bool use_mutex)
+{
+    dbspider::Config::Lookup<uint64_t>("scheduler.preempt_slice_us")->setValue(slice_us);
+    dbspider::Config::Lookup<uint64_t>("scheduler.long_run_warn_ms")->setValue(warn_ms);
+    dbspider::IOManager iom(1, "preempt");
+    dbspider::CoMutex mutex;
+    std::atomic<bool> started{false};
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> wait_us{0};
+    uint64_t preempts = dbspider::Fiber::TotalPreempts();
+
+    iom.submit([&]
+               {
+                   started = true;
+                   uint64_t end = dbspider::GetCurrentMS() + HOG_MS;
+                   while (dbspider::GetCurrentMS() < end)
+                   {
+                       if (use_mutex)
+                       {
+                           // CoMutex 加锁是检查点
+                           dbspider::CoMutex::Lock lock(mutex);
+                       }
+                       else
+                       {
+                           dbspider::Fiber::MaybeYield();
+                       }
+                   }
+                   done = true; });
+    while (!started)
+    {
+        usleep(100);
+    }
+    uint64_t begin = dbspider::GetCurrentUS();
+    iom.submit([&wait_us, begin]
+               { wait_us = dbspider::GetCurrentUS() - begin; });
+    while (!done || !wait_us)
+    {
+        usleep(1000);
+    }
+    iom.stop();
+
+    Result result;
+    result.waitUs = wait_us;
+    result.preempts = dbspider::Fiber::TotalPreempts() - preempts;
+    result.stats = iom.getStats();
+    DBSPIDER_LOG_INFO(g_logger) << "slice=" << slice_us << "us" << (use_mutex ? " (CoMutex)" : "")
+                                << ": task waits " << result.waitUs << "us, " << result.preempts << " preempts, "
+                                << result.stats.preemptRequests << " requests, max run "
+                                << result.stats.maxRunUs << "us, " << result.stats.longRuns << " long runs";
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::ERROR);
+
+    // 不在调度线程上什么都不做
+    DBSPIDER_ASSERT(!dbspider::Fiber::MaybeYield());
+
+    // 不开启抢占：后提交的任务要等计算结束，长时间运行被报告
+    Result off = run_hog(0, 50, false);
+    DBSPIDER_ASSERT(off.preempts == 0 && off.stats.preemptRequests == 0);
+    DBSPIDER_ASSERT(off.waitUs > HOG_MS * 1000 / 2);
+    DBSPIDER_ASSERT(off.stats.maxRunUs >= HOG_MS * 1000 * 9 / 10);
+    DBSPIDER_ASSERT(off.stats.longRuns == 1);
+
+    // 5ms 时间片：计算协程在检查点让出，其他任务不再等到计算结束
+    for (bool use_mutex : {false, true})
+    {
+        Result on = run_hog(5000, 0, use_mutex);
+        DBSPIDER_ASSERT(on.preempts > 0 && on.stats.preemptRequests >= on.preempts);
+        DBSPIDER_ASSERT(on.waitUs < HOG_MS * 1000 / 4);
+        DBSPIDER_ASSERT(on.stats.maxRunUs < HOG_MS * 1000 / 2);
+        DBSPIDER_ASSERT(on.stats.longRuns == 0);
+    }
+
+    dbspider::Config::Lookup<uint64_t>("scheduler.preempt_slice_us")->setValue(0);
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "dbspider.h"
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int FLOOD = 400;
+static const uint64_t FLOOD_US = 1000;
+
+// 忙等 us 微秒，模拟不让出的任务
+static void busy(uint64_t us)
+{
+    uint64_t end = dbspider::GetCurrentUS() + us;
+    while (dbspider::GetCurrentUS() < end)
+        ;
+}
+
+// 调度线程被占住时提交 5 个普通任务和 5 个高优先级任务，返回执行顺序
+static std::string run_order(uint32_t burst)
+{
+    dbspider::Config::Lookup<uint32_t>("scheduler.high_priority_burst")->setValue(burst);
+    dbspider::IOManager iom(1, "order");
+    std::atomic<bool> release{false};
+    std::atomic<int> done{0};
+    dbspider::Mutex mutex;
+    std::string order;
+    iom.submit([&release]
+               {
+                   while (!release)
+                       ;
+               });
+    usleep(10 * 1000);
+    for (char c : {'n', 'h'})
+    {
+        for (int i = 0; i < 5; ++i)
+        {
+            iom.submit([&, c]
+                       {
+                           dbspider::Mutex::Lock lock(mutex);
+                           order.push_back(c);
+                           ++done; },
+                       -1, c == 'h' ? dbspider::Fiber::HIGH : dbspider::Fiber::NORMAL);
+        }
+    }
+    release = true;
+    while (done < 10)
+    {
+        usleep(1000);
+    }
+    iom.stop();
+    DBSPIDER_LOG_INFO(g_logger) << "burst " << burst << ": " << order;
+    return order;
+}
+
+// 普通任务积压时，高优先级任务、高优先级协程睡眠醒来和高优先级定时器都不用排队
+static void test_latency()
+{
+    dbspider::Config::Lookup<uint32_t>("scheduler.high_priority_burst")->setValue(8);
+    dbspider::IOManager iom(1, "latency");
+    std::atomic<int> flood{0};
+    std::atomic<uint64_t> high_us{0};
+    std::atomic<uint64_t> normal_us{0};
+    std::atomic<uint64_t> wake_us{0};
+    std::atomic<uint64_t> timer_us{0};
+
+    // 高优先级协程睡眠 20ms ，醒来时普通任务还在积压
+    iom.submit([&wake_us]
+               {
+                   uint64_t begin = dbspider::GetCurrentUS();
+                   usleep(20 * 1000);
+                   wake_us = dbspider::GetCurrentUS() - begin; },
+               -1, dbspider::Fiber::HIGH);
+    usleep(5 * 1000);
+    uint64_t timer_begin = dbspider::GetCurrentUS();
+    iom.addTimer(20, [&timer_us, timer_begin]
+                 { timer_us = dbspider::GetCurrentUS() - timer_begin; })
+        ->setPriority(dbspider::Fiber::HIGH);
+
+    for (int i = 0; i < FLOOD; ++i)
+    {
+        iom.submit([&flood]
+                   {
+                       busy(FLOOD_US);
+                       ++flood; });
+    }
+    uint64_t begin = dbspider::GetCurrentUS();
+    iom.submit([&normal_us, begin]
+               { normal_us = dbspider::GetCurrentUS() - begin; });
+    iom.submit([&high_us, begin]
+               { high_us = dbspider::GetCurrentUS() - begin; },
+               -1, dbspider::Fiber::HIGH);
+    while (!normal_us)
+    {
+        usleep(1000);
+    }
+    iom.stop();
+    DBSPIDER_LOG_INFO(g_logger) << "with " << FLOOD << " x " << FLOOD_US << "us normal tasks queued: high task waits "
+                                << high_us << "us, normal task waits " << normal_us << "us, high fiber sleeps 20ms for "
+                                << wake_us << "us, high timer of 20ms fires after " << timer_us << "us";
+    DBSPIDER_ASSERT(high_us && wake_us && timer_us);
+    DBSPIDER_ASSERT(normal_us > FLOOD * FLOOD_US / 2);
+    DBSPIDER_ASSERT(high_us < normal_us / 10);
+    DBSPIDER_ASSERT(wake_us < 20 * 1000 + normal_us / 10);
+    DBSPIDER_ASSERT(timer_us < 20 * 1000 + normal_us / 10);
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    // 严格优先：高优先级任务全部先执行
+    DBSPIDER_ASSERT(run_order(0) == "hhhhhnnnnn");
+    // 加权：连续执行两个高优先级任务后让一个普通任务执行
+    DBSPIDER_ASSERT(run_order(2) == "hhnhhnhnnn");
+    test_latency();
+
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
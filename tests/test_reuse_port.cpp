@@ -0,0 +1,130 @@
+#include "dbspider.h"
+#include "tcp_server.h"
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int SERVER_THREADS = 4;
+static const int CLIENT_THREADS = 2;
+static const int CLIENTS = 16;
+static const int CONNECTS = 200;
+
+static std::atomic<int> g_served{0};
+static std::atomic<int> g_connections[SERVER_THREADS];
+
+// 读到对端关闭为止，统计每个线程处理的连接数
+class DrainServer : public dbspider::TcpServer
+{
+public:
+    using ptr = std::shared_ptr<DrainServer>;
+
+    DrainServer(dbspider::IOManager *worker)
+        : TcpServer(worker, worker)
+    {
+    }
+
+    dbspider::Address::ptr getAddress() { return m_listens[0]->getLocalAddress(); }
+
+    size_t getListenCount() const { return m_listens.size(); }
+
+protected:
+    void handleClient(dbspider::Socket::ptr client) override
+    {
+        int index = -1;
+        for (int i = 0; i < SERVER_THREADS; ++i)
+        {
+            if (m_worker->getThreadId(i) == dbspider::GetThreadId())
+            {
+                index = i;
+            }
+        }
+        DBSPIDER_ASSERT(index >= 0);
+        ++g_connections[index];
+        char buf[64];
+        while (client->recv(buf, sizeof(buf)) > 0)
+            ;
+        client->close();
+        ++g_served;
+    }
+};
+
+// CLIENTS 个协程各建立 CONNECTS 次短连接，返回每秒建立的连接数
+static uint64_t run(dbspider::IOManager &clients, bool reuse_port, bool multi_reactor)
+{
+    dbspider::Config::Lookup<bool>("tcp_server.reuse_port")->setValue(reuse_port);
+    dbspider::Config::Lookup<bool>("iomanager.multi_reactor")->setValue(multi_reactor);
+    g_served = 0;
+    for (auto &count : g_connections)
+    {
+        count = 0;
+    }
+
+    std::string name = std::string(reuse_port ? "reuse_port" : "single_acceptor") +
+                       (multi_reactor ? "/multi_reactor" : "");
+    uint64_t rate = 0;
+    {
+        dbspider::IOManager server(SERVER_THREADS, name);
+        DrainServer::ptr drain(new DrainServer(&server));
+        DBSPIDER_ASSERT(drain->bind(dbspider::IPv4Address::Create("127.0.0.1", 0)));
+        DBSPIDER_ASSERT(drain->getListenCount() == (reuse_port ? SERVER_THREADS : 1));
+        dbspider::Address::ptr addr = drain->getAddress();
+        drain->start();
+
+        std::atomic<int> done{0};
+        uint64_t begin = dbspider::GetCurrentUS();
+        for (int i = 0; i < CLIENTS; ++i)
+        {
+            clients.submit([addr, &done]
+                           {
+                               for (int j = 0; j < CONNECTS; ++j)
+                               {
+                                   dbspider::Socket::ptr sock = dbspider::Socket::CreateTCP(addr);
+                                   DBSPIDER_ASSERT(sock->connect(addr));
+                                   DBSPIDER_ASSERT(sock->send("x", 1) == 1);
+                                   sock->close();
+                               }
+                               ++done; });
+        }
+        while (done < CLIENTS || g_served < CLIENTS * CONNECTS)
+        {
+            usleep(1000);
+        }
+        uint64_t cost = dbspider::GetCurrentUS() - begin;
+        rate = (uint64_t)CLIENTS * CONNECTS * 1000000 / cost;
+        drain->stop();
+
+        std::stringstream ss;
+        for (auto &count : g_connections)
+        {
+            ss << count << " ";
+        }
+        DBSPIDER_LOG_INFO(g_logger) << name << ": " << CLIENTS * CONNECTS << " connections cost " << cost << " us, "
+                                    << rate << " connections/s, connections per thread: " << ss.str();
+        server.stop();
+    }
+
+    if (reuse_port)
+    {
+        // 内核把新连接分给了每个监听socket
+        for (auto &count : g_connections)
+        {
+            DBSPIDER_ASSERT(count > 0);
+        }
+    }
+    return rate;
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    dbspider::IOManager clients(CLIENT_THREADS, "clients");
+    run(clients, false, false);
+    run(clients, true, false);
+    run(clients, true, true);
+
+    dbspider::Config::Lookup<bool>("tcp_server.reuse_port")->setValue(false);
+    dbspider::Config::Lookup<bool>("iomanager.multi_reactor")->setValue(false);
+    clients.stop();
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
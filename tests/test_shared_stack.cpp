@@ -0,0 +1,161 @@
+#include "dbspider.h"
+#include "fd_manager.h"
+
+#include <fstream>
+#include <sys/socket.h>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int PARKED_FIBERS = 10000;
+static const int LOCAL_SIZE = 512;
+
+// 从 /proc/self/statm 读取虚拟内存和常驻内存的大小(字节)
+static void get_memory(uint64_t &vm, uint64_t &rss)
+{
+    std::ifstream ifs("/proc/self/statm");
+    ifs >> vm >> rss;
+    long page = sysconf(_SC_PAGESIZE);
+    vm *= page;
+    rss *= page;
+}
+
+static std::atomic<int> s_errors{0};
+
+// 在栈上放一些数据然后挂起，恢复后检查数据没有被其他协程破坏
+static void parked_func()
+{
+    char local[LOCAL_SIZE];
+    uint64_t id = dbspider::Fiber::GetFiberId();
+    memset(local, (int)(id & 0xff), sizeof(local));
+    dbspider::Fiber::YieldToHold();
+    for (char c : local)
+    {
+        if (c != (char)(id & 0xff))
+        {
+            ++s_errors;
+            break;
+        }
+    }
+}
+
+// 挂起大量协程，统计每个挂起协程占用的内存
+static void bench(bool shared_stack)
+{
+    std::vector<dbspider::Fiber::ptr> fibers;
+    fibers.reserve(PARKED_FIBERS);
+    uint64_t vm_begin, rss_begin, vm_end, rss_end;
+    get_memory(vm_begin, rss_begin);
+    for (int i = 0; i < PARKED_FIBERS; ++i)
+    {
+        fibers.emplace_back(new dbspider::Fiber(&parked_func, 0, shared_stack));
+        fibers.back()->resume();
+    }
+    get_memory(vm_end, rss_end);
+
+    size_t saved = 0;
+    for (auto &f : fibers)
+    {
+        saved += f->getSavedStackSize();
+    }
+    DBSPIDER_LOG_INFO(g_logger) << (shared_stack ? "shared stack" : "own stack") << ": "
+                                << PARKED_FIBERS << " parked fibers, per fiber rss="
+                                << (rss_end - rss_begin) / PARKED_FIBERS << "B vm="
+                                << (vm_end - vm_begin) / PARKED_FIBERS << "B saved stack="
+                                << saved / PARKED_FIBERS << "B";
+
+    for (auto &f : fibers)
+    {
+        f->resume();
+        DBSPIDER_ASSERT(f->isTerminate());
+    }
+}
+
+// 调度器中的共享栈协程：经过定时器唤醒后仍然回到同一个线程，栈上的数据完好
+// 到期的定时器批量提交，绑定了线程的协程进入该线程的专属队列
+static void test_scheduler(bool work_stealing)
+{
+    static const int FIBERS = 1000;
+    std::atomic<int> done{0};
+    dbspider::Config::Lookup<bool>("scheduler.work_stealing")->setValue(work_stealing);
+    {
+        dbspider::IOManager iom(2, "shared");
+        for (int i = 0; i < FIBERS; ++i)
+        {
+            iom.submit(dbspider::Fiber::ptr(new dbspider::Fiber([&done]
+                                                                {
+                                                                    char local[LOCAL_SIZE];
+                                                                    int thread = dbspider::GetThreadId();
+                                                                    memset(local, thread & 0xff, sizeof(local));
+                                                                    for (int j = 0; j < 3; ++j)
+                                                                    {
+                                                                        usleep(1000);
+                                                                        if (dbspider::GetThreadId() != thread ||
+                                                                            local[j] != (char)(thread & 0xff))
+                                                                        {
+                                                                            ++s_errors;
+                                                                        }
+                                                                    }
+                                                                    ++done; },
+                                                                0, true)));
+        }
+    }
+    DBSPIDER_ASSERT(done == FIBERS);
+    dbspider::Config::Lookup<bool>("scheduler.work_stealing")->setValue(false);
+}
+
+// 多 reactor 模式下共享栈协程等待其他线程拥有的fd，事件在所属线程触发后协程仍然回到自己绑定的线程
+static void test_multi_reactor()
+{
+    dbspider::Config::Lookup<bool>("iomanager.multi_reactor")->setValue(true);
+    std::atomic<int> done{0};
+    {
+        dbspider::IOManager iom(2, "reactor");
+        while (!iom.getThreadId(0) || !iom.getThreadId(1))
+        {
+            usleep(1000);
+        }
+        int fds[2];
+        DBSPIDER_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        dbspider::FdMgr::GetInstance()->get(fds[0], true);
+        dbspider::FdMgr::GetInstance()->get(fds[1], true);
+        DBSPIDER_ASSERT(iom.setFdOwner(fds[0], 1));
+        int fd = fds[0];
+        iom.submit(dbspider::Fiber::ptr(new dbspider::Fiber([fd, &done]
+                                                            {
+                                                                int thread = dbspider::GetThreadId();
+                                                                char c;
+                                                                DBSPIDER_ASSERT(recv(fd, &c, 1, 0) == 1);
+                                                                if (dbspider::GetThreadId() != thread || c != 'x')
+                                                                {
+                                                                    ++s_errors;
+                                                                }
+                                                                ++done; },
+                                                            0, true)),
+                   iom.getThreadId(0));
+        usleep(10 * 1000);
+        DBSPIDER_ASSERT(send(fds[1], "x", 1, 0) == 1);
+        while (done < 1)
+        {
+            usleep(1000);
+        }
+        iom.stop();
+        close(fds[0]);
+        close(fds[1]);
+    }
+    dbspider::Config::Lookup<bool>("iomanager.multi_reactor")->setValue(false);
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+    dbspider::Fiber::EnableFiber();
+
+    bench(false);
+    bench(true);
+    test_scheduler(false);
+    test_scheduler(true);
+    test_multi_reactor();
+    DBSPIDER_LOG_INFO(g_logger) << "errors=" << s_errors;
+    DBSPIDER_ASSERT(s_errors == 0);
+    return 0;
+}
@@ -0,0 +1,193 @@
+#include "dbspider.h"
+
+#include <array>
+#include <cstdlib>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+// 统计当前线程和全部线程的内存分配次数
+static thread_local size_t t_allocs = 0;
+static std::atomic<size_t> s_allocs{0};
+
+void *operator new(size_t size)
+{
+    ++t_allocs;
+    s_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// 典型的捕获：几个指针和整数，48 字节
+struct Payload
+{
+    std::atomic<int> *counter;
+    void *ctx[3];
+    int64_t args[2];
+};
+
+static void test_small_task()
+{
+    std::atomic<int> counter{0};
+    Payload payload{&counter, {}, {1, 2}};
+
+    size_t before = t_allocs;
+    dbspider::SmallTask task([payload]
+                             { payload.counter->fetch_add((int)payload.args[1]); });
+    dbspider::SmallTask moved(std::move(task));
+    moved();
+    DBSPIDER_ASSERT(t_allocs == before);
+    DBSPIDER_ASSERT(!task && moved && !moved.isHeap());
+    DBSPIDER_ASSERT(counter == 2);
+
+    // 超过内联缓冲区的捕获放到堆上，移动时只移动指针
+    std::array<char, 256> big{};
+    big[0] = 1;
+    dbspider::SmallTask heap([big, &counter]
+                             { counter += big[0]; });
+    DBSPIDER_ASSERT(heap.isHeap());
+    before = t_allocs;
+    dbspider::SmallTask heap2 = std::move(heap);
+    heap2();
+    DBSPIDER_ASSERT(t_allocs == before && counter == 3);
+
+    // 只能移动的捕获
+    auto ptr = std::make_unique<int>(4);
+    dbspider::SmallTask unique([p = std::move(ptr), &counter]
+                               { counter += *p; });
+    unique();
+    DBSPIDER_ASSERT(counter == 7);
+
+    // 空的 std::function 得到空任务
+    std::function<void()> empty;
+    DBSPIDER_ASSERT(!dbspider::SmallTask(empty));
+    DBSPIDER_ASSERT(!dbspider::SmallTask(nullptr));
+}
+
+static void test_ring_queue()
+{
+    dbspider::RingQueue<int> q;
+    for (int i = 0; i < 100; ++i)
+    {
+        q.push_back(int(i));
+    }
+    DBSPIDER_ASSERT(q.size() == 100 && q.capacity() == 128);
+    for (int i = 0; i < 50; ++i)
+    {
+        DBSPIDER_ASSERT(q.front() == i);
+        q.pop_front();
+    }
+    // 绕回数组开头，不再扩容
+    for (int i = 100; i < 170; ++i)
+    {
+        q.push_back(int(i));
+    }
+    DBSPIDER_ASSERT(q.capacity() == 128);
+    q.erase(1);             // 51
+    q.erase(q.size() - 2);  // 168
+    q.pop_back();           // 169
+    std::vector<int> expect;
+    expect.push_back(50);
+    for (int i = 52; i < 168; ++i)
+    {
+        expect.push_back(i);
+    }
+    DBSPIDER_ASSERT(q.size() == expect.size());
+    for (size_t i = 0; i < expect.size(); ++i)
+    {
+        DBSPIDER_ASSERT(q[i] == expect[i]);
+    }
+}
+
+// 非调度线程向全局队列提交 n 个任务，返回提交线程上的分配次数
+template <typename MakeTask>
+static size_t submit_batch(dbspider::IOManager &iom, std::atomic<int> &counter, int n, MakeTask make, uint64_t &us)
+{
+    counter = 0;
+    Payload payload{&counter, {}, {1, 1}};
+    dbspider::TimeMeasure tm;
+    size_t before = t_allocs;
+    for (int i = 0; i < n; ++i)
+    {
+        iom.submit(make(payload));
+    }
+    size_t allocs = t_allocs - before;
+    us = tm.elapsed_micro();
+    while (counter != n)
+    {
+        usleep(1000);
+    }
+    return allocs;
+}
+
+// 比较提交 lambda 与先包装成 std::function 再提交的分配次数
+static void bench_submit()
+{
+    const int n = 10000;
+    std::atomic<int> counter{0};
+    dbspider::IOManager iom(1);
+    auto lambda = [](const Payload &payload)
+    {
+        return [payload]
+        { payload.counter->fetch_add((int)payload.args[0]); };
+    };
+    auto function = [](const Payload &payload)
+    {
+        return std::function<void()>([payload]
+                                     { payload.counter->fetch_add((int)payload.args[0]); });
+    };
+    uint64_t us = 0;
+    // 第一轮先占住调度线程，让全局队列扩容到能放下全部 n 个任务
+    std::atomic<bool> release{false};
+    iom.submit([&release]
+               {
+                   while (!release)
+                   {
+                   } });
+    usleep(10 * 1000);
+    std::thread releaser([&release]
+                         {
+                             usleep(100 * 1000);
+                             release = true; });
+    submit_batch(iom, counter, n, lambda, us);
+    releaser.join();
+
+    size_t total = s_allocs;
+    size_t allocs = submit_batch(iom, counter, n, lambda, us);
+    total = s_allocs - total;
+    DBSPIDER_LOG_INFO(g_logger) << "submit lambda: " << n << " tasks, " << allocs << " allocs on submitter, "
+                                << total << " allocs in total, " << us << "us";
+    DBSPIDER_ASSERT(allocs == 0);
+
+    total = s_allocs;
+    allocs = submit_batch(iom, counter, n, function, us);
+    total = s_allocs - total;
+    DBSPIDER_LOG_INFO(g_logger) << "submit std::function: " << n << " tasks, " << allocs << " allocs on submitter, "
+                                << total << " allocs in total, " << us << "us";
+    DBSPIDER_ASSERT(allocs >= (size_t)n);
+    iom.stop();
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    test_small_task();
+    test_ring_queue();
+    bench_submit();
+
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
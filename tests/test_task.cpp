@@ -0,0 +1,268 @@
+#include "dbspider.h"
+#include <sys/socket.h>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int TASKS = 1000000;
+
+static dbspider::Task<int> add_one(int n)
+{
+    co_return n + 1;
+}
+
+static dbspider::Task<int> chain(int n)
+{
+    int sum = 0;
+    for (int i = 0; i < 10; ++i)
+    {
+        sum += co_await add_one(n);
+    }
+    co_return sum;
+}
+
+static dbspider::Task<int64_t> run_tasks()
+{
+    int64_t sum = 0;
+    for (int i = 0; i < TASKS; ++i)
+    {
+        sum += co_await add_one(i);
+    }
+    co_return sum;
+}
+
+// 创建并跑完大量短生命周期的无栈协程和有栈协程，比较创建的开销
+static void bench_create()
+{
+    int64_t sum = 0;
+    uint64_t task_cost = 0;
+    {
+        dbspider::IOManager iom(1, "bench");
+        iom.submit([&sum, &task_cost]
+                   {
+                       uint64_t begin = dbspider::GetCurrentUS();
+                       sum = dbspider::SyncWait(run_tasks());
+                       task_cost = dbspider::GetCurrentUS() - begin; });
+    }
+    DBSPIDER_ASSERT(sum == (int64_t)TASKS * (TASKS + 1) / 2);
+
+    int count = 0;
+    uint64_t begin = dbspider::GetCurrentUS();
+    for (int i = 0; i < TASKS; ++i)
+    {
+        dbspider::Fiber::ptr fiber(new dbspider::Fiber([&count]
+                                                       { ++count; }));
+        fiber->resume();
+    }
+    uint64_t fiber_cost = dbspider::GetCurrentUS() - begin;
+    DBSPIDER_ASSERT(count == TASKS);
+
+    DBSPIDER_LOG_INFO(g_logger) << "create+run+destroy: Task " << task_cost * 1000.0 / TASKS
+                                << " ns, Fiber " << fiber_cost * 1000.0 / TASKS << " ns";
+}
+
+static std::atomic<int> s_done{0};
+
+// 定时器挂起和唤醒，嵌套的 co_await 和返回值
+static dbspider::Task<void> sleeper(int id)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        co_await dbspider::CoSleep(5);
+    }
+    int rt = co_await chain(id);
+    DBSPIDER_ASSERT(rt == (id + 1) * 10);
+    ++s_done;
+}
+
+static void test_timer()
+{
+    s_done = 0;
+    {
+        dbspider::IOManager iom(2, "timer");
+        for (int i = 0; i < 1000; ++i)
+        {
+            dbspider::CoSpawn(sleeper(i), &iom);
+        }
+    }
+    DBSPIDER_ASSERT(s_done == 1000);
+}
+
+// 无栈协程和有栈协程竞争同一把协程锁
+static void test_mutex()
+{
+    static const int WORKERS = 50;
+    static const int LOOPS = 200;
+    dbspider::CoMutex mutex;
+    int64_t counter = 0;
+    {
+        dbspider::IOManager iom(2, "mutex");
+        for (int i = 0; i < WORKERS; ++i)
+        {
+            dbspider::CoSpawn([](dbspider::CoMutex &mutex, int64_t &counter) -> dbspider::Task<void>
+                              {
+                                  for (int j = 0; j < LOOPS; ++j)
+                                  {
+                                      co_await mutex.asyncLock();
+                                      int64_t v = counter;
+                                      co_await dbspider::CoYield();
+                                      counter = v + 1;
+                                      mutex.unlock();
+                                  } }(mutex, counter),
+                              &iom);
+            iom.submit([&mutex, &counter]
+                       {
+                           for (int j = 0; j < LOOPS; ++j)
+                           {
+                               dbspider::CoMutex::Lock lock(mutex);
+                               int64_t v = counter;
+                               dbspider::Fiber::YieldToReady();
+                               counter = v + 1;
+                           } });
+        }
+    }
+    DBSPIDER_LOG_INFO(g_logger) << "mutex counter=" << counter;
+    DBSPIDER_ASSERT(counter == WORKERS * LOOPS * 2);
+}
+
+// 无栈协程生产，有栈协程和无栈协程一起消费
+static void test_channel()
+{
+    static const int PRODUCERS = 10;
+    static const int ITEMS = 1000;
+    dbspider::Channel<int> chan(16);
+    std::atomic<int64_t> sum{0};
+    {
+        dbspider::IOManager iom(2, "channel");
+        for (int i = 0; i < PRODUCERS; ++i)
+        {
+            dbspider::CoSpawn([](dbspider::Channel<int> chan) -> dbspider::Task<void>
+                              {
+                                  for (int j = 1; j <= ITEMS; ++j)
+                                  {
+                                      DBSPIDER_ASSERT(co_await chan.asyncPush(j));
+                                  } }(chan),
+                              &iom);
+        }
+        for (int i = 0; i < PRODUCERS / 2; ++i)
+        {
+            dbspider::CoSpawn([](dbspider::Channel<int> chan, std::atomic<int64_t> &sum) -> dbspider::Task<void>
+                              {
+                                  for (int j = 0; j < ITEMS; ++j)
+                                  {
+                                      int v = 0;
+                                      DBSPIDER_ASSERT(co_await chan.asyncPop(v));
+                                      sum += v;
+                                  } }(chan, sum),
+                              &iom);
+            iom.submit([chan, &sum]() mutable
+                       {
+                           for (int j = 0; j < ITEMS; ++j)
+                           {
+                               int v = 0;
+                               DBSPIDER_ASSERT(chan.pop(v));
+                               sum += v;
+                           } });
+        }
+    }
+    DBSPIDER_LOG_INFO(g_logger) << "channel sum=" << sum;
+    DBSPIDER_ASSERT(sum == (int64_t)PRODUCERS * ITEMS * (ITEMS + 1) / 2);
+}
+
+// 无栈协程做回显，有栈协程通过 hook 的 send/recv 收发
+static void test_socket()
+{
+    static const int ROUNDS = 1000;
+    int fds[2];
+    DBSPIDER_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    dbspider::FdMgr::GetInstance()->get(fds[0], true);
+    dbspider::FdMgr::GetInstance()->get(fds[1], true);
+    int echoed = 0;
+    {
+        dbspider::IOManager iom(2, "socket");
+        dbspider::CoSpawn([](int fd, int &echoed) -> dbspider::Task<void>
+                          {
+                              char buf[64];
+                              while (true)
+                              {
+                                  ssize_t n = co_await dbspider::AsyncRecv(fd, buf, sizeof(buf));
+                                  if (n <= 0)
+                                  {
+                                      break;
+                                  }
+                                  co_await dbspider::AsyncSend(fd, buf, n);
+                                  ++echoed;
+                              } }(fds[0], echoed),
+                          &iom);
+        iom.submit([fds]
+                   {
+                       char buf[64];
+                       for (int i = 0; i < ROUNDS; ++i)
+                       {
+                           int len = snprintf(buf, sizeof(buf), "ping %d", i);
+                           DBSPIDER_ASSERT(send(fds[1], buf, len, 0) == len);
+                           DBSPIDER_ASSERT(recv(fds[1], buf, sizeof(buf), 0) == len);
+                       }
+                       shutdown(fds[1], SHUT_WR); });
+    }
+    DBSPIDER_ASSERT(echoed == ROUNDS);
+
+    // 读超时
+    struct timeval tv{0, 20 * 1000};
+    dbspider::IOManager iom(1, "timeout");
+    iom.submit([fds, &tv]
+               {
+                   setsockopt(fds[1], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                   char buf[16];
+                   uint64_t begin = dbspider::GetCurrentMS();
+                   ssize_t n = dbspider::SyncWait(dbspider::AsyncRecv(fds[1], buf, sizeof(buf)));
+                   DBSPIDER_ASSERT(n == -1 && errno == ETIMEDOUT);
+                   DBSPIDER_ASSERT(dbspider::GetCurrentMS() - begin >= 15); });
+    iom.stop();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// 在有栈协程中同步等待无栈协程，异常会传递给等待者
+static void test_sync_wait()
+{
+    dbspider::IOManager iom(2, "sync_wait");
+    iom.submit([]
+               {
+                   int rt = dbspider::SyncWait([]() -> dbspider::Task<int>
+                                               {
+                                                   co_await dbspider::CoSleep(5);
+                                                   co_return 42; }());
+                   DBSPIDER_ASSERT(rt == 42);
+                   bool caught = false;
+                   try
+                   {
+                       dbspider::SyncWait([]() -> dbspider::Task<void>
+                                          {
+                                              co_await dbspider::CoYield();
+                                              throw std::runtime_error("task error"); }());
+                   }
+                   catch (std::runtime_error &e)
+                   {
+                       caught = true;
+                   }
+                   DBSPIDER_ASSERT(caught);
+                   ++s_done; });
+    iom.stop();
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+    dbspider::Fiber::EnableFiber();
+
+    bench_create();
+    test_timer();
+    test_mutex();
+    test_channel();
+    test_socket();
+    s_done = 0;
+    test_sync_wait();
+    DBSPIDER_ASSERT(s_done == 1);
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
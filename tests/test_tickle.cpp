@@ -0,0 +1,92 @@
+#include "dbspider.h"
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int THREADS = 4;
+static const int TASKS = 100000;
+static const int ROUNDS = 1000;
+
+static void log_stats(const char *name, const dbspider::Scheduler::Stats &stats)
+{
+    DBSPIDER_LOG_INFO(g_logger) << name << ": tickles=" << stats.tickles
+                                << " writes=" << stats.tickleWrites
+                                << " saved=" << stats.tickleSaved;
+}
+
+// 外部线程连续提交大量小任务，已有唤醒未处理时不再重复写 eventfd
+static void test_burst()
+{
+    std::atomic<int> done{0};
+    dbspider::IOManager iom(THREADS, "burst");
+    uint64_t begin = dbspider::GetCurrentUS();
+    for (int i = 0; i < TASKS; ++i)
+    {
+        iom.submit([&done]
+                   { ++done; });
+    }
+    while (done < TASKS)
+    {
+        usleep(100);
+    }
+    uint64_t cost = dbspider::GetCurrentUS() - begin;
+    dbspider::Scheduler::Stats stats = iom.getStats();
+    log_stats("burst", stats);
+    DBSPIDER_LOG_INFO(g_logger) << TASKS << " tasks cost " << cost << " us";
+    DBSPIDER_ASSERT(stats.tickleWrites <= stats.tickles);
+    DBSPIDER_ASSERT(stats.tickleSaved == stats.tickles - stats.tickleWrites);
+    iom.stop();
+    DBSPIDER_ASSERT(done == TASKS);
+}
+
+// 每轮只提交一个任务并等它完成，每次都需要唤醒，不能因为合并而丢失唤醒
+static void test_ping_pong()
+{
+    std::atomic<int> done{0};
+    dbspider::IOManager iom(THREADS, "ping");
+    uint64_t begin = dbspider::GetCurrentUS();
+    for (int i = 0; i < ROUNDS; ++i)
+    {
+        iom.submit([&done]
+                   { ++done; });
+        while (done <= i)
+            ;
+    }
+    uint64_t cost = dbspider::GetCurrentUS() - begin;
+    log_stats("ping-pong", iom.getStats());
+    DBSPIDER_LOG_INFO(g_logger) << "avg wakeup latency " << (double)cost / ROUNDS << " us";
+    // 丢失唤醒时只能等 epoll_wait 超时，每轮至少 3s
+    DBSPIDER_ASSERT(cost < ROUNDS * 10 * 1000ull);
+    iom.stop();
+}
+
+// 调度线程中的任务派生出一批任务，空闲线程逐个被唤醒把任务分摊掉
+static void test_fan_out()
+{
+    static const int CHILDREN = 64;
+    std::atomic<int> done{0};
+    dbspider::IOManager iom(THREADS, "fan_out");
+    for (int i = 0; i < ROUNDS / 10; ++i)
+    {
+        iom.submit([&done]
+                   {
+                       for (int j = 0; j < CHILDREN; ++j)
+                       {
+                           dbspider::IOManager::GetThis()->submit([&done]
+                                                                  { ++done; });
+                       } });
+    }
+    iom.stop();
+    log_stats("fan-out", iom.getStats());
+    DBSPIDER_ASSERT(done == ROUNDS / 10 * CHILDREN);
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    test_burst();
+    test_ping_pong();
+    test_fan_out();
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include "dbspider.h"
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static const int ROUNDS = 200;
+
+// 统计定时器实际触发时间比预期晚了多少
+struct Lateness
+{
+    uint64_t total = 0;
+    uint64_t max = 0;
+    int count = 0;
+
+    void add(uint64_t expected, uint64_t elapsed)
+    {
+        DBSPIDER_ASSERT2(elapsed >= expected, "expected=" << expected << " elapsed=" << elapsed);
+        uint64_t late = elapsed - expected;
+        total += late;
+        max = std::max(max, late);
+        ++count;
+    }
+
+    double avg() const { return count ? (double)total / count : 0; }
+};
+
+// 在调度线程中检查平均延迟，单核机器上偶尔会被抢占，单次的最大延迟只打印不检查
+static void check(const char *name, const Lateness &lateness)
+{
+    DBSPIDER_LOG_INFO(g_logger) << name << ": rounds=" << lateness.count << " avg late="
+                                << lateness.avg() << "us max late=" << lateness.max << "us";
+    DBSPIDER_ASSERT2(lateness.avg() < 500, name << " avg late " << lateness.avg() << "us");
+}
+
+// hook 的 usleep/nanosleep 不再被截断到毫秒
+static void test_sleep()
+{
+    Lateness usleep_late, nanosleep_late;
+    dbspider::IOManager iom(1, "sleep");
+    iom.submit([&]
+               {
+                   for (int i = 0; i < ROUNDS; ++i)
+                   {
+                       uint64_t us = 100 + i % 10 * 100;
+                       uint64_t begin = dbspider::GetCurrentUS();
+                       usleep(us);
+                       usleep_late.add(us, dbspider::GetCurrentUS() - begin);
+                   }
+                   for (int i = 0; i < ROUNDS; ++i)
+                   {
+                       struct timespec req{0, 300 * 1000 + i};
+                       uint64_t begin = dbspider::GetCurrentUS();
+                       nanosleep(&req, nullptr);
+                       nanosleep_late.add(301, dbspider::GetCurrentUS() - begin);
+                   } });
+    iom.stop();
+    check("usleep", usleep_late);
+    check("nanosleep", nanosleep_late);
+}
+
+// 微秒定时器，多个定时器同时存在时各自准时触发
+static void test_timer_us()
+{
+    Lateness lateness;
+    dbspider::Mutex mutex;
+    std::atomic<int> fired{0};
+    dbspider::IOManager iom(2, "timer_us");
+    for (int i = 0; i < ROUNDS; ++i)
+    {
+        uint64_t us = 50 + i * 37 % 2000;
+        uint64_t begin = dbspider::GetCurrentUS();
+        iom.addTimerUS(us, [&, us, begin]
+                       {
+                           uint64_t elapsed = dbspider::GetCurrentUS() - begin;
+                           dbspider::Mutex::Lock lock(mutex);
+                           lateness.add(us, elapsed);
+                           ++fired; });
+    }
+    // 纳秒接口向上取整到微秒，毫秒接口保持原来的行为
+    uint64_t begin = dbspider::GetCurrentUS();
+    iom.addTimerNS(1500, [&fired, begin]
+                   {
+                       DBSPIDER_ASSERT(dbspider::GetCurrentUS() - begin >= 2);
+                       ++fired; });
+    iom.addTimer(5, [&fired, begin]
+                 {
+                     DBSPIDER_ASSERT(dbspider::GetCurrentUS() - begin >= 5000);
+                     ++fired; });
+    iom.stop();
+    DBSPIDER_ASSERT(fired == ROUNDS + 2);
+    check("addTimerUS", lateness);
+}
+
+// 循环定时器按微秒周期触发
+static void test_recurring()
+{
+    static const int TIMES = 100;
+    std::atomic<int> count{0};
+    uint64_t begin = dbspider::GetCurrentUS();
+    uint64_t cost = 0;
+    dbspider::IOManager iom(1, "recurring");
+    dbspider::Timer::ptr timer;
+    timer = iom.addTimerUS(
+        200, [&]
+        {
+            if (++count == TIMES)
+            {
+                cost = dbspider::GetCurrentUS() - begin;
+                timer->cancel();
+            } },
+        true);
+    iom.stop();
+    DBSPIDER_LOG_INFO(g_logger) << "recurring 200us x " << TIMES << ": " << cost << "us";
+    DBSPIDER_ASSERT(count == TIMES);
+    DBSPIDER_ASSERT(cost >= 200 * TIMES);
+    DBSPIDER_ASSERT(cost < 200 * TIMES * 3);
+}
+
+// 无栈协程的微秒睡眠
+static void test_co_sleep()
+{
+    Lateness lateness;
+    dbspider::IOManager iom(1, "co_sleep");
+    dbspider::CoSpawn([](Lateness &lateness) -> dbspider::Task<void>
+                      {
+                          for (int i = 0; i < ROUNDS; ++i)
+                          {
+                              uint64_t begin = dbspider::GetCurrentUS();
+                              co_await dbspider::CoSleepUS(250);
+                              lateness.add(250, dbspider::GetCurrentUS() - begin);
+                          } }(lateness),
+                      &iom);
+    iom.stop();
+    check("CoSleepUS", lateness);
+}
+
+// 定时器触发之后，由回调或外部线程加入更晚的定时器，空闲线程要被唤醒重新计算醒来时间，不能睡到 epoll 的兜底超时
+static void test_chain()
+{
+    Lateness lateness;
+    dbspider::IOManager iom(2, "chain");
+    std::atomic<int> fired{0};
+    std::function<void(uint64_t)> add = [&](uint64_t begin)
+    {
+        iom.addTimerUS(1000, [&, begin]
+                       {
+                           lateness.add(1000, dbspider::GetCurrentUS() - begin);
+                           if (++fired < ROUNDS / 4)
+                           {
+                               add(dbspider::GetCurrentUS());
+                           } });
+    };
+    add(dbspider::GetCurrentUS());
+    while (fired < ROUNDS / 4)
+    {
+        usleep(1000);
+    }
+    for (int i = 0; i < ROUNDS / 4; ++i)
+    {
+        std::atomic<bool> done{false};
+        uint64_t us = 2000 + i * 100;
+        uint64_t begin = dbspider::GetCurrentUS();
+        iom.addTimerUS(us, [&]
+                       {
+                           lateness.add(us, dbspider::GetCurrentUS() - begin);
+                           done = true; });
+        while (!done)
+        {
+            usleep(100);
+        }
+    }
+    iom.stop();
+    check("chain", lateness);
+    DBSPIDER_ASSERT2(lateness.max < 1000 * 1000, "max late " << lateness.max << "us");
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+    dbspider::Fiber::EnableFiber();
+
+    test_sleep();
+    test_timer_us();
+    test_recurring();
+    test_co_sleep();
+    test_chain();
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
@@ -0,0 +1,226 @@
+#include "dbspider.h"
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+// 在 IOManager 中运行 cb，等它执行完再返回
+template <typename Func>
+static void run_in_iom(int threads, Func cb)
+{
+    dbspider::IOManager iom(threads);
+    std::atomic<bool> finished{false};
+    go [&]
+    {
+        cb();
+        finished = true;
+    };
+    while (!finished)
+    {
+        usleep(1000);
+    }
+    iom.stop();
+}
+
+// 扇出 N 个任务，等待全部完成后一次取回结果
+static void test_fan_out()
+{
+    run_in_iom(2, []
+               {
+                   const int n = 50;
+                   std::vector<int> results(n);
+                   dbspider::FiberGroup group;
+                   for (int i = 0; i < n; ++i)
+                   {
+                       group.spawn([&results, i]
+                                   {
+                                       usleep((i % 5) * 1000);
+                                       results[i] = i * i; });
+                   }
+                   group.wait();
+                   DBSPIDER_ASSERT(group.getPending() == 0);
+                   DBSPIDER_ASSERT(group.getFinished() == n);
+                   for (int i = 0; i < n; ++i)
+                   {
+                       DBSPIDER_ASSERT(results[i] == i * i);
+                   } });
+}
+
+// 带超时的等待，以及等待前 n 个任务完成
+static void test_timeout_and_first_n()
+{
+    run_in_iom(2, []
+               {
+                   dbspider::FiberGroup group;
+                   for (int i = 0; i < 2; ++i)
+                   {
+                       group.spawn([]
+                                   { usleep(200 * 1000); });
+                   }
+                   uint64_t start = dbspider::GetCurrentMS();
+                   DBSPIDER_ASSERT(!group.waitFor(20));
+                   uint64_t elapsed = dbspider::GetCurrentMS() - start;
+                   DBSPIDER_ASSERT(elapsed >= 15 && elapsed < 150);
+                   DBSPIDER_ASSERT(group.waitFor(1000));
+
+                   dbspider::FiberGroup group2;
+                   for (int i = 0; i < 10; ++i)
+                   {
+                       group2.spawn([i]
+                                    { usleep((i < 3 ? 5 : 300) * 1000); });
+                   }
+                   size_t finished = group2.waitAny(3);
+                   DBSPIDER_ASSERT(finished >= 3 && finished < 10);
+                   // 剩余的任务不再需要，取消后由析构等待正在执行的任务
+                   group2.cancel(); });
+}
+
+// 取消后还没开始执行的任务不再执行
+static void test_cancel()
+{
+    run_in_iom(1, []
+               {
+                   std::atomic<int> ran{0};
+                   {
+                       dbspider::FiberGroup group;
+                       for (int i = 0; i < 10; ++i)
+                       {
+                           group.spawn([&ran]
+                                       { ++ran; });
+                       }
+                       // 单线程下派生的任务还没有机会执行
+                       group.cancel();
+                       group.spawn([&ran]
+                                   { ++ran; });
+                       group.wait();
+                       DBSPIDER_ASSERT(group.getFinished() == 10);
+                   }
+                   DBSPIDER_ASSERT(ran == 0);
+
+                   // 组析构时等待已经开始的任务结束，任务可以引用父协程栈上的变量
+                   int value = 0;
+                   {
+                       dbspider::FiberGroup group;
+                       group.spawn([&value]
+                                   {
+                                       usleep(20 * 1000);
+                                       value = 1; });
+                       dbspider::Fiber::YieldToReady();
+                   }
+                   DBSPIDER_ASSERT(value == 1); });
+}
+
+// 任务抛出异常时仍然计入完成，等待者不会一直挂起
+static void test_exception()
+{
+    run_in_iom(2, []
+               {
+                   dbspider::FiberGroup group;
+                   for (int i = 0; i < 4; ++i)
+                   {
+                       group.spawn([i]
+                                   {
+                                       if (i % 2)
+                                       {
+                                           throw std::runtime_error("task failed");
+                                       } });
+                   }
+                   DBSPIDER_ASSERT(group.waitFor(1000));
+                   DBSPIDER_ASSERT(group.getFinished() == 4); });
+}
+
+// 协程局部变量传给组内的任务
+static void test_inherit()
+{
+    static dbspider::FiberLocal<int> s_request;
+    run_in_iom(2, []
+               {
+                   s_request.set(42);
+                   std::atomic<int> ok{0};
+                   dbspider::FiberGroup group;
+                   for (int i = 0; i < 4; ++i)
+                   {
+                       group.spawn([&ok]
+                                   { ok += s_request.get() && *s_request.get() == 42; });
+                   }
+                   group.wait();
+                   DBSPIDER_ASSERT(ok == 4); });
+}
+
+// 等待者在 wait 中挂起时 countDown 能拿到锁
+static void test_count_down()
+{
+    run_in_iom(2, []
+               {
+                   dbspider::CoCountDownLatch latch(3);
+                   for (int i = 0; i < 3; ++i)
+                   {
+                       go [&latch]
+                       {
+                           usleep(5 * 1000);
+                           latch.countDown();
+                       };
+                   }
+                   latch.wait();
+                   DBSPIDER_ASSERT(latch.getCount() == 0); });
+}
+
+// 比较逐个等待 Channel 与 FiberGroup 一次等待的开销，子任务让出一次模拟等待 IO
+static void bench_fan_out()
+{
+    const int rounds = 200;
+    const int n = 32;
+    run_in_iom(1, []
+               {
+                   dbspider::TimeMeasure tm;
+                   for (int r = 0; r < rounds; ++r)
+                   {
+                       std::vector<dbspider::Channel<int>> chans;
+                       for (int i = 0; i < n; ++i)
+                       {
+                           dbspider::Channel<int> chan(1);
+                           go [chan, i]() mutable
+                           {
+                               dbspider::Fiber::YieldToReady();
+                               chan << i;
+                           };
+                           chans.push_back(chan);
+                       }
+                       int v;
+                       for (auto &chan : chans)
+                       {
+                           chan >> v;
+                       }
+                   }
+                   DBSPIDER_LOG_INFO(g_logger) << "channel per call: " << tm.elapsed_micro() << "us";
+
+                   tm.reset();
+                   for (int r = 0; r < rounds; ++r)
+                   {
+                       std::vector<int> results(n);
+                       dbspider::FiberGroup group;
+                       for (int i = 0; i < n; ++i)
+                       {
+                           group.spawn([&results, i]
+                                       {
+                                           dbspider::Fiber::YieldToReady();
+                                           results[i] = i; });
+                       }
+                       group.wait();
+                   }
+                   DBSPIDER_LOG_INFO(g_logger) << "fiber group: " << tm.elapsed_micro() << "us"; });
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    test_fan_out();
+    test_timeout_and_first_n();
+    test_cancel();
+    test_exception();
+    test_inherit();
+    test_count_down();
+    bench_fan_out();
+
+    DBSPIDER_LOG_INFO(g_logger) << "all passed";
+    return 0;
+}
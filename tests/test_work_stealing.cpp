@@ -0,0 +1,106 @@
+#include "dbspider.h"
+#include <unistd.h>
+
+static dbspider::Logger::ptr g_logger = DBSPIDER_LOG_ROOT();
+
+static std::atomic<uint64_t> s_done{0};
+
+static const int ROOT_TASKS = 200;
+static const int CHILD_TASKS = 500;
+
+// 模拟一点计算量
+static void child_task()
+{
+    volatile uint64_t x = 0;
+    for (int i = 0; i < 200; ++i)
+    {
+        x = x + i;
+    }
+    ++s_done;
+}
+
+// 根任务在调度线程上继续提交子任务，工作窃取模式下子任务进入本地队列
+static void root_task()
+{
+    dbspider::Scheduler *sc = dbspider::Scheduler::GetThis();
+    for (int i = 0; i < CHILD_TASKS; ++i)
+    {
+        sc->submit(&child_task);
+    }
+}
+
+// 返回每秒完成的任务数
+static double bench(size_t threads, bool work_stealing)
+{
+    dbspider::Config::Lookup<bool>("scheduler.work_stealing")->setValue(work_stealing);
+    s_done = 0;
+    const uint64_t total = (uint64_t)ROOT_TASKS * CHILD_TASKS;
+
+    dbspider::Scheduler sc(threads, "bench");
+    sc.start();
+    uint64_t begin = dbspider::GetCurrentUS();
+    for (int i = 0; i < ROOT_TASKS; ++i)
+    {
+        sc.submit(&root_task);
+    }
+    while (s_done < total)
+    {
+        usleep(100);
+    }
+    uint64_t cost = dbspider::GetCurrentUS() - begin;
+    sc.stop();
+    return total * 1000000.0 / (cost ? cost : 1);
+}
+
+// 本地队列里的任务不断派生新任务时，外部线程提交到全局队列的任务仍然能及时执行
+static void test_global_fairness()
+{
+    dbspider::Config::Lookup<bool>("scheduler.work_stealing")->setValue(true);
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> spins{0};
+    dbspider::Scheduler sc(1, "fairness");
+    sc.start();
+    std::function<void()> refill = [&]
+    {
+        ++spins;
+        if (!stop)
+        {
+            dbspider::Scheduler::GetThis()->submit(refill);
+        }
+    };
+    sc.submit(refill);
+    while (spins < 1000)
+    {
+        usleep(100);
+    }
+    std::atomic<bool> ran{false};
+    uint64_t begin = dbspider::GetCurrentUS();
+    sc.submit([&ran]
+              { ran = true; });
+    while (!ran && dbspider::GetCurrentUS() - begin < 2000 * 1000)
+    {
+        usleep(100);
+    }
+    uint64_t cost = dbspider::GetCurrentUS() - begin;
+    stop = true;
+    sc.stop();
+    DBSPIDER_LOG_INFO(g_logger) << "foreign task ran after " << cost << "us while local queue kept refilling";
+    DBSPIDER_ASSERT(ran);
+}
+
+int main(int argc, char **argv)
+{
+    DBSPIDER_LOG_NAME("system")->setLevel(dbspider::LogLevel::WARN);
+
+    test_global_fairness();
+
+    for (size_t threads : {1, 2, 4, 8, 16})
+    {
+        double global = bench(threads, false);
+        double stealing = bench(threads, true);
+        DBSPIDER_LOG_INFO(g_logger) << "threads=" << threads
+                                    << " global_queue=" << (uint64_t)global << " tasks/s"
+                                    << " work_stealing=" << (uint64_t)stealing << " tasks/s";
+    }
+    return 0;
+}